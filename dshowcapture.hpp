@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <functional>
 
 #ifdef DSHOWCAPTURE_EXPORTS
@@ -49,6 +50,7 @@ struct HDevice;
 struct HVideoEncoder;
 struct VideoConfig;
 struct AudioConfig;
+struct FrameRef;
 
 typedef std::function<void(const VideoConfig &config, unsigned char *data,
 			   size_t size, long long startTime, long long stopTime,
@@ -59,6 +61,12 @@ typedef std::function<void(const AudioConfig &config, unsigned char *data,
 			   size_t size, long long startTime, long long stopTime)>
 	AudioProc;
 
+typedef std::function<void(const VideoConfig &config, const FrameRef &frame)>
+	VideoFrameProc;
+
+typedef std::function<void(const AudioConfig &config, const FrameRef &frame)>
+	AudioFrameProc;
+
 typedef std::function<void()> ReactivateProc;
 
 enum class InitGraph {
@@ -82,6 +90,7 @@ enum class VideoFormat {
 	ARGB = 100,
 	XRGB,
 	RGB24,
+	RGBA, /* only produced by library conversion */
 
 	/* planar YUV formats */
 	I420 = 200,
@@ -116,6 +125,49 @@ enum class AudioFormat {
 	MPGA, /* MPEG 1 */
 };
 
+/** YUV to RGB matrix of a video stream */
+enum class ColorMatrix {
+	BT601,
+	BT709,
+	BT2020,
+
+	/** BT.2020 for PQ or HLG P010 video, otherwise BT.709 */
+	Auto,
+};
+
+/** Value range of a YUV video stream */
+enum class ColorRange {
+	/** Luma 16-235, chroma 16-240 */
+	Partial,
+	Full,
+};
+
+/** Transfer characteristics of a video stream */
+enum class ColorTransfer {
+	SDR,
+
+	/** SMPTE ST 2084 */
+	PQ,
+
+	/** Hybrid log-gamma */
+	HLG,
+};
+
+/** How bottom-up RGB frames (cy_flip false) are delivered */
+enum class BottomUpMode {
+	/** As captured, with the last row first */
+	AsCaptured,
+
+	/**
+	 * Top-down without copying: data[0] points at the last row in memory
+	 * and linesize[0] is negative
+	 */
+	NegativeStride,
+
+	/** Copied into a top-down buffer with a positive linesize */
+	Flip,
+};
+
 enum class AudioMode {
 	Capture,
 	DirectSound,
@@ -128,6 +180,195 @@ enum class Result {
 	Error,
 };
 
+/** How captured data is handed to the callback */
+enum class DeliveryMode {
+	/** Called directly on the DirectShow streaming thread */
+	Synchronous,
+
+	/** Queued and called from a separate library-owned thread */
+	Asynchronous,
+};
+
+/** What asynchronous delivery does when the consumer falls behind */
+enum class QueuePolicy {
+	/** Discard the incoming frame */
+	DropNewest,
+
+	/** Discard the oldest queued frame to make room */
+	DropOldest,
+
+	/** Only ever keep the most recent frame (mailbox) */
+	Latest,
+
+	/** Wait up to blockTimeoutMs for room, then discard the frame */
+	Block,
+
+	/**
+	 * Discard frames until the next keyframe, so an encoded stream
+	 * resumes at a decodable point
+	 */
+	DropUntilKeyframe,
+};
+
+/** One piece of an encoded packet */
+struct FrameSegment {
+	const unsigned char *data;
+	size_t size;
+};
+
+/**
+ * Reference-counted handle to captured data.
+ *
+ * The data stays valid for as long as any copy of the handle exists, so it
+ * can be kept past the callback without copying it.  Note that holding on to
+ * frames keeps the device's sample buffers in use; a device only has a few of
+ * them, so frames should still be released as soon as they are consumed.
+ * Frames delivered asynchronously or held back for reordering are copied out
+ * of the sample buffers, and hold library buffers instead.
+ */
+struct FrameRef {
+	/**
+	 * Plane pointers and strides (in bytes).  Each pointer is the first
+	 * row of the image, and strides are negative for rows that run
+	 * backwards in memory (see BottomUpMode).
+	 */
+	unsigned char *data[DSHOW_MAX_PLANES] = {};
+	int linesize[DSHOW_MAX_PLANES] = {};
+
+	/** Total size of the data in bytes */
+	size_t size = 0;
+
+	/**
+	 * Pieces of an encoded packet, in order.  If there is more than one
+	 * segment, data[0] only covers the first one.
+	 */
+	const FrameSegment *segments = nullptr;
+	size_t segmentCount = 0;
+
+	long long startTime = 0;
+	long long stopTime = 0;
+	long rotation = 0;
+
+	/**
+	 * startTime/stopTime converted to the host clock (see GetHostTime),
+	 * so streams from different devices can be lined up
+	 */
+	long long hostStartTime = 0;
+	long long hostStopTime = 0;
+
+	/** Whether the data can be decoded on its own */
+	bool keyframe = true;
+
+	/**
+	 * Whether startTime/stopTime were made up by the library because the
+	 * device didn't provide them
+	 */
+	bool synthesized = false;
+
+	int cx = 0, cy = 0;
+	VideoFormat videoFormat = VideoFormat::Unknown;
+	AudioFormat audioFormat = AudioFormat::Unknown;
+
+	/** Keeps the underlying sample or buffer alive */
+	std::shared_ptr<void> owner;
+
+	inline bool Valid() const { return !!owner; }
+	inline void Release() { *this = FrameRef(); }
+};
+
+/** Where video is converted from the captured format to the delivered one */
+enum class ConversionPath {
+	/** Delivered as captured */
+	None,
+
+	/** Converted by the library's own kernels */
+	Library,
+
+	/** Converted by filters DirectShow inserted into the graph */
+	DirectShow,
+};
+
+/** Per-stream delivery statistics */
+struct StreamStats {
+	/** Frames handed to the callback */
+	unsigned long long delivered = 0;
+
+	/** Most frames that were waiting in the delivery queue at once */
+	size_t queueHighWater = 0;
+
+	/** Frames that arrived while the delivery queue was full */
+	unsigned long long queueOverflows = 0;
+
+	/** Frames discarded by each queue policy */
+	unsigned long long droppedNewest = 0;
+	unsigned long long droppedOldest = 0;
+	unsigned long long droppedLatest = 0;
+	unsigned long long droppedBlockTimeout = 0;
+	unsigned long long droppedUntilKeyframe = 0;
+
+	/** Encoded packets sent as soon as they were complete */
+	unsigned long long packetsSentEarly = 0;
+
+	/**
+	 * Encoded packets that began in a segment without a timestamp, either
+	 * a new video access unit or the rest of a packet that was already
+	 * sent as complete.  They are timed to follow the packet before them.
+	 */
+	unsigned long long splitPackets = 0;
+
+	/** Samples that arrived without a timestamp and were given one */
+	unsigned long long synthesizedTimestamps = 0;
+
+	/** Segment boundaries where timestamps had to be moved forward */
+	unsigned long long timestampsRebased = 0;
+
+	/** Frames that arrived out of timestamp order and were put back */
+	unsigned long long timestampsReordered = 0;
+
+	/** Frames whose timestamp was moved forward to keep times increasing */
+	unsigned long long timestampsCorrected = 0;
+
+	/** How much faster the device clock runs than the host clock (ppm) */
+	double clockDriftPPM = 0.0;
+
+	/**
+	 * Average and largest difference between raw and smoothed video
+	 * timestamps (100-nanosecond units)
+	 */
+	long long smoothingMeanError = 0;
+	long long smoothingMaxError = 0;
+
+	/** Frames the timestamp smoother found missing */
+	unsigned long long detectedFrameDrops = 0;
+
+	/** Times the timestamp smoother relocked to a new frame rate */
+	unsigned long long detectedRateChanges = 0;
+
+	/** How video is converted to the delivered format */
+	ConversionPath conversionPath = ConversionPath::None;
+
+	/**
+	 * Instruction set of the library conversion kernel ("avx512",
+	 * "avx2", "ssse3", "sse2", "neon" or "c"), or nullptr.  Setting the
+	 * DSHOWCAPTURE_CPU environment variable to one of those caps it, for
+	 * comparisons.
+	 */
+	const char *conversionKernel = nullptr;
+
+	/** Frames converted by the library and the time it took (ns) */
+	unsigned long long convertedFrames = 0;
+	long long conversionAvgNs = 0;
+	long long conversionMaxNs = 0;
+
+	/**
+	 * Time converted frames waited for a shared processing thread (ns),
+	 * and frames that took longer than a frame interval
+	 */
+	long long processingQueueAvgNs = 0;
+	long long processingQueueMaxNs = 0;
+	unsigned long long processingLateFrames = 0;
+};
+
 struct VideoInfo {
 	int minCX, minCY;
 	int maxCX, maxCY;
@@ -162,18 +403,150 @@ struct AudioDevice : DeviceId {
 struct Config : DeviceId {
 	/** Use the device's desired default config */
 	bool useDefaultConfig = true;
+
+	/** How data is handed to the callback */
+	DeliveryMode delivery = DeliveryMode::Synchronous;
+
+	/** Maximum frames waiting for the callback (asynchronous delivery) */
+	int queueDepth = 4;
+
+	/** What to do when the queue is full (asynchronous delivery) */
+	QueuePolicy queuePolicy = QueuePolicy::DropNewest;
+
+	/** How long QueuePolicy::Block waits for room */
+	int blockTimeoutMs = 100;
+
+	/**
+	 * Hand encoded packets to frameCallback as a list of segments rather
+	 * than copying them into one contiguous buffer
+	 */
+	bool encodedSegments = false;
+
+	/**
+	 * Frames that may be held back to put out-of-order timestamps back in
+	 * order (raw formats only, at most 16).  Each one adds a frame of
+	 * latency.  Frames are copied out of the device's buffers to be held.
+	 */
+	int reorderWindow = 0;
+};
+
+/** Which devices' frames the shared processing threads work on first */
+enum class ProcessingPriority {
+	Low,
+	Normal,
+	High,
+};
+
+/**
+ * Cropping and scaling of captured frames, done in the same pass over each
+ * frame as the conversion to VideoConfig::outputFormat and the rotation
+ * of VideoConfig::upright, so that it is read from memory only once.  That
+ * pass is split into slices (bands of rows) that are processed in parallel
+ * by threads shared with every other device in the process:
+ *
+ *   config.pipeline.Crop(0, 140, 1920, 800).Scale(1280, 534);
+ */
+struct VideoPipeline {
+	/**
+	 * Region of the captured frame to keep, or all of it if cropCX or
+	 * cropCY is 0.  Offsets are rounded down to even for subsampled
+	 * formats.  Frames that are only cropped are described in place, so
+	 * only frameCallback sees the crop.
+	 */
+	int cropX = 0;
+	int cropY = 0;
+	int cropCX = 0;
+	int cropCY = 0;
+
+	/**
+	 * Size to scale the cropped frame to (bilinear), before it is
+	 * rotated, or 0 to keep its size.  Scaling needs a planar 4:2:0,
+	 * Y800, P010 or 32-bit RGB output format; frames in other formats
+	 * are delivered as captured, without their crop.
+	 */
+	int scaleCX = 0;
+	int scaleCY = 0;
+
+	/**
+	 * Threads that slices are processed on, or 0 for one per core.  They
+	 * are shared by all devices, and sized by the first one to start
+	 * capturing.  1 keeps the work on this device's streaming thread
+	 * instead.  Read when capture starts.
+	 */
+	int threads = 0;
+
+	/**
+	 * Rows of output per slice, rounded up to a multiple of 16, or 0 to
+	 * size slices to the L2 cache
+	 */
+	int sliceRows = 0;
+
+	/**
+	 * When the shared threads are busy, frames of higher priority devices
+	 * are processed first, then those due soonest (a frame interval after
+	 * they arrive)
+	 */
+	ProcessingPriority priority = ProcessingPriority::Normal;
+
+	inline VideoPipeline &Crop(int x, int y, int cx, int cy)
+	{
+		cropX = x;
+		cropY = y;
+		cropCX = cx;
+		cropCY = cy;
+		return *this;
+	}
+
+	inline VideoPipeline &Scale(int cx, int cy)
+	{
+		scaleCX = cx;
+		scaleCY = cy;
+		return *this;
+	}
+
+	inline VideoPipeline &Threads(int threads_, int sliceRows_ = 0)
+	{
+		threads = threads_;
+		sliceRows = sliceRows_;
+		return *this;
+	}
+
+	inline VideoPipeline &Priority(ProcessingPriority priority_)
+	{
+		priority = priority_;
+		return *this;
+	}
 };
 
 struct VideoConfig : Config {
+	/**
+	 * Receives borrowed pointers to frames.  The config passed with frames
+	 * the library converted, scaled or rotated has their format and size.
+	 */
 	VideoProc callback;
 	ReactivateProc reactivateCallback;
 
+	/**
+	 * Receives reference-counted frames instead of borrowed pointers.
+	 *
+	 * If set, this is used instead of callback.
+	 */
+	VideoFrameProc frameCallback;
+
 	/** Desired width/height of video. */
 	int cx = 0, cy_abs = 0;
 
 	/** Whether or not cy was negative. */
 	bool cy_flip = false;
 
+	/**
+	 * How RGB frames that are stored bottom-up are delivered to
+	 * frameCallback.  Frames converted from such RGB come out top-down
+	 * with any mode but AsCaptured.  callback always receives the buffer
+	 * as captured (or flipped, with Flip).
+	 */
+	BottomUpMode bottomUp = BottomUpMode::AsCaptured;
+
 	/** Desired frame interval (in 100-nanosecond units) */
 	long long frameInterval = 0;
 
@@ -182,11 +555,88 @@ struct VideoConfig : Config {
 
 	/** Desired video format. */
 	VideoFormat format = VideoFormat::Any;
+
+	/**
+	 * Format the library converts frames to before delivering them, or
+	 * Any to deliver them as captured.  Packed 4:2:2 formats (YVYU, YUY2,
+	 * UYVY, HDYC) can be converted to NV12, I420 or YV12, and those as
+	 * well as NV12, I420, YV12, P010 and RGB24 to XRGB, ARGB or RGBA.
+	 * XRGB, ARGB and RGBA can be converted to NV12, I420 or YV12, NV12 to
+	 * I420 or YV12, and P010 to NV12.  Frames that can't be converted are
+	 * delivered as captured; check FrameRef::videoFormat.
+	 */
+	VideoFormat outputFormat = VideoFormat::Any;
+
+	/**
+	 * How the captured YUV is encoded, used when converting to RGB and
+	 * for the gamut of HDR video that is tone mapped
+	 */
+	ColorMatrix colorMatrix = ColorMatrix::Auto;
+	ColorRange colorRange = ColorRange::Partial;
+
+	/**
+	 * Transfer function of the captured video.  P010 video that is PQ or
+	 * HLG is tone mapped to BT.709 SDR when converted to NV12.
+	 */
+	ColorTransfer colorTransfer = ColorTransfer::SDR;
+
+	/** Dither rather than round when reducing 10-bit video to 8-bit */
+	bool dither = false;
+
+	/**
+	 * Rotate frames by the device's roll (FrameRef::rotation, clockwise)
+	 * so they arrive upright with a rotation of 0, in the same pass as
+	 * any conversion to outputFormat.  Only right angles are rotated, of
+	 * NV12, I420, YV12, Y800, P010, XRGB, ARGB, RGBA and (with even
+	 * dimensions) packed 4:2:2 frames; others are delivered as captured.
+	 * Check FrameRef::cx/cy, which are swapped by 90 and 270 degree turns.
+	 */
+	bool upright = false;
+
+	/** Cropping, scaling and threading, see VideoPipeline */
+	VideoPipeline pipeline;
+
+	/**
+	 * Also receives each P010 frame converted to 8-bit NV12 (tone mapped
+	 * to BT.709 unless colorTransfer is SDR), so that one capture can feed
+	 * both an HDR and an SDR consumer.  The frames are delivered like
+	 * the P010 ones: with the same timestamps, and from a queue of their
+	 * own when delivery is asynchronous, so either consumer can be
+	 * called first.
+	 */
+	VideoFrameProc sdrFrameCallback;
+
+	/**
+	 * Always connect in the device's native format and convert to format
+	 * in the library, instead of having DirectShow insert its colour
+	 * space converter filters.  Falls back to DirectShow for conversions
+	 * the library doesn't have.
+	 */
+	bool convertInLibrary = false;
+
+	/**
+	 * How often (in milliseconds) HDR signal and camera roll are polled
+	 * while capturing
+	 */
+	int propertyPollMs = 250;
+
+	/**
+	 * Smooth out timestamp jitter around frameInterval (raw formats
+	 * only).  Dropped frames and frame rate changes are left visible.
+	 */
+	bool smoothTimestamps = false;
 };
 
 struct AudioConfig : Config {
 	AudioProc callback;
 
+	/**
+	 * Receives reference-counted frames instead of borrowed pointers.
+	 *
+	 * If set, this is used instead of callback.
+	 */
+	AudioFrameProc frameCallback;
+
 	/**
 		 * Use the audio attached to the video device
 		 *
@@ -243,6 +693,9 @@ public:
 	bool GetVideoDeviceId(DeviceId &id) const;
 	bool GetAudioDeviceId(DeviceId &id) const;
 
+	bool GetVideoStats(StreamStats &stats) const;
+	bool GetAudioStats(StreamStats &stats) const;
+
 	/**
 		 * Opens a DirectShow dialog associated with this device
 		 *
@@ -261,6 +714,17 @@ struct VideoEncoderConfig : DeviceId {
 	int keyframeInterval;
 	int cx;
 	int cy;
+
+	/**
+	 * Format of the frames passed to Encode.  The encoder takes YV12;
+	 * XRGB, ARGB, RGBA, NV12, I420 and packed 4:2:2 frames are converted
+	 * straight into its input buffer.
+	 */
+	VideoFormat format = VideoFormat::YV12;
+
+	/** YUV encoding to convert RGB frames to */
+	ColorMatrix colorMatrix = ColorMatrix::BT709;
+	ColorRange colorRange = ColorRange::Partial;
 };
 
 struct EncoderPacket {
@@ -285,11 +749,33 @@ public:
 	bool SetConfig(VideoEncoderConfig &config);
 	bool GetConfig(VideoEncoderConfig &config) const;
 
+	/**
+	 * Encodes a frame in VideoEncoderConfig::format.  Fails between
+	 * LockFrame and EncodeLocked.
+	 *
+	 * @param  data      Plane pointers
+	 * @param  linesize  Size of each plane in bytes
+	 */
 	bool Encode(unsigned char *data[DSHOW_MAX_PLANES],
 		    size_t linesize[DSHOW_MAX_PLANES], long long timestampStart,
 		    long long timestampEnd, EncoderPacket &packet,
 		    bool &new_packet);
 
+	/**
+	 * Direct rendering: gives the planes of the encoder's next input
+	 * buffer to write the frame into, saving a copy.  The planes are
+	 * YV12, the encoder's own input format, whatever
+	 * VideoEncoderConfig::format is.  Must be followed by EncodeLocked.
+	 *
+	 * @param  linesize  Receives the row stride of each plane
+	 */
+	bool LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+		       int linesize[DSHOW_MAX_PLANES]);
+
+	/** Encodes the frame written after LockFrame */
+	bool EncodeLocked(long long timestampStart, long long timestampEnd,
+			  EncoderPacket &packet, bool &new_packet);
+
 	static bool EnumEncoders(std::vector<DeviceId> &encoders);
 };
 
@@ -303,4 +789,30 @@ enum class LogType {
 typedef void (*LogCallback)(LogType type, const wchar_t *msg, void *param);
 
 DSHOWCAPTURE_EXPORT void SetLogCallback(LogCallback callback, void *param);
+
+/**
+ * Current time of the host clock that FrameRef::hostStartTime and
+ * hostStopTime are on (monotonic, in 100-nanosecond units)
+ */
+DSHOWCAPTURE_EXPORT long long GetHostTime();
+
+/**
+ * Converts a frame with the library's conversion kernels (see
+ * VideoConfig::outputFormat for the supported conversions), using the
+ * fastest ones the CPU supports
+ *
+ * @param  matrix    YUV matrix of the frame, for conversions to RGB
+ * @param  range     YUV range of the frame, for conversions to RGB
+ * @param  transfer  Transfer function of the frame; PQ and HLG P010 is
+ *                   tone mapped when converted to NV12
+ * @return           false if the conversion isn't supported
+ */
+DSHOWCAPTURE_EXPORT bool
+ConvertVideoFrame(const unsigned char *const src[DSHOW_MAX_PLANES],
+		  const int srcLinesize[DSHOW_MAX_PLANES], VideoFormat srcFormat,
+		  unsigned char *const dst[DSHOW_MAX_PLANES],
+		  const int dstLinesize[DSHOW_MAX_PLANES], VideoFormat dstFormat,
+		  int cx, int cy, ColorMatrix matrix = ColorMatrix::BT709,
+		  ColorRange range = ColorRange::Partial,
+		  ColorTransfer transfer = ColorTransfer::SDR);
 };
@@ -0,0 +1,315 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "access-unit-detector.hpp"
+
+#include <cstring>
+
+namespace DShow {
+
+/* units with a consistent layout to see before predicting their end */
+#define LEARN_UNITS 8
+
+static inline bool IsVCL(UnitSyntax syntax, const unsigned char *nal)
+{
+	if (syntax == UnitSyntax::H264) {
+		int type = nal[0] & 0x1F;
+		return type >= 1 && type <= 5;
+	}
+
+	return ((nal[0] >> 1) & 0x3F) < 32;
+}
+
+/* whether a NAL can only appear at the start of an access unit: an access
+ * unit delimiter, parameter sets/SEI, or the first slice of a picture */
+static inline bool IsFirstNal(UnitSyntax syntax, const unsigned char *nal)
+{
+	if (syntax == UnitSyntax::H264) {
+		int type = nal[0] & 0x1F;
+		if (type == 9 || type == 7 || type == 8 || type == 6)
+			return true;
+
+		/* first_mb_in_slice == 0 */
+		return type >= 1 && type <= 5 && (nal[1] & 0x80) != 0;
+	}
+
+	int type = (nal[0] >> 1) & 0x3F;
+	if (type == 35 || type == 32 || type == 33 || type == 34 || type == 39)
+		return true;
+
+	/* first_slice_segment_in_pic_flag */
+	return type < 32 && (nal[2] & 0x80) != 0;
+}
+
+static inline size_t NalHeaderSize(UnitSyntax syntax)
+{
+	/* NAL header plus the byte holding the first slice flag */
+	return syntax == UnitSyntax::H264 ? 2 : 3;
+}
+
+UnitSyntax AccessUnitDetector::VideoSyntax(VideoFormat format)
+{
+	if (format == VideoFormat::H264)
+		return UnitSyntax::H264;
+	else if (format == VideoFormat::HEVC)
+		return UnitSyntax::HEVC;
+
+	return UnitSyntax::None;
+}
+
+UnitSyntax AccessUnitDetector::AudioSyntax(AudioFormat format)
+{
+	if (format == AudioFormat::AAC)
+		return UnitSyntax::ADTS;
+
+	return UnitSyntax::None;
+}
+
+void AccessUnitDetector::Reset(UnitSyntax syntax_)
+{
+	*this = AccessUnitDetector();
+	syntax = syntax_;
+	StartUnit();
+}
+
+void AccessUnitDetector::StartUnit()
+{
+	tail[0] = tail[1] = 0xFF;
+	headerSize = 0;
+	collecting = false;
+
+	adtsHeaderSize = 0;
+	frameRemaining = 0;
+
+	parts = 0;
+	trailing = false;
+	invalid = false;
+	sentEarly = false;
+}
+
+bool AccessUnitDetector::StartsUnit(const unsigned char *data,
+				    size_t size) const
+{
+	if (syntax == UnitSyntax::ADTS)
+		return size >= 2 && data[0] == 0xFF && (data[1] & 0xF0) == 0xF0;
+
+	size_t i = 0;
+	while (i < size && data[i] == 0)
+		i++;
+
+	if (i < 2 || i >= size || data[i] != 1)
+		return false;
+
+	i++;
+	if (size - i < NalHeaderSize(syntax))
+		return false;
+
+	return IsFirstNal(syntax, data + i);
+}
+
+void AccessUnitDetector::BeginUnit(const unsigned char *data, size_t size)
+{
+	if (syntax == UnitSyntax::None)
+		return;
+
+	bool startsUnit = StartsUnit(data, size);
+
+	if (sentEarly) {
+		if (startsUnit) {
+			cleanUnits++;
+		} else {
+			/* the unit we sent wasn't followed by a new one */
+			mispredictions++;
+			disabled = true;
+		}
+
+	} else {
+		bool clean = parts > 0 && !trailing && !invalid &&
+			     startsUnit && Aligned();
+
+		if (!clean) {
+			cleanUnits = 0;
+		} else if (parts == expectedParts) {
+			cleanUnits++;
+		} else {
+			expectedParts = parts;
+			cleanUnits = 1;
+		}
+	}
+
+	StartUnit();
+}
+
+bool AccessUnitDetector::ContinueUnit(const unsigned char *data, size_t size)
+{
+	if (syntax == UnitSyntax::None)
+		return true;
+
+	bool video = syntax != UnitSyntax::ADTS;
+
+	/* a new picture (or its delimiter/parameter sets) after slices of
+	 * the current one */
+	if (!sentEarly)
+		return !video || !parts || !StartsUnit(data, size);
+
+	/* after a unit that was sent early, a video unit may start (BeginUnit
+	 * counts it), but AAC units only start with timed samples */
+	if (video && StartsUnit(data, size))
+		return false;
+
+	/* the unit we sent continues: the rest goes out as a unit of its own,
+	 * which is counted here rather than again in BeginUnit */
+	mispredictions++;
+	disabled = true;
+	cleanUnits = 0;
+	sentEarly = false;
+	return false;
+}
+
+void AccessUnitDetector::OnNal(const unsigned char *nal)
+{
+	if (IsVCL(syntax, nal))
+		parts++;
+}
+
+static inline bool PrecededByZeros(const unsigned char *data, size_t pos,
+				   const unsigned char tail[2])
+{
+	unsigned char b1 = pos >= 1 ? data[pos - 1] : tail[1];
+	unsigned char b2 = pos >= 2 ? data[pos - 2]
+				    : (pos == 1 ? tail[1] : tail[0]);
+	return !b1 && !b2;
+}
+
+void AccessUnitDetector::ParseNals(const unsigned char *data, size_t size)
+{
+	const size_t needed = NalHeaderSize(syntax);
+	size_t i = 0;
+
+	while (i < size) {
+		if (collecting) {
+			header[headerSize++] = data[i++];
+			if (headerSize == needed) {
+				collecting = false;
+				OnNal(header);
+			}
+			continue;
+		}
+
+		/* emulation prevention guarantees 00 00 01 only shows up as
+		 * a start code, so only the 01 bytes need checking */
+		const void *one = memchr(data + i, 1, size - i);
+		if (!one)
+			break;
+
+		size_t pos = (const unsigned char *)one - data;
+		if (PrecededByZeros(data, pos, tail)) {
+			collecting = true;
+			headerSize = 0;
+		}
+
+		i = pos + 1;
+	}
+
+	if (size >= 2) {
+		tail[0] = data[size - 2];
+		tail[1] = data[size - 1];
+	} else if (size == 1) {
+		tail[0] = tail[1];
+		tail[1] = data[0];
+	}
+}
+
+void AccessUnitDetector::ParseADTS(const unsigned char *data, size_t size)
+{
+	while (size && !invalid) {
+		if (frameRemaining) {
+			size_t skip = frameRemaining < size ? frameRemaining
+							    : size;
+			frameRemaining -= skip;
+			data += skip;
+			size -= skip;
+			continue;
+		}
+
+		adtsHeader[adtsHeaderSize++] = *data++;
+		size--;
+
+		if (adtsHeaderSize < sizeof(adtsHeader))
+			continue;
+
+		const unsigned char *h = adtsHeader;
+		size_t frameLength = ((size_t)(h[3] & 0x03) << 11) |
+				     ((size_t)h[4] << 3) | (h[5] >> 5);
+
+		if (h[0] != 0xFF || (h[1] & 0xF0) != 0xF0 ||
+		    frameLength < sizeof(adtsHeader)) {
+			invalid = true;
+			break;
+		}
+
+		adtsHeaderSize = 0;
+		frameRemaining = frameLength - sizeof(adtsHeader);
+		parts++;
+	}
+}
+
+void AccessUnitDetector::Parse(const unsigned char *data, size_t size)
+{
+	if (syntax == UnitSyntax::None)
+		return;
+
+	if (syntax != UnitSyntax::ADTS) {
+		int hadParts = parts;
+
+		ParseNals(data, size);
+
+		/* a segment with no slice of its own after the unit's slices
+		 * (the rest of the last slice, or NALs that follow it) means
+		 * the unit doesn't end with the segment holding its last
+		 * slice, which can't be predicted */
+		if (hadParts && parts == hadParts)
+			trailing = true;
+		return;
+	}
+
+	bool hadParts = parts > 0;
+	bool wasAligned = Aligned();
+
+	ParseADTS(data, size);
+
+	/* a unit that keeps going in a later segment, with more frames after
+	 * it was aligned, can't be predicted */
+	if (hadParts && wasAligned)
+		trailing = true;
+}
+
+bool AccessUnitDetector::Complete() const
+{
+	if (syntax == UnitSyntax::None || disabled || invalid || sentEarly)
+		return false;
+	if (cleanUnits < LEARN_UNITS || parts != expectedParts)
+		return false;
+
+	/* a video unit is complete once its last slice has started, if it
+	 * is not part way through the header of a NAL after it */
+	return syntax == UnitSyntax::ADTS ? Aligned() : !collecting;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+namespace DShow {
+
+enum class UnitSyntax {
+	None,
+	H264,
+	HEVC,
+	ADTS,
+};
+
+/**
+ * Works out where encoded access units begin and end, so they can be sent
+ * without waiting for the next timestamped sample to start.
+ *
+ * Video units end where the next one begins: a segment that starts with an
+ * access unit delimiter, parameter sets/SEI or the first slice of a picture,
+ * after the current unit already has slices, starts a unit of its own.
+ * Their parts are their slice NALs.  AAC units are split into ADTS frames
+ * whose headers carry their length, and their parts are those frames.
+ *
+ * The detector first watches a run of units to learn how many parts they
+ * have and that they never continue past the segment that completes them
+ * (for video, the one in which the last slice starts).  Only then are
+ * units reported complete early.  If a unit turns out to continue after it
+ * was reported complete, the rest becomes a unit of its own and early
+ * detection is turned off until the next reset.
+ */
+class AccessUnitDetector {
+	UnitSyntax syntax = UnitSyntax::None;
+
+	/* start code scanning, carried between segments */
+	unsigned char tail[2];
+	unsigned char header[3];
+	size_t headerSize = 0;
+	bool collecting = false;
+
+	/* ADTS frame scanning */
+	unsigned char adtsHeader[7];
+	size_t adtsHeaderSize = 0;
+	size_t frameRemaining = 0;
+
+	/* current unit */
+	int parts = 0;
+	bool trailing = false;
+	bool invalid = false;
+	bool sentEarly = false;
+
+	/* learned unit layout */
+	int expectedParts = 0;
+	int cleanUnits = 0;
+	bool disabled = false;
+
+	unsigned long long mispredictions = 0;
+
+	inline bool Aligned() const
+	{
+		return !frameRemaining && !adtsHeaderSize;
+	}
+
+	bool StartsUnit(const unsigned char *data, size_t size) const;
+	void StartUnit();
+	void OnNal(const unsigned char *nal);
+	void ParseNals(const unsigned char *data, size_t size);
+	void ParseADTS(const unsigned char *data, size_t size);
+
+public:
+	void Reset(UnitSyntax syntax);
+
+	/** Called with the first segment of a unit, before Parse */
+	void BeginUnit(const unsigned char *data, size_t size);
+
+	/**
+	 * Called with any other segment of a unit, before Parse.  Returns
+	 * false if the segment starts the next unit instead, because it begins
+	 * a new video access unit or the current unit was already reported
+	 * complete.  BeginUnit is to be called with it then.
+	 */
+	bool ContinueUnit(const unsigned char *data, size_t size);
+
+	/** Called with every segment of the unit */
+	void Parse(const unsigned char *data, size_t size);
+
+	/** Whether the unit can be sent without waiting for the next one */
+	bool Complete() const;
+
+	/** Marks the current unit as sent early */
+	inline void SentEarly() { sentEarly = true; }
+
+	inline unsigned long long Mispredictions() const
+	{
+		return mispredictions;
+	}
+
+	static UnitSyntax VideoSyntax(VideoFormat format);
+	static UnitSyntax AudioSyntax(AudioFormat format);
+};
+
+}; /* namespace DShow */
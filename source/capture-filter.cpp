@@ -230,6 +230,9 @@ STDMETHODIMP CapturePin::EndOfStream()
 {
 	PrintFunc(L"CapturePin::EndOfStream");
 
+	if (captureInfo.endOfStream)
+		captureInfo.endOfStream();
+
 	return S_OK;
 }
 
@@ -257,6 +260,10 @@ STDMETHODIMP CapturePin::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop,
 	DSHOW_UNUSED(tStart);
 	DSHOW_UNUSED(tStop);
 	DSHOW_UNUSED(dRate);
+
+	if (captureInfo.newSegment)
+		captureInfo.newSegment();
+
 	return S_OK;
 }
 
@@ -32,6 +32,8 @@ typedef void (*CaptureCallback)(void *param, IMediaSample *sample);
 
 struct PinCaptureInfo {
 	std::function<void(IMediaSample *sample)> callback;
+	std::function<void()> endOfStream;
+	std::function<void()> newSegment;
 	GUID expectedMajorType{};
 	GUID expectedSubType{};
 };
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "clock-domain.hpp"
+#include "../dshowcapture.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace DShow {
+
+/* real clocks are never this far apart, anything more is bad data */
+#define MAX_DRIFT 0.01
+
+/* a pair further than this off the line means the device clock restarted */
+#define MAX_RESIDUAL 5000000LL /* 500ms */
+
+long long GetHostTime()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(
+		       steady_clock::now().time_since_epoch())
+		       .count() /
+	       100;
+}
+
+ClockDomainEstimator::ClockDomainEstimator(size_t window_)
+	: window(window_ < 2 ? 2 : window_)
+{
+	pairs.resize(window);
+}
+
+void ClockDomainEstimator::Reset()
+{
+	next = 0;
+	count = 0;
+	bucketBase = {};
+	bucketDevice = 0.0;
+	bucketHost = 0.0;
+	bucketCount = 0;
+	baseDevice = 0;
+	baseHost = 0;
+	meanDevice = 0.0;
+	meanHost = 0.0;
+	slope = 1.0;
+}
+
+void ClockDomainEstimator::Fit()
+{
+	size_t first = (next + window - count) % window;
+
+	/* work relative to the oldest pair to keep the sums small */
+	baseDevice = pairs[first].device;
+	baseHost = pairs[first].host;
+
+	double sumX = 0.0, sumY = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		const Pair &pair = pairs[(first + i) % window];
+		sumX += (double)(pair.device - baseDevice);
+		sumY += (double)(pair.host - baseHost);
+	}
+
+	meanDevice = sumX / (double)count;
+	meanHost = sumY / (double)count;
+
+	double sxx = 0.0, sxy = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		const Pair &pair = pairs[(first + i) % window];
+		double dx = (double)(pair.device - baseDevice) - meanDevice;
+		double dy = (double)(pair.host - baseHost) - meanHost;
+		sxx += dx * dx;
+		sxy += dx * dy;
+	}
+
+	slope = sxx > 0.0 ? sxy / sxx : 1.0;
+	if (slope < 1.0 - MAX_DRIFT)
+		slope = 1.0 - MAX_DRIFT;
+	else if (slope > 1.0 + MAX_DRIFT)
+		slope = 1.0 + MAX_DRIFT;
+}
+
+void ClockDomainEstimator::AddPair(long long device, long long host)
+{
+	pairs[next] = {device, host};
+	next = (next + 1) % window;
+	if (count < window)
+		count++;
+
+	Fit();
+}
+
+void ClockDomainEstimator::Observe(long long device, long long host)
+{
+	if (count && std::llabs(host - ToHost(device)) > MAX_RESIDUAL) {
+		Reset();
+		restarts++;
+	}
+
+	/* the very first pair is used as is so there's an estimate right
+	 * away */
+	if (!count) {
+		AddPair(device, host);
+		return;
+	}
+
+	if (!bucketCount)
+		bucketBase = {device, host};
+
+	bucketDevice += (double)(device - bucketBase.device);
+	bucketHost += (double)(host - bucketBase.host);
+	bucketCount++;
+
+	if (device - bucketBase.device >= bucketSpan) {
+		double n = (double)bucketCount;
+		AddPair(bucketBase.device + std::llround(bucketDevice / n),
+			bucketBase.host + std::llround(bucketHost / n));
+
+		bucketDevice = 0.0;
+		bucketHost = 0.0;
+		bucketCount = 0;
+	}
+}
+
+long long ClockDomainEstimator::ToHost(long long device) const
+{
+	if (!count)
+		return 0;
+
+	double dx = (double)(device - baseDevice) - meanDevice;
+	return baseHost + std::llround(meanHost + slope * dx);
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace DShow {
+
+/**
+ * Maps a device's timestamps onto the host clock.
+ *
+ * Fits a line through recent (device time, host arrival time) pairs with
+ * least squares, which gives the device clock's offset and drift against
+ * the host.  Pairs are averaged over short buckets first, so the fit spans
+ * long enough to see drift without throwing samples away.  The offset
+ * includes the average delivery latency.  A pair that lands far off the
+ * line is taken to mean the device clock restarted, and the fit starts
+ * over.
+ *
+ * The estimator never reads a clock itself, so a recorded trace always
+ * gives the same result.  All times are in 100-nanosecond units.
+ */
+class ClockDomainEstimator {
+	struct Pair {
+		long long device;
+		long long host;
+	};
+
+	std::vector<Pair> pairs;
+	size_t window;
+	size_t next = 0;
+	size_t count = 0;
+
+	/* pairs being averaged into the next one */
+	Pair bucketBase = {};
+	double bucketDevice = 0.0;
+	double bucketHost = 0.0;
+	size_t bucketCount = 0;
+
+	/* fitted line: host = baseHost + meanHost +
+	 *                     slope * (device - baseDevice - meanDevice) */
+	long long baseDevice = 0;
+	long long baseHost = 0;
+	double meanDevice = 0.0;
+	double meanHost = 0.0;
+	double slope = 1.0;
+
+	unsigned long long restarts = 0;
+
+	void Fit();
+	void AddPair(long long device, long long host);
+
+public:
+	explicit ClockDomainEstimator(size_t window = 128);
+
+	/** Time covered by each averaged pair */
+	static const long long bucketSpan = 1000000; /* 100ms */
+
+	void Reset();
+
+	/** Adds a device timestamp and the host time it arrived at */
+	void Observe(long long device, long long host);
+
+	inline bool Valid() const { return count > 0; }
+
+	/** Converts a device time to host time (0 if nothing observed yet) */
+	long long ToHost(long long device) const;
+
+	/** How much faster the device clock runs than the host, in ppm */
+	inline double DriftPPM() const { return (1.0 / slope - 1.0) * 1e6; }
+
+	inline unsigned long long Restarts() const { return restarts; }
+};
+
+}; /* namespace DShow */
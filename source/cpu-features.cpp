@@ -0,0 +1,201 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "cpu-features.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#if DSHOW_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace DShow {
+
+/* assumed when the CPU doesn't say */
+#define DEFAULT_L2_SIZE (256 * 1024)
+
+#if DSHOW_X86
+static void CPUID(int leaf, int subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; i++)
+		regs[i] = (uint32_t)info[i];
+#else
+	unsigned int a, b, c, d;
+	if (!__get_cpuid_count((unsigned int)leaf, (unsigned int)subleaf, &a,
+			       &b, &c, &d))
+		a = b = c = d = 0;
+	regs[0] = a;
+	regs[1] = b;
+	regs[2] = c;
+	regs[3] = d;
+#endif
+}
+
+static uint64_t XGetBV()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+static uint32_t ProbeCPUFeatures()
+{
+	uint32_t regs[4];
+	uint32_t features = 0;
+
+	CPUID(0, 0, regs);
+	uint32_t maxLeaf = regs[0];
+	if (maxLeaf < 1)
+		return 0;
+
+	CPUID(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= CPU_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= CPU_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= CPU_SSE41;
+
+	/* AVX state has to be enabled by the OS as well */
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	bool ymmState = osxsave && (XGetBV() & 0x6) == 0x6;
+
+	/* AVX-512 also needs the opmask and both halves of the ZMM state */
+	bool zmmState = ymmState && (XGetBV() & 0xE6) == 0xE6;
+
+	if (maxLeaf >= 7 && avx && ymmState) {
+		CPUID(7, 0, regs);
+		if (regs[1] & (1 << 5))
+			features |= CPU_AVX2;
+		if (zmmState && (regs[1] & (1 << 16)) &&
+		    (regs[1] & (1 << 30)))
+			features |= CPU_AVX512;
+	}
+
+	return features;
+}
+
+static size_t ProbeL2CacheSize()
+{
+	uint32_t regs[4];
+
+	/* AMD and Intel both give the L2 size in KB in this leaf */
+	CPUID((int)0x80000000, 0, regs);
+	if (regs[0] < 0x80000006)
+		return DEFAULT_L2_SIZE;
+
+	CPUID((int)0x80000006, 0, regs);
+	size_t kb = regs[2] >> 16;
+	return kb ? kb * 1024 : DEFAULT_L2_SIZE;
+}
+#else
+static size_t ProbeL2CacheSize()
+{
+	return DEFAULT_L2_SIZE;
+}
+
+static uint32_t ProbeCPUFeatures()
+{
+#if DSHOW_ARM64
+	return CPU_NEON;
+#else
+	return 0;
+#endif
+}
+#endif
+
+#define CPU_ENV "DSHOWCAPTURE_CPU"
+
+struct CPUTier {
+	const char *name;
+	uint32_t features;
+};
+
+/* each tier keeps the features below it */
+static const CPUTier cpuTiers[] = {
+	{"c", 0},
+	{"sse2", CPU_SSE2},
+	{"ssse3", CPU_SSE2 | CPU_SSSE3},
+	{"sse41", CPU_SSE2 | CPU_SSSE3 | CPU_SSE41},
+	{"avx2", CPU_SSE2 | CPU_SSSE3 | CPU_SSE41 | CPU_AVX2},
+	{"avx512", CPU_SSE2 | CPU_SSSE3 | CPU_SSE41 | CPU_AVX2 | CPU_AVX512},
+	{"neon", CPU_NEON},
+};
+
+uint32_t GetCPUTierFeatures(const char *name)
+{
+	char lower[16] = {};
+
+	if (!name || strlen(name) >= sizeof(lower))
+		return ~0u;
+	for (size_t i = 0; name[i]; i++)
+		lower[i] = (char)tolower((unsigned char)name[i]);
+
+	for (const CPUTier &tier : cpuTiers) {
+		if (strcmp(lower, tier.name) == 0)
+			return tier.features;
+	}
+
+	return ~0u;
+}
+
+/* features allowed by the environment override, all if it isn't set */
+static uint32_t AllowedCPUFeatures()
+{
+#ifdef _WIN32
+	char name[16];
+	DWORD len = GetEnvironmentVariableA(CPU_ENV, name, sizeof(name));
+	return len && len < sizeof(name) ? GetCPUTierFeatures(name) : ~0u;
+#else
+	return GetCPUTierFeatures(getenv(CPU_ENV));
+#endif
+}
+
+uint32_t GetCPUFeatures()
+{
+	static const uint32_t features =
+		ProbeCPUFeatures() & AllowedCPUFeatures();
+	return features;
+}
+
+size_t GetL2CacheSize()
+{
+	static const size_t size = ProbeL2CacheSize();
+	return size;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+#define DSHOW_X86 1
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define DSHOW_ARM64 1
+#endif
+
+namespace DShow {
+
+enum CPUFeature : uint32_t {
+	CPU_SSE2 = 1 << 0,
+	CPU_SSSE3 = 1 << 1,
+	CPU_SSE41 = 1 << 2,
+	CPU_AVX2 = 1 << 3,
+	CPU_AVX512 = 1 << 4, /* AVX-512 F and BW */
+	CPU_NEON = 1 << 8,
+};
+
+/**
+ * Instruction set extensions the CPU and OS support (CPUFeature flags),
+ * probed once.  The DSHOWCAPTURE_CPU environment variable can cap them at
+ * a lower tier for comparisons: "c", "sse2", "ssse3", "sse41", "avx2",
+ * "avx512" or "neon".
+ */
+uint32_t GetCPUFeatures();
+
+/**
+ * CPUFeature flags of a tier named as for DSHOWCAPTURE_CPU, that is the
+ * named one and those below it, or all flags if the name is unknown
+ */
+uint32_t GetCPUTierFeatures(const char *name);
+
+/** Size of a core's L2 cache in bytes, or a typical size if unknown */
+size_t GetL2CacheSize();
+
+}; /* namespace DShow */
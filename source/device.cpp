@@ -18,10 +18,12 @@
  */
 
 #include "device.hpp"
+#include "cpu-features.hpp"
 #include "dshow-device-defs.hpp"
 #include "dshow-media-type.hpp"
 #include "dshow-formats.hpp"
 #include "dshow-enum.hpp"
+#include "frame-ref.hpp"
 #include "log.hpp"
 
 #define ROCKET_WAIT_TIME_MS 5000
@@ -89,19 +91,352 @@ bool HDevice::EnsureInactive(const wchar_t *func)
 	return true;
 }
 
-inline void HDevice::SendToCallback(bool video, unsigned char *data,
-				    size_t size, long long startTime,
-				    long long stopTime, long rotation)
+inline bool HDevice::HasCallback(bool video) const
 {
-	if (!size)
+	if (video)
+		return videoConfig.frameCallback || videoConfig.callback;
+	else
+		return audioConfig.frameCallback || audioConfig.callback;
+}
+
+inline void HDevice::SendToCallback(bool video, const FrameRef &frame)
+{
+	if (!frame.size)
 		return;
 
+	if (video) {
+		if (videoConfig.frameCallback) {
+			videoConfig.frameCallback(videoConfig, frame);
+
+		} else if (frame.videoFormat == videoConfig.format &&
+			   frame.cx == videoConfig.cx &&
+			   frame.cy == videoConfig.cy_abs) {
+			videoConfig.callback(
+				videoConfig, VideoFrameBuffer(frame),
+				frame.size, frame.startTime, frame.stopTime,
+				frame.rotation);
+
+		} else {
+			/* converted, scaled or rotated: callback only has the
+			 * config to tell what the buffer holds */
+			VideoConfig config = videoConfig;
+			config.format = frame.videoFormat;
+			config.cx = frame.cx;
+			config.cy_abs = frame.cy;
+
+			videoConfig.callback(config, VideoFrameBuffer(frame),
+					     frame.size, frame.startTime,
+					     frame.stopTime, frame.rotation);
+		}
+	} else {
+		if (audioConfig.frameCallback)
+			audioConfig.frameCallback(audioConfig, frame);
+		else
+			audioConfig.callback(audioConfig, frame.data[0],
+					     frame.size, frame.startTime,
+					     frame.stopTime);
+	}
+}
+
+inline bool HDevice::NeedsFrameOwner(bool video) const
+{
 	if (video)
-		videoConfig.callback(videoConfig, data, size, startTime,
-				     stopTime, rotation);
+		return videoConfig.frameCallback || videoDispatcher.Running();
 	else
-		audioConfig.callback(audioConfig, data, size, startTime,
-				     stopTime);
+		return audioConfig.frameCallback || audioDispatcher.Running();
+}
+
+inline void HDevice::Deliver(bool video, FrameRef &frame)
+{
+	if (!frame.size)
+		return;
+
+	TimestampNormalizer &normalizer = video ? videoNormalizer
+						: audioNormalizer;
+	normalizer.Push(std::move(frame));
+}
+
+void HDevice::Dispatch(bool video, FrameRef &frame)
+{
+	FrameDispatcher &dispatcher = video ? videoDispatcher : audioDispatcher;
+
+	if (dispatcher.Running()) {
+		dispatcher.Push(std::move(frame));
+	} else {
+		SendToCallback(video, frame);
+		(video ? videoStats : audioStats).delivered++;
+	}
+}
+
+/* the stats are kept on the streaming thread without locking; a copy is
+ * made under the lock after each sample for GetStats to read */
+void HDevice::PublishStats(bool video)
+{
+	StreamStats stats = video ? videoStats : audioStats;
+	(video ? videoNormalizer : audioNormalizer).GetStats(stats);
+	stats.clockDriftPPM = (video ? videoClock : audioClock).DriftPPM();
+
+	if (video) {
+		videoSmoother.GetStats(stats);
+		videoConverter.GetStats(stats);
+		stats.conversionPath = videoConverter.Active()
+					       ? ConversionPath::Library
+					       : videoConversionPath;
+	}
+
+	lock_guard<mutex> lock(statsMutex);
+	(video ? videoStatsSnapshot : audioStatsSnapshot) = stats;
+}
+
+void HDevice::GetStats(bool video, StreamStats &stats) const
+{
+	const FrameDispatcher &dispatcher = video ? videoDispatcher
+						  : audioDispatcher;
+	DeliveryMode delivery = video ? videoConfig.delivery
+				      : audioConfig.delivery;
+
+	{
+		lock_guard<mutex> lock(statsMutex);
+		stats = video ? videoStatsSnapshot : audioStatsSnapshot;
+	}
+
+	/* the dispatcher's own counters are atomic */
+	if (delivery == DeliveryMode::Asynchronous)
+		dispatcher.GetStats(stats);
+}
+
+void HDevice::InitFrame(FrameRef &frame, bool video) const
+{
+	if (video) {
+		frame.cx = videoConfig.cx;
+		frame.cy = videoConfig.cy_abs;
+		frame.videoFormat = videoNative ? videoConfig.internalFormat
+						: videoConfig.format;
+	} else {
+		frame.audioFormat = audioConfig.format;
+	}
+}
+
+VideoFormat HDevice::OutputVideoFormat() const
+{
+	if (videoConfig.outputFormat != VideoFormat::Any)
+		return videoConfig.outputFormat;
+
+	/* connected natively, the conversion to format is ours to do */
+	return videoNative ? videoConfig.format : VideoFormat::Any;
+}
+
+ColorMatrix HDevice::VideoColorMatrix(VideoFormat format) const
+{
+	return ResolveColorMatrix(videoConfig.colorMatrix, format,
+				  videoConfig.colorTransfer);
+}
+
+bool HDevice::ConvertSDRFrame(FrameRef &frame)
+{
+	return sdrConverter.Convert(frame, VideoFormat::NV12,
+				    VideoColorMatrix(frame.videoFormat),
+				    videoConfig.colorRange,
+				    videoConfig.colorTransfer,
+				    videoConfig.dither);
+}
+
+/* the SDR normalizer can hold back as many frames as the video one, which
+ * it then flushes after it */
+void HDevice::KeepSmoothing(long long start, long long smoothed)
+{
+	if (!videoConfig.sdrFrameCallback)
+		return;
+
+	size_t keep = (size_t)max(videoConfig.reorderWindow, 0) + 1;
+
+	sdrSmoothing.emplace_back(start, smoothed - start);
+	while (sdrSmoothing.size() > keep)
+		sdrSmoothing.pop_front();
+}
+
+void HDevice::DispatchSDR(FrameRef &frame)
+{
+	/* the video frame it was made from has been output already */
+	while (!sdrSmoothing.empty() &&
+	       sdrSmoothing.front().first < frame.startTime)
+		sdrSmoothing.pop_front();
+
+	if (!sdrSmoothing.empty() &&
+	    sdrSmoothing.front().first == frame.startTime) {
+		frame.startTime += sdrSmoothing.front().second;
+		frame.stopTime += sdrSmoothing.front().second;
+		sdrSmoothing.pop_front();
+	}
+
+	if (sdrDispatcher.Running())
+		sdrDispatcher.Push(std::move(frame));
+	else if (frame.size)
+		videoConfig.sdrFrameCallback(videoConfig, frame);
+}
+
+void HDevice::SetSliceExecutor(shared_ptr<SliceExecutor> executor)
+{
+	const ProcessingPriority priority = videoConfig.pipeline.priority;
+	const long long interval = videoConfig.frameInterval;
+
+	videoConverter.SetExecutor(executor, priority, interval);
+	sdrConverter.SetExecutor(executor, priority, interval);
+	flipConverter.SetExecutor(executor, priority, interval);
+}
+
+/* binds the conversion kernels for the configured format, so frames don't
+ * wait for it.  The roll isn't known yet, rotated frames rebind. */
+void HDevice::PrepareVideoConverter()
+{
+	const VideoPipeline &pipeline = videoConfig.pipeline;
+	FrameRef frame;
+	InitFrame(frame, true);
+
+	int x = pipeline.cropX, y = pipeline.cropY;
+	int cx = pipeline.cropCX, cy = pipeline.cropCY;
+	if (cx > 0 && cy > 0 &&
+	    ClipVideoRegion(frame.videoFormat, frame.cx, frame.cy, x, y, cx,
+			    cy)) {
+		frame.cx = cx;
+		frame.cy = cy;
+	}
+
+	videoConverter.Prepare(frame.videoFormat, frame.cx, frame.cy, 0,
+			       OutputVideoFormat(),
+			       VideoColorMatrix(frame.videoFormat),
+			       videoConfig.colorRange,
+			       videoConfig.colorTransfer, videoConfig.dither,
+			       videoConfig.upright, pipeline);
+}
+
+void HDevice::SendEncoded(bool video, EncodedData &data, long roll)
+{
+	shared_ptr<EncodedPacket> packet = data.assembler.Take();
+	if (!packet || !packet->Size())
+		return;
+
+	const ClockDomainEstimator &clock = video ? videoClock : audioClock;
+
+	FrameRef frame;
+	InitFrame(frame, video);
+	frame.startTime = data.lastStartTime;
+	frame.stopTime = data.lastStopTime;
+	frame.hostStartTime = clock.ToHost(data.lastStartTime);
+	frame.hostStopTime = clock.ToHost(data.lastStopTime);
+	frame.keyframe = data.lastKeyframe;
+	frame.rotation = roll;
+	frame.size = packet->Size();
+
+	bool segments = video ? videoConfig.frameCallback &&
+					videoConfig.encodedSegments
+			      : audioConfig.frameCallback &&
+					audioConfig.encodedSegments;
+
+	if (segments || packet->SegmentCount() == 1) {
+		/* zero copy: hand over the pooled chunks themselves */
+		frame.segments = packet->Segments();
+		frame.segmentCount = packet->SegmentCount();
+		frame.data[0] = (unsigned char *)frame.segments[0].data;
+		frame.owner = std::move(packet);
+
+	} else if (NeedsFrameOwner(video)) {
+		auto bytes = make_shared<vector<unsigned char>>(frame.size);
+		packet->CopyTo(bytes->data());
+		frame.data[0] = bytes->data();
+		frame.owner = std::move(bytes);
+
+	} else {
+		data.contiguous.resize(frame.size);
+		packet->CopyTo(data.contiguous.data());
+		frame.data[0] = data.contiguous.data();
+	}
+
+	frame.linesize[0] = (int)frame.size;
+	Deliver(video, frame);
+}
+
+void HDevice::FlushStream(bool video)
+{
+	EncodedData &data = video ? encodedVideo : encodedAudio;
+
+	SendEncoded(video, data, 0);
+	data.detector.Reset(video ? AccessUnitDetector::VideoSyntax(
+					    videoConfig.format)
+				  : AccessUnitDetector::AudioSyntax(
+					    audioConfig.format));
+
+	(video ? videoNormalizer : audioNormalizer).Flush();
+	if (video)
+		sdrNormalizer.Flush();
+	PublishStats(video);
+}
+
+void HDevice::ResetStreams()
+{
+	videoTimestamps.Reset();
+	audioTimestamps.Reset();
+	videoClock.Reset();
+	audioClock.Reset();
+	conversionWarned = false;
+	videoConverter.ResetStats();
+
+	encodedVideo.assembler.Reset();
+	encodedAudio.assembler.Reset();
+	encodedVideo.detector.Reset(
+		AccessUnitDetector::VideoSyntax(videoConfig.format));
+	encodedAudio.detector.Reset(
+		AccessUnitDetector::AudioSyntax(audioConfig.format));
+
+	/* encoded streams can have out-of-order presentation times, only
+	 * rebase those */
+	bool videoEncoded = (int)videoConfig.format >= 400;
+	bool audioEncoded = (int)audioConfig.format >= 200;
+
+	bool smooth = videoConfig.smoothTimestamps && !videoEncoded;
+	videoSmoother.Reset(smooth ? videoConfig.frameInterval : 0);
+
+	/* the streams share one timeline, so that rebasing keeps them in
+	 * sync */
+	videoNormalizer.Restart(
+		timeline, videoConfig.reorderWindow, !videoEncoded,
+		[this](FrameRef &frame) {
+			long long start = videoSmoother.Smooth(frame.startTime);
+			KeepSmoothing(frame.startTime, start);
+			frame.stopTime += start - frame.startTime;
+			frame.startTime = start;
+			Dispatch(true, frame);
+		});
+	audioNormalizer.Restart(timeline, audioConfig.reorderWindow,
+				!audioEncoded, [this](FrameRef &frame) {
+					Dispatch(false, frame);
+				});
+
+	/* fed the same times as the video, so it comes to the same ones */
+	sdrSmoothing.clear();
+	sdrNormalizer.Restart(timeline, videoConfig.reorderWindow,
+			      !videoEncoded,
+			      [this](FrameRef &frame) { DispatchSDR(frame); });
+
+	PublishStats(true);
+	PublishStats(false);
+}
+
+long long HDevice::SampleDuration(bool video, size_t size) const
+{
+	if (video)
+		return videoConfig.frameInterval;
+
+	const AM_MEDIA_TYPE *pmt = audioMediaType;
+	if (pmt->formattype != FORMAT_WaveFormatEx || !pmt->pbFormat)
+		return 0;
+
+	const WAVEFORMATEX *wfex = (const WAVEFORMATEX *)pmt->pbFormat;
+	if (!wfex->nBlockAlign || !wfex->nSamplesPerSec)
+		return 0;
+
+	long long frames = (long long)(size / wfex->nBlockAlign);
+	return frames * 10000000LL / wfex->nSamplesPerSec;
 }
 
 void HDevice::Receive(bool isVideo, IMediaSample *sample)
@@ -115,34 +450,29 @@ void HDevice::Receive(bool isVideo, IMediaSample *sample)
 	if (!sample)
 		return;
 
-	if (isVideo ? !videoConfig.callback : !audioConfig.callback)
+	if (!HasCallback(isVideo))
 		return;
 
 	if (reactivatePending)
 		return;
 
+	/* device properties are polled by the property monitor, the
+	 * streaming thread only looks at the latest snapshot */
+	const DeviceProperties props = propertyMonitor.Get();
+
 	/* auto-rotation for devices such as streamcam */
-	if (isVideo && rotatableDevice) {
-		ComQIPtr<IAMCameraControl> cc(videoFilter);
-		if (cc) {
-			long ccf = 0;
-			cc->Get(CameraControl_Roll, &roll, &ccf);
-		}
-	}
+	if (isVideo && rotatableDevice)
+		roll = props.roll;
 
-	if (isVideo && videoConfig.reactivateCallback) {
-		ComQIPtr<IKsPropertySet> propertySet(videoFilter);
-		if (propertySet) {
-			const bool hdr = IsVendorVideoHDR(propertySet);
-			if (deviceHdrSignal != hdr) {
-				deviceHdrSignal = hdr;
+	if (isVideo && videoConfig.reactivateCallback && videoPropertySet) {
+		if (deviceHdrSignal != props.hdr) {
+			deviceHdrSignal = props.hdr;
 #ifdef ENABLE_HEVC
-				SetVendorVideoFormat(propertySet, hdr);
+			SetVendorVideoFormat(videoPropertySet, props.hdr);
 #endif
-				videoConfig.reactivateCallback();
-				reactivatePending = true;
-				return;
-			}
+			videoConfig.reactivateCallback();
+			reactivatePending = true;
+			return;
 		}
 	}
 
@@ -165,28 +495,160 @@ void HDevice::Receive(bool isVideo, IMediaSample *sample)
 
 	long long startTime, stopTime;
 	bool hasTime = SUCCEEDED(sample->GetTime(&startTime, &stopTime));
+	long long arrival = GetHostTime();
+
+	/* learn how the device clock relates to the host clock */
+	ClockDomainEstimator &clock = isVideo ? videoClock : audioClock;
+	if (hasTime)
+		clock.Observe(startTime, arrival);
 
 	if (encoded) {
 		EncodedData &data = isVideo ? encodedVideo : encodedAudio;
+		StreamStats &stats = isVideo ? videoStats : audioStats;
 
 		/* packets that have time are the first packet in a group of
 		 * segments */
 		if (hasTime) {
-			SendToCallback(isVideo, data.bytes.data(),
-				       data.bytes.size(), data.lastStartTime,
-				       data.lastStopTime, roll);
+			SendEncoded(isVideo, data, roll);
+			data.detector.BeginUnit(ptr, (size_t)size);
 
-			data.bytes.resize(0);
 			data.lastStartTime = startTime;
 			data.lastStopTime = stopTime;
+			data.lastKeyframe = sample->IsSyncPoint() == S_OK;
+
+		} else if (!data.detector.ContinueUnit(ptr, (size_t)size)) {
+			/* the segment starts a packet of its own, which takes
+			 * over where the last one ended */
+			long long duration = data.lastStopTime -
+					     data.lastStartTime;
+
+			SendEncoded(isVideo, data, roll);
+			data.detector.BeginUnit(ptr, (size_t)size);
+
+			data.lastStartTime = data.lastStopTime;
+			data.lastStopTime += duration;
+			data.lastKeyframe = sample->IsSyncPoint() == S_OK;
+			stats.splitPackets++;
+		}
+
+		data.assembler.Append((unsigned char *)ptr, (size_t)size);
+		data.detector.Parse(ptr, (size_t)size);
+
+		/* send the packet now rather than when the next one starts */
+		if (data.detector.Complete()) {
+			SendEncoded(isVideo, data, roll);
+			data.detector.SentEarly();
+			stats.packetsSentEarly++;
+		}
+
+	} else {
+		TimestampSynthesizer &timestamps = isVideo ? videoTimestamps
+							   : audioTimestamps;
+		long long duration = SampleDuration(isVideo, (size_t)size);
+
+		FrameRef frame;
+		InitFrame(frame, isVideo);
+
+		/* some devices leave out sample times, make them up rather
+		 * than losing the sample */
+		if (hasTime) {
+			timestamps.Observe(startTime, stopTime, duration,
+					   arrival);
+		} else {
+			timestamps.Synthesize(arrival, duration, startTime,
+					      stopTime);
+			frame.synthesized = true;
+			(isVideo ? videoStats : audioStats)
+				.synthesizedTimestamps++;
+		}
+
+		frame.startTime = startTime;
+		frame.stopTime = stopTime;
+		frame.rotation = roll;
+
+		if (clock.Valid()) {
+			frame.hostStartTime = clock.ToHost(startTime);
+			frame.hostStopTime = clock.ToHost(stopTime);
+		} else {
+			frame.hostStartTime = arrival;
+			frame.hostStopTime = arrival + (stopTime - startTime);
+		}
+
+		/* the sample is only referenced when frameCallback may keep
+		 * the frame.  Frames that are queued or held back for
+		 * reordering are copied out of the sample instead (by the
+		 * dispatcher or the normalizer), so neither a consumer that
+		 * falls behind nor the reorder window can hold up the device,
+		 * which only has a few samples. */
+		FrameDispatcher &dispatcher = isVideo ? videoDispatcher
+						      : audioDispatcher;
+		bool keeps = isVideo ? videoConfig.frameCallback &&
+					       videoConfig.reorderWindow <= 0
+				     : audioConfig.frameCallback &&
+					       audioConfig.reorderWindow <= 0;
+		if (keeps && !dispatcher.Running())
+			frame.owner = MakeSampleOwner(sample);
+
+		FrameRef sdr;
+
+		if (isVideo) {
+			SetVideoFramePlanes(frame, ptr, (size_t)size);
+
+			/* describe bottom-up RGB top-down, so that it is also
+			 * converted (or copied, with Flip) that way */
+			if (videoConfig.bottomUp != BottomUpMode::AsCaptured &&
+			    VideoFrameBottomUp(frame.videoFormat,
+					       videoConfig.cy_flip))
+				ReverseVideoFrameRows(frame);
+
+			if (videoConfig.sdrFrameCallback &&
+			    frame.videoFormat == VideoFormat::P010) {
+				sdr = frame;
+				if (!ConvertSDRFrame(sdr))
+					sdr.Release();
+			}
+
+			/* callback is promised the whole buffer of frames that
+			 * are only cropped */
+			bool cropInPlace = !!videoConfig.frameCallback;
+
+			VideoFormat output = OutputVideoFormat();
+			ColorMatrix matrix =
+				VideoColorMatrix(frame.videoFormat);
+			if (!videoConverter.Convert(frame, output, matrix,
+						    videoConfig.colorRange,
+						    videoConfig.colorTransfer,
+						    videoConfig.dither,
+						    videoConfig.upright,
+						    videoConfig.pipeline,
+						    cropInPlace) &&
+			    !conversionWarned) {
+				Warning(L"Cannot convert video from format %d "
+					L"to %d, delivering it as captured",
+					(int)frame.videoFormat, (int)output);
+				conversionWarned = true;
+			}
+
+			if (videoConfig.bottomUp == BottomUpMode::Flip)
+				flipConverter.Flip(frame);
+		} else {
+			frame.data[0] = ptr;
+			frame.linesize[0] = size;
+			frame.size = (size_t)size;
 		}
 
-		data.bytes.insert(data.bytes.end(), (unsigned char *)ptr,
-				  (unsigned char *)ptr + size);
+		/* converted frames are in buffers of their own already */
+		if (dispatcher.Running() && !frame.owner)
+			dispatcher.Detach(frame);
+
+		Deliver(isVideo, frame);
 
-	} else if (hasTime) {
-		SendToCallback(isVideo, ptr, size, startTime, stopTime, roll);
+		/* after its frame, so that frame's smoothing is known */
+		if (sdr.size)
+			sdrNormalizer.Push(std::move(sdr));
 	}
+
+	PublishStats(isVideo);
 }
 
 void HDevice::ConvertVideoSettings()
@@ -205,7 +667,9 @@ void HDevice::ConvertVideoSettings()
 		bool same = videoConfig.internalFormat == videoConfig.format;
 		GetMediaTypeVFormat(videoMediaType, videoConfig.internalFormat);
 
-		if (same)
+		/* XRGB asked of an RGB24 device is still converted to XRGB */
+		if (same && !(videoConfig.format == VideoFormat::XRGB &&
+			      videoConfig.internalFormat == VideoFormat::RGB24))
 			videoConfig.format = videoConfig.internalFormat;
 	}
 }
@@ -344,10 +808,30 @@ bool HDevice::SetupVideoCapture(IBaseFilter *filter, VideoConfig &config)
 
 	PinCaptureInfo info;
 	info.callback = [this](IMediaSample *s) { Receive(true, s); };
+	info.endOfStream = [this]() { FlushStream(true); };
+	info.newSegment = [this]() {
+		videoNormalizer.NewSegment();
+		sdrNormalizer.NewSegment();
+	};
 	info.expectedMajorType = videoMediaType->majortype;
 
+	VideoFormat native = videoConfig.internalFormat;
+	VideoFormat wanted = videoConfig.format;
+	bool convert = wanted != VideoFormat::Any && wanted != native;
+
+	videoNative = videoConfig.convertInLibrary &&
+		      (!convert ||
+		       GetConvertKernel(native, wanted, GetCPUFeatures()));
+
+	if (videoConfig.convertInLibrary && !videoNative)
+		Info(L"No library conversion from video format %d to %d, "
+		     L"using DirectShow filters",
+		     (int)native, (int)wanted);
+
 	/* attempt to force intermediary filters for these types */
-	if (videoConfig.format == VideoFormat::XRGB)
+	if (videoNative)
+		info.expectedSubType = videoMediaType->subtype;
+	else if (videoConfig.format == VideoFormat::XRGB)
 		info.expectedSubType = MEDIASUBTYPE_RGB32;
 	else if (videoConfig.format == VideoFormat::ARGB)
 		info.expectedSubType = MEDIASUBTYPE_ARGB32;
@@ -362,6 +846,15 @@ bool HDevice::SetupVideoCapture(IBaseFilter *filter, VideoConfig &config)
 	else
 		info.expectedSubType = videoMediaType->subtype;
 
+	if (!convert)
+		videoConversionPath = ConversionPath::None;
+	else if (videoNative)
+		videoConversionPath = ConversionPath::Library;
+	else if (info.expectedSubType != videoMediaType->subtype)
+		videoConversionPath = ConversionPath::DirectShow;
+	else
+		videoConversionPath = ConversionPath::None;
+
 	videoCapture = new CaptureFilter(info);
 	videoFilter = filter;
 
@@ -383,6 +876,8 @@ bool HDevice::SetVideoConfig(VideoConfig *config)
 	graph->RemoveFilter(videoCapture);
 	videoFilter.Release();
 	videoCapture.Release();
+	videoPropertySet.Release();
+	cameraControl.Release();
 
 	if (!config)
 		return true;
@@ -423,6 +918,19 @@ bool HDevice::SetVideoConfig(VideoConfig *config)
 	if (!SetupVideoCapture(filter, videoConfig))
 		return false;
 
+	if (videoCapture)
+		PrepareVideoConverter();
+	PublishStats(true);
+
+	/* cache the interfaces the property monitor polls */
+	videoPropertySet = ComQIPtr<IKsPropertySet>(videoFilter);
+	if (rotatableDevice)
+		cameraControl = ComQIPtr<IAMCameraControl>(videoFilter);
+
+	DeviceProperties props;
+	props.hdr = deviceHdrSignal;
+	propertyMonitor.Set(props);
+
 	*config = videoConfig;
 	return true;
 }
@@ -522,6 +1030,8 @@ bool HDevice::SetupAudioCapture(IBaseFilter *filter, AudioConfig &config)
 
 	PinCaptureInfo info;
 	info.callback = [this](IMediaSample *s) { Receive(false, s); };
+	info.endOfStream = [this]() { FlushStream(false); };
+	info.newSegment = [this]() { audioNormalizer.NewSegment(); };
 	info.expectedMajorType = audioMediaType->majortype;
 	info.expectedSubType = audioMediaType->subtype;
 
@@ -838,6 +1348,67 @@ void HDevice::DisconnectFilters()
 	}
 }
 
+void HDevice::PollProperties(DeviceProperties &props)
+{
+	if (cameraControl) {
+		long flags = 0;
+		cameraControl->Get(CameraControl_Roll, &props.roll, &flags);
+	}
+
+	if (videoPropertySet && videoConfig.reactivateCallback)
+		props.hdr = IsVendorVideoHDR(videoPropertySet);
+}
+
+void HDevice::StartPropertyMonitor()
+{
+	bool needsMonitor = !!cameraControl ||
+			    (videoPropertySet && videoConfig.reactivateCallback);
+	if (!videoCapture || !needsMonitor)
+		return;
+
+	propertyMonitor.Start(videoConfig.propertyPollMs,
+			      [this](DeviceProperties &props) {
+				      PollProperties(props);
+			      });
+}
+
+void HDevice::StartDispatchers()
+{
+	if (videoCapture && videoConfig.delivery == DeliveryMode::Asynchronous) {
+		size_t depth = (size_t)max(videoConfig.queueDepth, 1);
+		videoDispatcher.Start(depth, videoConfig.queuePolicy,
+				      videoConfig.blockTimeoutMs,
+				      [this](const FrameRef &frame) {
+					      SendToCallback(true, frame);
+				      });
+
+		if (videoConfig.sdrFrameCallback)
+			sdrDispatcher.Start(
+				depth, videoConfig.queuePolicy,
+				videoConfig.blockTimeoutMs,
+				[this](const FrameRef &frame) {
+					videoConfig.sdrFrameCallback(
+						videoConfig, frame);
+				});
+	}
+
+	if (audioCapture && audioConfig.delivery == DeliveryMode::Asynchronous) {
+		size_t depth = (size_t)max(audioConfig.queueDepth, 1);
+		audioDispatcher.Start(depth, audioConfig.queuePolicy,
+				      audioConfig.blockTimeoutMs,
+				      [this](const FrameRef &frame) {
+					      SendToCallback(false, frame);
+				      });
+	}
+}
+
+void HDevice::StopDispatchers()
+{
+	videoDispatcher.Stop();
+	audioDispatcher.Stop();
+	sdrDispatcher.Stop();
+}
+
 Result HDevice::Start()
 {
 	HRESULT hr;
@@ -848,9 +1419,20 @@ Result HDevice::Start()
 	if (!!rocketEncoder)
 		Sleep(ROCKET_WAIT_TIME_MS);
 
+	ResetStreams();
+	StartPropertyMonitor();
+	StartDispatchers();
+	if (videoCapture && videoConfig.pipeline.threads != 1)
+		SetSliceExecutor(
+			SliceExecutor::Shared(videoConfig.pipeline.threads));
+
 	hr = control->Run();
 
 	if (FAILED(hr)) {
+		SetSliceExecutor(nullptr);
+		StopDispatchers();
+		propertyMonitor.Stop();
+
 		if (hr == (HRESULT)0x8007001F) {
 			WarningHR(L"Run failed, device already in use", hr);
 			return Result::InUse;
@@ -868,6 +1450,15 @@ void HDevice::Stop()
 {
 	if (active) {
 		control->Stop();
+
+		/* send out whatever is still held back, like the last
+		 * encoded packets which never see another one start */
+		FlushStream(true);
+		FlushStream(false);
+
+		SetSliceExecutor(nullptr);
+		StopDispatchers();
+		propertyMonitor.Stop();
 		active = false;
 	}
 }
@@ -20,8 +20,20 @@
 #pragma once
 
 #include "../dshowcapture.hpp"
+#include "access-unit-detector.hpp"
 #include "capture-filter.hpp"
-
+#include "clock-domain.hpp"
+#include "frame-dispatcher.hpp"
+#include "packet-assembler.hpp"
+#include "property-monitor.hpp"
+#include "slice-executor.hpp"
+#include "timestamp-normalizer.hpp"
+#include "timestamp-smoother.hpp"
+#include "timestamp-synth.hpp"
+#include "video-convert.hpp"
+
+#include <deque>
+#include <mutex>
 #include <string>
 #include <vector>
 using namespace std;
@@ -29,9 +41,14 @@ using namespace std;
 namespace DShow {
 
 struct EncodedData {
+	inline explicit EncodedData(size_t chunkSize) : assembler(chunkSize) {}
+
 	long long lastStartTime = 0;
 	long long lastStopTime = 0;
-	vector<unsigned char> bytes;
+	bool lastKeyframe = true;
+	PacketAssembler assembler;
+	AccessUnitDetector detector;
+	vector<unsigned char> contiguous;
 };
 
 struct EncodedDevice {
@@ -57,6 +74,8 @@ struct HDevice {
 	ComPtr<CaptureFilter> audioCapture;
 	ComPtr<IBaseFilter> audioOutput;
 	ComPtr<IBaseFilter> rocketEncoder;
+	ComPtr<IKsPropertySet> videoPropertySet;
+	ComPtr<IAMCameraControl> cameraControl;
 	MediaType videoMediaType;
 	MediaType audioMediaType;
 	VideoConfig videoConfig;
@@ -69,8 +88,42 @@ struct HDevice {
 	bool initialized;
 	bool active;
 
-	EncodedData encodedVideo;
-	EncodedData encodedAudio;
+	EncodedData encodedVideo{256 * 1024};
+	EncodedData encodedAudio{16 * 1024};
+
+	PropertyMonitor propertyMonitor;
+
+	TimestampSynthesizer videoTimestamps;
+	TimestampSynthesizer audioTimestamps;
+	StreamTimeline timeline;
+	TimestampNormalizer videoNormalizer;
+	TimestampNormalizer audioNormalizer;
+	TimestampNormalizer sdrNormalizer;
+	TimestampSmoother videoSmoother;
+
+	/* start times of video frames that were output and how far they
+	 * were smoothed, so their SDR copies are moved the same way */
+	deque<pair<long long, long long>> sdrSmoothing;
+
+	VideoConverter videoConverter;
+	VideoConverter sdrConverter;
+	VideoConverter flipConverter;
+	bool conversionWarned = false;
+	bool videoNative = false;
+	ConversionPath videoConversionPath = ConversionPath::None;
+	ClockDomainEstimator videoClock;
+	ClockDomainEstimator audioClock;
+
+	FrameDispatcher videoDispatcher;
+	FrameDispatcher audioDispatcher;
+	FrameDispatcher sdrDispatcher;
+	StreamStats videoStats;
+	StreamStats audioStats;
+
+	/* copies of the stats for other threads, see PublishStats */
+	mutable mutex statsMutex;
+	StreamStats videoStatsSnapshot;
+	StreamStats audioStatsSnapshot;
 
 	HDevice();
 	~HDevice();
@@ -82,9 +135,25 @@ struct HDevice {
 	bool EnsureActive(const wchar_t *func);
 	bool EnsureInactive(const wchar_t *func);
 
-	inline void SendToCallback(bool video, unsigned char *data, size_t size,
-				   long long startTime, long long stopTime,
-				   long rotation);
+	inline bool HasCallback(bool video) const;
+	inline void SendToCallback(bool video, const FrameRef &frame);
+	inline bool NeedsFrameOwner(bool video) const;
+	inline void Deliver(bool video, FrameRef &frame);
+	void Dispatch(bool video, FrameRef &frame);
+	void PublishStats(bool video);
+	void GetStats(bool video, StreamStats &stats) const;
+	void InitFrame(FrameRef &frame, bool video) const;
+	VideoFormat OutputVideoFormat() const;
+	void SendEncoded(bool video, EncodedData &data, long roll);
+	ColorMatrix VideoColorMatrix(VideoFormat format) const;
+	bool ConvertSDRFrame(FrameRef &frame);
+	void KeepSmoothing(long long start, long long smoothed);
+	void DispatchSDR(FrameRef &frame);
+	void SetSliceExecutor(shared_ptr<SliceExecutor> executor);
+	void PrepareVideoConverter();
+	void FlushStream(bool video);
+	void ResetStreams();
+	long long SampleDuration(bool video, size_t size) const;
 
 	void Receive(bool video, IMediaSample *sample);
 
@@ -113,6 +182,10 @@ struct HDevice {
 	void SetAudioBuffering(int bufferingMs);
 	bool ConnectFilters();
 	void DisconnectFilters();
+	void PollProperties(DeviceProperties &props);
+	void StartPropertyMonitor();
+	void StartDispatchers();
+	void StopDispatchers();
 	Result Start();
 	void Stop();
 };
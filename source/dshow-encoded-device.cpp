@@ -226,6 +226,8 @@ bool HDevice::SetupEncodedVideoCapture(IBaseFilter *filter, VideoConfig &config,
 
 	PinCaptureInfo pci;
 	pci.callback = [this](IMediaSample *s) { Receive(true, s); };
+	pci.endOfStream = [this]() { FlushStream(true); };
+	pci.newSegment = [this]() { videoNormalizer.NewSegment(); };
 	pci.expectedMajorType = mtVideo->majortype;
 	pci.expectedSubType = mtVideo->subtype;
 
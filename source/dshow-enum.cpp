@@ -204,8 +204,11 @@ static bool ClosestVideoMTCallback(ClosestVideoData &data,
 	VIDEOINFOHEADER *vih = (VIDEOINFOHEADER *)copiedMT->pbFormat;
 	BITMAPINFOHEADER *bmih = GetBitmapInfoHeader(copiedMT);
 
+	/* RGB24 used to be reported as XRGB, so it still matches XRGB */
 	if (data.config.internalFormat != VideoFormat::Any &&
-	    data.config.internalFormat != info.format)
+	    data.config.internalFormat != info.format &&
+	    !(data.config.internalFormat == VideoFormat::XRGB &&
+	      info.format == VideoFormat::RGB24))
 		return true;
 
 	int xVal = 0;
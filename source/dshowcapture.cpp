@@ -120,6 +120,24 @@ bool Device::GetAudioDeviceId(DeviceId &id) const
 	return true;
 }
 
+bool Device::GetVideoStats(StreamStats &stats) const
+{
+	if (context->videoCapture == NULL)
+		return false;
+
+	context->GetStats(true, stats);
+	return true;
+}
+
+bool Device::GetAudioStats(StreamStats &stats) const
+{
+	if (context->audioCapture == NULL)
+		return false;
+
+	context->GetStats(false, stats);
+	return true;
+}
+
 static void OpenPropertyPages(HWND hwnd, IUnknown *propertyObject)
 {
 	if (!propertyObject)
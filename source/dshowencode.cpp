@@ -81,6 +81,26 @@ bool VideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
 			       packet, new_packet);
 }
 
+bool VideoEncoder::LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+			     int linesize[DSHOW_MAX_PLANES])
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	return context->LockFrame(data, linesize);
+}
+
+bool VideoEncoder::EncodeLocked(long long timestampStart,
+				long long timestampEnd, EncoderPacket &packet,
+				bool &new_packet)
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	return context->EncodeLocked(timestampStart, timestampEnd, packet,
+				     new_packet);
+}
+
 static bool EnumVideoEncoder(vector<DeviceId> &encoders, IBaseFilter *encoder,
 			     const wchar_t *deviceName,
 			     const wchar_t *devicePath)
@@ -18,6 +18,8 @@
  */
 
 #include "encoder.hpp"
+#include "cpu-features.hpp"
+#include "frame-ref.hpp"
 #include "log.hpp"
 #include "avermedia-encode.h"
 
@@ -332,6 +334,20 @@ bool HVideoEncoder::SetConfig(VideoEncoderConfig &config)
 
 	this->config = config;
 
+	if (config.format != VideoFormat::YV12) {
+		inputKernel = GetConvertKernel(config.format, VideoFormat::YV12,
+					       GetCPUFeatures());
+		inputColor = GetRGBCoefficients(config.colorMatrix,
+						config.colorRange);
+
+		if (!inputKernel) {
+			Warning(L"Video encoder can't convert from video "
+				L"format %d",
+				(int)config.format);
+			return false;
+		}
+	}
+
 	if (!SetupEncoder(filter)) {
 		Warning(L"Failed to set up encoder");
 		return false;
@@ -378,6 +394,47 @@ void HVideoEncoder::Receive(IMediaSample *s)
 	packetMutex.unlock();
 }
 
+/* Encode takes plane sizes; the rows of each plane are evenly spaced */
+static inline void PlaneStrides(VideoFormat format, int cy,
+				const size_t planeSize[DSHOW_MAX_PLANES],
+				int strides[DSHOW_MAX_PLANES])
+{
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		int rows = VideoPlaneHeight(format, i, cy);
+		strides[i] = rows ? (int)(planeSize[i] / (size_t)rows) : 0;
+	}
+}
+
+void HVideoEncoder::SendConverted(unsigned char *data[DSHOW_MAX_PLANES],
+				  size_t linesize[DSHOW_MAX_PLANES],
+				  long long timestampStart,
+				  long long timestampEnd)
+{
+	unsigned char *planes[DSHOW_MAX_PLANES];
+	int strides[DSHOW_MAX_PLANES];
+	int srcStrides[DSHOW_MAX_PLANES];
+
+	/* converted in one pass straight into the sample */
+	if (!output->LockFrame(planes, strides))
+		return;
+
+	PlaneStrides(config.format, config.cy, linesize, srcStrides);
+
+	ConvertFrame convert = {};
+	for (int i = 0; i < 4; i++) {
+		convert.src[i] = data[i];
+		convert.srcStride[i] = srcStrides[i];
+		convert.dst[i] = planes[i];
+		convert.dstStride[i] = strides[i];
+	}
+	convert.width = config.cx;
+	convert.height = config.cy;
+	convert.toYUV = inputColor;
+
+	inputKernel(convert, 0, config.cy);
+	output->UnlockSampleData(timestampStart, timestampEnd);
+}
+
 bool HVideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
 			   size_t linesize[DSHOW_MAX_PLANES],
 			   long long timestampStart, long long timestampEnd,
@@ -385,10 +442,49 @@ bool HVideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
 {
 	new_packet = false;
 
-	if (!active)
+	/* the locked sample is the one this would be sent in */
+	if (!active || locked)
+		return false;
+
+	if (inputKernel) {
+		SendConverted(data, linesize, timestampStart, timestampEnd);
+	} else {
+		int strides[DSHOW_MAX_PLANES];
+		PlaneStrides(config.format, config.cy, linesize, strides);
+		output->SendFrame(data, strides, timestampStart, timestampEnd);
+	}
+
+	return ReceivePacket(timestampStart, packet, new_packet);
+}
+
+bool HVideoEncoder::LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+			      int linesize[DSHOW_MAX_PLANES])
+{
+	if (!active || locked)
+		return false;
+
+	locked = output->LockFrame(data, linesize);
+	return locked;
+}
+
+bool HVideoEncoder::EncodeLocked(long long timestampStart,
+				 long long timestampEnd, EncoderPacket &packet,
+				 bool &new_packet)
+{
+	new_packet = false;
+
+	if (!active || !locked)
 		return false;
 
-	output->Send(data, linesize, timestampStart, timestampEnd);
+	output->UnlockSampleData(timestampStart, timestampEnd);
+	locked = false;
+
+	return ReceivePacket(timestampStart, packet, new_packet);
+}
+
+bool HVideoEncoder::ReceivePacket(long long timestampStart,
+				  EncoderPacket &packet, bool &new_packet)
+{
 	ptsVals.push_back(timestampStart);
 
 	packetMutex.lock();
@@ -22,6 +22,7 @@
 #include "../dshowcapture.hpp"
 #include "output-filter.hpp"
 #include "capture-filter.hpp"
+#include "video-convert.hpp"
 
 #include <string>
 #include <vector>
@@ -55,6 +56,13 @@ struct HVideoEncoder {
 
 	VideoEncoderConfig config;
 
+	/* converts frames that aren't in the encoder's own format */
+	ConvertKernel inputKernel = nullptr;
+	RGBCoefficients inputColor = {};
+
+	/* a sample is locked for direct rendering */
+	bool locked = false;
+
 	mutex packetMutex;
 	deque<EncodedData> packets;
 	EncodedData curPacket;
@@ -77,10 +85,22 @@ struct HVideoEncoder {
 
 	bool SetConfig(VideoEncoderConfig &config);
 
+	void SendConverted(unsigned char *data[DSHOW_MAX_PLANES],
+			   size_t linesize[DSHOW_MAX_PLANES],
+			   long long timestampStart, long long timestampEnd);
+
 	bool Encode(unsigned char *frame[DSHOW_MAX_PLANES],
 		    size_t linesize[DSHOW_MAX_PLANES], long long timestampStart,
 		    long long timestampEnd, EncoderPacket &packet,
 		    bool &new_packet);
+
+	bool LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+		       int linesize[DSHOW_MAX_PLANES]);
+	bool EncodeLocked(long long timestampStart, long long timestampEnd,
+			  EncoderPacket &packet, bool &new_packet);
+
+	bool ReceivePacket(long long timestampStart, EncoderPacket &packet,
+			   bool &new_packet);
 };
 
 };
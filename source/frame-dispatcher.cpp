@@ -0,0 +1,273 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "frame-dispatcher.hpp"
+#include "frame-ref.hpp"
+
+#include <chrono>
+
+namespace DShow {
+
+/* times to retry a push into a ring that has room while the consumer
+ * finishes popping */
+#define PUSH_TRIES 64
+
+void FrameDispatcher::Start(size_t depth, QueuePolicy policy_,
+			    int blockTimeoutMs_, DeliverProc deliver_)
+{
+	Stop();
+
+	if (policy_ == QueuePolicy::Latest)
+		depth = 1;
+
+	ring.Reset(depth);
+
+	/* one buffer for each queued frame, plus the one being delivered and
+	 * the one being queued */
+	pool.reset();
+	poolDepth = depth + 2;
+	deliver = std::move(deliver_);
+	policy = policy_;
+	blockTimeoutMs = blockTimeoutMs_;
+	waitKeyframe = false;
+	stopping = false;
+	running = true;
+	thread = std::thread(&FrameDispatcher::Thread, this);
+}
+
+void FrameDispatcher::Stop()
+{
+	if (!running)
+		return;
+
+	stopping = true;
+	Wake();
+	thread.join();
+
+	running = false;
+	deliver = nullptr;
+	pool.reset();
+}
+
+void FrameDispatcher::Wake()
+{
+	/* pairs with the fence in WaitForFrames: either the consumer sees the
+	 * new frame before sleeping, or we see that it's sleeping */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(mutex);
+		cv.notify_one();
+	}
+}
+
+void FrameDispatcher::WakeProducer()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (producerWaiting.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(spaceMutex);
+		spaceCV.notify_one();
+	}
+}
+
+bool FrameDispatcher::WaitForSpace()
+{
+	std::unique_lock<std::mutex> lock(spaceMutex);
+
+	producerWaiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	bool space = spaceCV.wait_for(
+		lock, std::chrono::milliseconds(blockTimeoutMs),
+		[this]() { return !ring.Full() || stopping; });
+
+	producerWaiting.store(false, std::memory_order_relaxed);
+	return space && !ring.Full();
+}
+
+size_t FrameDispatcher::Evict(size_t count)
+{
+	FrameRef evicted;
+	size_t total = 0;
+
+	while (total < count && ring.Pop(evicted)) {
+		evicted.Release();
+		total++;
+	}
+
+	return total;
+}
+
+void FrameDispatcher::Detach(FrameRef &frame)
+{
+	/* the pool is sized to the largest frame yet, which only grows for
+	 * audio and when the video format changes */
+	CopyFrameToPool(frame, pool, poolDepth);
+}
+
+/* the consumer takes a frame's place in the ring before it has finished
+ * moving the frame out, and until then a push into that cell fails even
+ * though the ring isn't full */
+bool FrameDispatcher::PushWhenFree(FrameRef &frame)
+{
+	for (int i = 0; i < PUSH_TRIES; i++) {
+		if (ring.Push(std::move(frame)))
+			return true;
+		if (ring.Full())
+			return false;
+
+		std::this_thread::yield();
+	}
+
+	return false;
+}
+
+/* every frame that is discarded, the incoming one included if it can't be
+ * queued after all, is counted against the policy */
+bool FrameDispatcher::PushFull(FrameRef &frame)
+{
+	switch (policy) {
+	case QueuePolicy::DropNewest:
+		break;
+
+	case QueuePolicy::DropOldest:
+	case QueuePolicy::Latest: {
+		std::atomic<unsigned long long> &dropped =
+			policy == QueuePolicy::Latest ? droppedLatest
+						      : droppedOldest;
+
+		dropped += Evict(1);
+		if (PushWhenFree(frame))
+			return true;
+
+		dropped++;
+		return false;
+	}
+
+	case QueuePolicy::Block:
+		if (WaitForSpace() && PushWhenFree(frame))
+			return true;
+
+		droppedBlockTimeout++;
+		return false;
+
+	case QueuePolicy::DropUntilKeyframe:
+		/* a keyframe makes everything queued before it redundant for
+		 * a consumer that is behind, so start over from it */
+		if (frame.keyframe) {
+			droppedUntilKeyframe += Evict(ring.Capacity());
+			if (PushWhenFree(frame))
+				return true;
+		}
+
+		waitKeyframe = true;
+		droppedUntilKeyframe++;
+		return false;
+	}
+
+	droppedNewest++;
+	return false;
+}
+
+bool FrameDispatcher::Push(FrameRef &&frame)
+{
+	if (waitKeyframe) {
+		if (!frame.keyframe) {
+			droppedUntilKeyframe++;
+			return false;
+		}
+
+		waitKeyframe = false;
+	}
+
+	if (!frame.owner)
+		Detach(frame);
+
+	if (!PushWhenFree(frame)) {
+		overflows++;
+
+		if (!PushFull(frame))
+			return false;
+	}
+
+	size_t size = ring.Size();
+	size_t prev = highWater.load(std::memory_order_relaxed);
+	while (size > prev && !highWater.compare_exchange_weak(prev, size))
+		;
+
+	Wake();
+	return true;
+}
+
+bool FrameDispatcher::WaitForFrames()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	sleeping.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	cv.wait(lock, [this]() { return !ring.Empty() || stopping; });
+
+	sleeping.store(false, std::memory_order_relaxed);
+	return !ring.Empty();
+}
+
+void FrameDispatcher::Thread()
+{
+	FrameRef frame;
+
+	for (;;) {
+		while (ring.Pop(frame)) {
+			WakeProducer();
+			deliver(frame);
+			frame.Release();
+			delivered++;
+		}
+
+		if (!WaitForFrames())
+			break;
+	}
+}
+
+void FrameDispatcher::GetStats(StreamStats &stats) const
+{
+	stats.delivered = delivered;
+	stats.queueHighWater = highWater;
+	stats.queueOverflows = overflows;
+	stats.droppedNewest = droppedNewest;
+	stats.droppedOldest = droppedOldest;
+	stats.droppedLatest = droppedLatest;
+	stats.droppedBlockTimeout = droppedBlockTimeout;
+	stats.droppedUntilKeyframe = droppedUntilKeyframe;
+}
+
+void FrameDispatcher::ResetStats()
+{
+	delivered = 0;
+	highWater = 0;
+	overflows = 0;
+	droppedNewest = 0;
+	droppedOldest = 0;
+	droppedLatest = 0;
+	droppedBlockTimeout = 0;
+	droppedUntilKeyframe = 0;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+#include "packet-assembler.hpp"
+#include "spsc-ring.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace DShow {
+
+/**
+ * Hands frames from the DirectShow streaming thread over to a library-owned
+ * thread that calls the user callback, so a slow consumer can't stall the
+ * device.  Push is only ever called from the streaming thread, and applies
+ * the queue policy when the consumer falls behind.
+ *
+ * Frames without an owner borrow the device's sample buffers, which the
+ * device only has a few of.  They are copied into pooled buffers as they
+ * are queued, so that queued frames never hold up the capture driver.
+ */
+class FrameDispatcher {
+public:
+	typedef std::function<void(const FrameRef &frame)> DeliverProc;
+
+private:
+	SPSCRing<FrameRef> ring;
+	DeliverProc deliver;
+	QueuePolicy policy = QueuePolicy::DropNewest;
+	int blockTimeoutMs = 0;
+	bool waitKeyframe = false;
+
+	std::shared_ptr<ChunkPool> pool;
+	size_t poolDepth = 0;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::atomic<bool> sleeping{false};
+	std::atomic<bool> stopping{false};
+	bool running = false;
+
+	std::mutex spaceMutex;
+	std::condition_variable spaceCV;
+	std::atomic<bool> producerWaiting{false};
+
+	std::atomic<unsigned long long> delivered{0};
+	std::atomic<unsigned long long> overflows{0};
+	std::atomic<size_t> highWater{0};
+	std::atomic<unsigned long long> droppedNewest{0};
+	std::atomic<unsigned long long> droppedOldest{0};
+	std::atomic<unsigned long long> droppedLatest{0};
+	std::atomic<unsigned long long> droppedBlockTimeout{0};
+	std::atomic<unsigned long long> droppedUntilKeyframe{0};
+
+	void Wake();
+	void WakeProducer();
+	bool WaitForFrames();
+	bool WaitForSpace();
+	size_t Evict(size_t count);
+	bool PushWhenFree(FrameRef &frame);
+	bool PushFull(FrameRef &frame);
+	void Thread();
+
+public:
+	inline FrameDispatcher() = default;
+	inline ~FrameDispatcher() { Stop(); }
+
+	FrameDispatcher(const FrameDispatcher &) = delete;
+	FrameDispatcher &operator=(const FrameDispatcher &) = delete;
+
+	void Start(size_t depth, QueuePolicy policy, int blockTimeoutMs,
+		   DeliverProc deliver);
+
+	/** Delivers whatever is still queued, then joins the thread */
+	void Stop();
+
+	inline bool Running() const { return running; }
+
+	/**
+	 * Copies a frame without an owner into a pooled buffer, which
+	 * becomes its owner.  Streaming thread only, like Push.
+	 */
+	void Detach(FrameRef &frame);
+
+	/**
+	 * Returns false if the frame was discarded.  Frames without an owner
+	 * are copied.
+	 */
+	bool Push(FrameRef &&frame);
+
+	void GetStats(StreamStats &stats) const;
+	void ResetStats();
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,202 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "frame-ref.hpp"
+#include "packet-assembler.hpp"
+#include "video-format-desc.hpp"
+
+#include <cstring>
+
+namespace DShow {
+
+/* descriptions of formats whose frames are made of planes */
+static inline const VideoFormatDesc *GetPlanarDesc(VideoFormat format)
+{
+	const VideoFormatDesc *desc = GetVideoFormatDesc(format);
+	return desc && desc->planes ? desc : nullptr;
+}
+
+size_t VideoFrameSize(VideoFormat format, int cx, int cy)
+{
+	const VideoFormatDesc *desc = GetPlanarDesc(format);
+	if (!desc)
+		return 0;
+
+	size_t size = 0;
+	for (int i = 0; i < desc->planes; i++)
+		size += desc->RowBytes(i, cx) * (size_t)desc->PlaneRows(i, cy);
+	return size;
+}
+
+int VideoPlaneHeight(VideoFormat format, int plane, int cy)
+{
+	const VideoFormatDesc *desc = GetPlanarDesc(format);
+	if (!desc)
+		return cy;
+
+	/* planes past the last are laid out like it */
+	return desc->PlaneRows(plane < desc->planes ? plane : desc->planes - 1,
+			       cy);
+}
+
+bool ClipVideoRegion(VideoFormat format, int frameCX, int frameCY, int &x,
+		     int &y, int &cx, int &cy)
+{
+	const VideoFormatDesc *desc = GetPlanarDesc(format);
+	if (!desc)
+		return false;
+
+	int blockWidth = 1;
+	int blockHeight = 1;
+	for (int i = 0; i < desc->planes; i++) {
+		if (blockWidth < desc->plane[i].blockWidth)
+			blockWidth = desc->plane[i].blockWidth;
+		if (blockHeight < desc->plane[i].blockHeight)
+			blockHeight = desc->plane[i].blockHeight;
+	}
+
+	x = x < 0 ? 0 : (x < frameCX ? x : frameCX - 1);
+	y = y < 0 ? 0 : (y < frameCY ? y : frameCY - 1);
+	x -= x % blockWidth;
+	y -= y % blockHeight;
+	if (cx <= 0 || cx > frameCX - x)
+		cx = frameCX - x;
+	if (cy <= 0 || cy > frameCY - y)
+		cy = frameCY - y;
+	return true;
+}
+
+bool CropVideoFrame(FrameRef &frame, int x, int y, int cx, int cy)
+{
+	const VideoFormatDesc *desc = GetPlanarDesc(frame.videoFormat);
+	if (!desc || !frame.linesize[0])
+		return false;
+
+	ClipVideoRegion(frame.videoFormat, frame.cx, frame.cy, x, y, cx, cy);
+
+	/* the region runs to the end of the buffer, whichever way the rows
+	 * go */
+	unsigned char *end = VideoFrameBuffer(frame) + frame.size;
+
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		if (!frame.data[i])
+			continue;
+
+		const VideoPlaneDesc &plane =
+			desc->plane[i < desc->planes ? i : desc->planes - 1];
+		frame.data[i] +=
+			(ptrdiff_t)(y / plane.blockHeight) * frame.linesize[i] +
+			(x / plane.blockWidth) * plane.blockBytes;
+	}
+
+	frame.cx = cx;
+	frame.cy = cy;
+	frame.size = (size_t)(end - VideoFrameBuffer(frame));
+	return true;
+}
+
+bool VideoFrameBottomUp(VideoFormat format, bool cyFlip)
+{
+	switch (format) {
+	case VideoFormat::ARGB:
+	case VideoFormat::XRGB:
+	case VideoFormat::RGBA:
+	case VideoFormat::RGB24:
+		return !cyFlip;
+	default:
+		return false;
+	}
+}
+
+void ReverseVideoFrameRows(FrameRef &frame)
+{
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		if (!frame.data[i] || !frame.linesize[i])
+			continue;
+
+		int rows = VideoPlaneHeight(frame.videoFormat, i, frame.cy);
+		frame.data[i] += (ptrdiff_t)(rows - 1) * frame.linesize[i];
+		frame.linesize[i] = -frame.linesize[i];
+	}
+}
+
+unsigned char *VideoFrameBuffer(const FrameRef &frame)
+{
+	if (frame.linesize[0] >= 0)
+		return frame.data[0];
+
+	int rows = VideoPlaneHeight(frame.videoFormat, 0, frame.cy);
+	return frame.data[0] + (ptrdiff_t)(rows - 1) * frame.linesize[0];
+}
+
+void CopyFrameToPool(FrameRef &frame, std::shared_ptr<ChunkPool> &pool,
+		     size_t depth)
+{
+	if (!pool || pool->ChunkSize() < frame.size)
+		pool = std::make_shared<ChunkPool>(frame.size, depth);
+
+	std::shared_ptr<ChunkPool> framePool = pool;
+	unsigned char *buffer = framePool->Acquire();
+
+	/* the planes keep their place (and stride) within the copy */
+	unsigned char *base = VideoFrameBuffer(frame);
+	memcpy(buffer, base, frame.size);
+
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		if (frame.data[i])
+			frame.data[i] = buffer + (frame.data[i] - base);
+	}
+
+	frame.segments = nullptr;
+	frame.segmentCount = 0;
+	frame.owner = std::shared_ptr<unsigned char>(
+		buffer, [framePool](unsigned char *chunk) {
+			framePool->Recycle(chunk);
+		});
+}
+
+void SetVideoFramePlanes(FrameRef &frame, unsigned char *data, size_t size)
+{
+	const VideoFormatDesc *desc = GetPlanarDesc(frame.videoFormat);
+	const size_t required =
+		VideoFrameSize(frame.videoFormat, frame.cx, frame.cy);
+
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		frame.data[i] = nullptr;
+		frame.linesize[i] = 0;
+	}
+
+	frame.data[0] = data;
+	frame.size = size;
+
+	/* unknown/encoded data, or a sample that doesn't match the format */
+	if (!required || size < required)
+		return;
+
+	size_t offset = 0;
+	for (int i = 0; i < desc->planes; i++) {
+		size_t linesize = desc->RowBytes(i, frame.cx);
+
+		frame.data[i] = data + offset;
+		frame.linesize[i] = (int)linesize;
+		offset += linesize * (size_t)desc->PlaneRows(i, frame.cy);
+	}
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+namespace DShow {
+
+class ChunkPool;
+
+/**
+ * Creates a FrameRef owner that holds a reference to a COM-style object
+ * (anything with AddRef/Release, typically an IMediaSample).  The reference
+ * is released when the last FrameRef pointing at it goes away.
+ */
+template<typename T> inline std::shared_ptr<void> MakeSampleOwner(T *sample)
+{
+	sample->AddRef();
+	return std::shared_ptr<void>(sample, [](T *s) { s->Release(); });
+}
+
+/**
+ * Fills in the plane pointers and strides of a video frame from its format
+ * and dimensions.  If the data is too small for the format, the frame is
+ * described as a single plane.
+ */
+void SetVideoFramePlanes(FrameRef &frame, unsigned char *data, size_t size);
+
+/** Size in bytes of a tightly packed frame, or 0 for unknown formats */
+size_t VideoFrameSize(VideoFormat format, int cx, int cy);
+
+/** Number of rows in a plane of a frame */
+int VideoPlaneHeight(VideoFormat format, int plane, int cy);
+
+/**
+ * Describes the region (x, y, cx, cy) of a frame in place by offsetting its
+ * plane pointers.  Offsets are rounded down to even where the chroma is
+ * subsampled, and the region is clipped to the frame.  The size becomes that
+ * of the buffer from the region's first row on.  Returns false for formats
+ * without planes.
+ */
+bool CropVideoFrame(FrameRef &frame, int x, int y, int cx, int cy);
+
+/**
+ * Clips a region of a frame of the given format and size the way
+ * CropVideoFrame does, without a frame.  Returns false for formats without
+ * planes.
+ */
+bool ClipVideoRegion(VideoFormat format, int frameCX, int frameCY, int &x,
+		     int &y, int &cx, int &cy);
+
+/** Whether frames of a format are stored bottom-up (RGB DIBs with cy > 0) */
+bool VideoFrameBottomUp(VideoFormat format, bool cyFlip);
+
+/**
+ * Describes the rows of each plane in reverse order, by pointing it at its
+ * last row and negating its stride.  No data is moved.
+ */
+void ReverseVideoFrameRows(FrameRef &frame);
+
+/** Start of the buffer behind a frame's first plane, whatever its stride */
+unsigned char *VideoFrameBuffer(const FrameRef &frame);
+
+/**
+ * Copies a frame into a buffer from pool, which becomes its owner, so it no
+ * longer holds on to whatever it pointed into.  The pool is replaced with
+ * one keeping up to depth free buffers if its buffers are too small.
+ */
+void CopyFrameToPool(FrameRef &frame, std::shared_ptr<ChunkPool> &pool,
+		     size_t depth);
+
+}; /* namespace DShow */
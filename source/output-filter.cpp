@@ -19,6 +19,8 @@
 
 #include "output-filter.hpp"
 #include "dshow-formats.hpp"
+#include "frame-ref.hpp"
+#include "plane-copy.hpp"
 #include "log.hpp"
 
 #include <strsafe.h>
@@ -435,8 +437,8 @@ bool OutputPin::AllocateBuffers(IPin *target, bool connecting)
 	int cx = vih->bmiHeader.biWidth;
 	int cy = vih->bmiHeader.biHeight;
 
-	WORD bits = VFormatBits(curVFormat);
-	bufSize = cx * cy * bits / 8;
+	/* rounds up odd chroma sizes and pads RGB24 rows */
+	bufSize = VideoFrameSize(curVFormat, cx, abs(cy));
 
 	ALLOCATOR_PROPERTIES props;
 
@@ -471,7 +473,7 @@ static MediaType CreateMediaType(VideoFormat format, int cx, int cy,
 	MediaType mt;
 
 	WORD bits = VFormatBits(format);
-	DWORD size = cx * cy * bits / 8;
+	DWORD size = (DWORD)VideoFrameSize(format, cx, cy);
 	uint64_t rate =
 		(uint64_t)size * 10000000ULL / (uint64_t)interval * 8ULL;
 
@@ -541,25 +543,35 @@ bool OutputPin::LockSampleData(unsigned char **ptr)
 	if (FAILED(hr))
 		return false;
 
-	if (FAILED(sample->SetActualDataLength((long)bufSize)))
-		return false;
-	if (FAILED(sample->SetDiscontinuity(false)))
-		return false;
-	if (FAILED(sample->SetPreroll(false)))
-		return false;
-	if (FAILED(sample->SetSyncPoint(true)))
-		return false;
-	if (FAILED(sample->GetPointer(ptr)))
+	if (FAILED(sample->SetActualDataLength((long)bufSize)) ||
+	    FAILED(sample->SetDiscontinuity(false)) ||
+	    FAILED(sample->SetPreroll(false)) ||
+	    FAILED(sample->SetSyncPoint(true)) ||
+	    FAILED(sample->GetPointer(ptr))) {
+		DiscardSample();
 		return false;
+	}
 
 	if (setSampleMediaType) {
 		sample->SetMediaType(mt);
 		setSampleMediaType = false;
+		sampleHasMediaType = true;
 	}
 
 	return true;
 }
 
+/* gives back a locked sample without sending it.  A media type change it
+ * carried goes out with the next sample instead. */
+void OutputPin::DiscardSample()
+{
+	if (sampleHasMediaType)
+		setSampleMediaType = true;
+
+	sampleHasMediaType = false;
+	sample.Clear();
+}
+
 void OutputPin::Send(unsigned char *data[DSHOW_MAX_PLANES],
 		     size_t linesize[DSHOW_MAX_PLANES],
 		     long long timestampStart, long long timestampEnd)
@@ -580,11 +592,67 @@ void OutputPin::Send(unsigned char *data[DSHOW_MAX_PLANES],
 	UnlockSampleData(timestampStart, timestampEnd);
 }
 
+bool OutputPin::LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+			  int linesize[DSHOW_MAX_PLANES])
+{
+	unsigned char *ptr;
+	if (!LockSampleData(&ptr))
+		return false;
+
+	FrameRef frame;
+	frame.cx = curCX;
+	frame.cy = curCY;
+	frame.videoFormat = curVFormat;
+	SetVideoFramePlanes(frame, ptr, bufSize);
+
+	/* the buffer doesn't match the format */
+	if (!frame.linesize[0]) {
+		DiscardSample();
+		return false;
+	}
+
+	/* RGB media types have a positive height, so are bottom-up */
+	if (VideoFrameBottomUp(curVFormat, false))
+		ReverseVideoFrameRows(frame);
+
+	for (size_t i = 0; i < DSHOW_MAX_PLANES; i++) {
+		data[i] = frame.data[i];
+		linesize[i] = frame.linesize[i];
+	}
+
+	return true;
+}
+
+void OutputPin::SendFrame(const unsigned char *const data[DSHOW_MAX_PLANES],
+			  const int linesize[DSHOW_MAX_PLANES],
+			  long long timestampStart, long long timestampEnd)
+{
+	unsigned char *planes[DSHOW_MAX_PLANES];
+	int strides[DSHOW_MAX_PLANES];
+
+	if (!LockFrame(planes, strides))
+		return;
+
+	for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+		if (!planes[i] || !data[i])
+			break;
+
+		/* the sample's rows are tightly packed */
+		CopyPlane(planes[i], strides[i], data[i], linesize[i],
+			  (size_t)abs(strides[i]),
+			  VideoPlaneHeight(curVFormat, i, curCY));
+	}
+
+	UnlockSampleData(timestampStart, timestampEnd);
+}
+
 void OutputPin::UnlockSampleData(long long timestampStart,
 				 long long timestampEnd)
 {
-	if (!connectedPin)
+	if (!connectedPin) {
+		DiscardSample();
 		return;
+	}
 
 	ComQIPtr<IMemInputPin> memInput(connectedPin);
 	REFERENCE_TIME startTime = timestampStart;
@@ -595,6 +663,7 @@ void OutputPin::UnlockSampleData(long long timestampStart,
 
 	memInput->Receive(sample);
 
+	sampleHasMediaType = false;
 	sample.Clear();
 }
 
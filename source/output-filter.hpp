@@ -41,6 +41,7 @@ class OutputPin : public IPin, public IAMStreamConfig, public IKsPropertySet {
 	int curCX = 0;
 	int curCY = 0;
 	bool setSampleMediaType = false;
+	bool sampleHasMediaType = false;
 
 	ComPtr<IPin> connectedPin;
 	OutputFilter *filter;
@@ -52,6 +53,7 @@ class OutputPin : public IPin, public IAMStreamConfig, public IKsPropertySet {
 	bool IsValidMediaType(const AM_MEDIA_TYPE *pmt) const;
 
 	bool AllocateBuffers(IPin *target, bool connecting = false);
+	void DiscardSample();
 
 public:
 	OutputPin(OutputFilter *filter);
@@ -127,6 +129,19 @@ public:
 	bool LockSampleData(unsigned char **ptr);
 	void UnlockSampleData(long long timestampStart, long long timestampEnd);
 
+	/**
+	 * Locks the next sample and gives its planes in the current format,
+	 * to be written in place.  Send it with UnlockSampleData.  RGB planes
+	 * are given top-down, with a negative stride.
+	 */
+	bool LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+		       int linesize[DSHOW_MAX_PLANES]);
+
+	/** Sends a frame whose linesize values are row strides */
+	void SendFrame(const unsigned char *const data[DSHOW_MAX_PLANES],
+		       const int linesize[DSHOW_MAX_PLANES],
+		       long long timestampStart, long long timestampEnd);
+
 	void Stop();
 };
 
@@ -214,6 +229,19 @@ public:
 	{
 		pin->UnlockSampleData(timestampStart, timestampEnd);
 	}
+
+	inline bool LockFrame(unsigned char *data[DSHOW_MAX_PLANES],
+			      int linesize[DSHOW_MAX_PLANES])
+	{
+		return pin->LockFrame(data, linesize);
+	}
+
+	inline void SendFrame(const unsigned char *const data[DSHOW_MAX_PLANES],
+			      const int linesize[DSHOW_MAX_PLANES],
+			      long long timestampStart, long long timestampEnd)
+	{
+		pin->SendFrame(data, linesize, timestampStart, timestampEnd);
+	}
 };
 
 class OutputEnumPins : public IEnumPins {
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "packet-assembler.hpp"
+
+#include <cstring>
+
+namespace DShow {
+
+ChunkPool::ChunkPool(size_t chunkSize_, size_t maxFree_)
+	: chunkSize(chunkSize_), maxFree(maxFree_)
+{
+}
+
+ChunkPool::~ChunkPool()
+{
+	for (unsigned char *chunk : freeChunks)
+		delete[] chunk;
+}
+
+unsigned char *ChunkPool::Acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!freeChunks.empty()) {
+			unsigned char *chunk = freeChunks.back();
+			freeChunks.pop_back();
+			return chunk;
+		}
+	}
+
+	return new unsigned char[chunkSize];
+}
+
+void ChunkPool::Recycle(unsigned char *chunk)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (freeChunks.size() < maxFree) {
+			freeChunks.push_back(chunk);
+			return;
+		}
+	}
+
+	delete[] chunk;
+}
+
+EncodedPacket::~EncodedPacket()
+{
+	for (unsigned char *chunk : chunks)
+		pool->Recycle(chunk);
+}
+
+void EncodedPacket::CopyTo(unsigned char *dst) const
+{
+	for (const FrameSegment &segment : segments) {
+		memcpy(dst, segment.data, segment.size);
+		dst += segment.size;
+	}
+}
+
+PacketAssembler::PacketAssembler(size_t chunkSize, size_t maxFreeChunks)
+	: pool(std::make_shared<ChunkPool>(chunkSize, maxFreeChunks))
+{
+}
+
+void PacketAssembler::Append(const unsigned char *data, size_t size)
+{
+	const size_t chunkSize = pool->ChunkSize();
+
+	if (!current)
+		current = std::make_shared<EncodedPacket>(pool);
+
+	while (size) {
+		if (current->chunks.empty() || chunkUsed == chunkSize) {
+			unsigned char *chunk = pool->Acquire();
+			current->chunks.push_back(chunk);
+			current->segments.push_back({chunk, 0});
+			chunkUsed = 0;
+		}
+
+		size_t copy = chunkSize - chunkUsed;
+		if (copy > size)
+			copy = size;
+
+		FrameSegment &segment = current->segments.back();
+		memcpy(current->chunks.back() + chunkUsed, data, copy);
+		segment.size += copy;
+		current->size += copy;
+		chunkUsed += copy;
+
+		data += copy;
+		size -= copy;
+	}
+}
+
+std::shared_ptr<EncodedPacket> PacketAssembler::Take()
+{
+	std::shared_ptr<EncodedPacket> packet = std::move(current);
+	current.reset();
+	chunkUsed = 0;
+	return packet;
+}
+
+void PacketAssembler::Reset()
+{
+	current.reset();
+	chunkUsed = 0;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <mutex>
+
+namespace DShow {
+
+/**
+ * Pool of fixed-size memory chunks.  Chunks can be recycled from any thread,
+ * so packets built from them can be released by whoever ends up holding
+ * them.
+ */
+class ChunkPool {
+	const size_t chunkSize;
+	const size_t maxFree;
+
+	std::mutex mutex;
+	std::vector<unsigned char *> freeChunks;
+
+public:
+	ChunkPool(size_t chunkSize, size_t maxFree);
+	~ChunkPool();
+
+	ChunkPool(const ChunkPool &) = delete;
+	ChunkPool &operator=(const ChunkPool &) = delete;
+
+	inline size_t ChunkSize() const { return chunkSize; }
+
+	unsigned char *Acquire();
+	void Recycle(unsigned char *chunk);
+};
+
+/**
+ * An encoded packet stored as a list of pooled chunks.  The chunks go back
+ * to the pool when the packet is destroyed.
+ */
+class EncodedPacket {
+	friend class PacketAssembler;
+
+	std::shared_ptr<ChunkPool> pool;
+	std::vector<unsigned char *> chunks;
+	std::vector<FrameSegment> segments;
+	size_t size = 0;
+
+public:
+	inline explicit EncodedPacket(std::shared_ptr<ChunkPool> pool_)
+		: pool(std::move(pool_))
+	{
+	}
+
+	~EncodedPacket();
+
+	EncodedPacket(const EncodedPacket &) = delete;
+	EncodedPacket &operator=(const EncodedPacket &) = delete;
+
+	inline size_t Size() const { return size; }
+	inline size_t SegmentCount() const { return segments.size(); }
+	inline const FrameSegment *Segments() const { return segments.data(); }
+
+	/** Copies the whole packet to dst, which must hold Size() bytes */
+	void CopyTo(unsigned char *dst) const;
+};
+
+/**
+ * Reassembles encoded packets that arrive split over several samples.
+ * Appended data is written into pooled chunks rather than a growing
+ * vector, so large packets never reallocate or move.
+ */
+class PacketAssembler {
+	std::shared_ptr<ChunkPool> pool;
+	std::shared_ptr<EncodedPacket> current;
+	size_t chunkUsed = 0;
+
+public:
+	explicit PacketAssembler(size_t chunkSize = 256 * 1024,
+				 size_t maxFreeChunks = 32);
+
+	void Append(const unsigned char *data, size_t size);
+
+	inline size_t Size() const { return current ? current->Size() : 0; }
+
+	/** Returns the packet built so far and starts a new one */
+	std::shared_ptr<EncodedPacket> Take();
+
+	void Reset();
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "plane-copy.hpp"
+#include "cpu-features.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if DSHOW_X86
+#include <emmintrin.h>
+#endif
+
+namespace DShow {
+
+/* planes smaller than this are likely to still be in the cache when the
+ * device reads them, so they're copied normally */
+#define STREAM_COPY_MIN_SIZE (512 * 1024)
+
+#if DSHOW_X86
+static void StreamRow(unsigned char *dst, const unsigned char *src,
+		      size_t size)
+{
+	/* non-temporal stores need 16-byte aligned destinations */
+	size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+	if (head > size)
+		head = size;
+
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	size_t body = size & ~(size_t)63;
+
+	for (size_t i = 0; i < body; i += 64) {
+		const __m128i *s = (const __m128i *)(src + i);
+		__m128i *d = (__m128i *)(dst + i);
+		__m128i a = _mm_loadu_si128(s);
+		__m128i b = _mm_loadu_si128(s + 1);
+		__m128i c = _mm_loadu_si128(s + 2);
+		__m128i e = _mm_loadu_si128(s + 3);
+
+		_mm_stream_si128(d, a);
+		_mm_stream_si128(d + 1, b);
+		_mm_stream_si128(d + 2, c);
+		_mm_stream_si128(d + 3, e);
+	}
+
+	memcpy(dst + body, src + body, size - body);
+}
+#endif
+
+void CopyPlane(unsigned char *dst, int dstStride, const unsigned char *src,
+	       int srcStride, size_t rowBytes, int rows)
+{
+	const bool contiguous = (size_t)dstStride == rowBytes &&
+				(size_t)srcStride == rowBytes;
+
+#if DSHOW_X86
+	if (rowBytes * (size_t)rows >= STREAM_COPY_MIN_SIZE &&
+	    (GetCPUFeatures() & CPU_SSE2) != 0) {
+		if (contiguous) {
+			StreamRow(dst, src, rowBytes * (size_t)rows);
+		} else {
+			for (int y = 0; y < rows; y++)
+				StreamRow(dst + (ptrdiff_t)y * dstStride,
+					  src + (ptrdiff_t)y * srcStride,
+					  rowBytes);
+		}
+
+		/* make the stores visible before the sample is handed on */
+		_mm_sfence();
+		return;
+	}
+#endif
+
+	if (contiguous) {
+		memcpy(dst, src, rowBytes * (size_t)rows);
+		return;
+	}
+
+	for (int y = 0; y < rows; y++)
+		memcpy(dst + (ptrdiff_t)y * dstStride,
+		       src + (ptrdiff_t)y * srcStride, rowBytes);
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,37 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace DShow {
+
+/**
+ * Copies a plane between buffers with different strides.  Large planes are
+ * written with non-temporal stores where available, since they would only
+ * push everything else out of the cache on their way to the device.
+ * Strides may be negative, to copy from or into a vertically flipped plane.
+ *
+ * @param  rowBytes  Bytes to copy from each row
+ */
+void CopyPlane(unsigned char *dst, int dstStride, const unsigned char *src,
+	       int srcStride, size_t rowBytes, int rows);
+
+}; /* namespace DShow */
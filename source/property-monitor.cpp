@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "property-monitor.hpp"
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+namespace DShow {
+
+void PropertyMonitor::Start(int periodMs_, PollProc poll_)
+{
+	Stop();
+
+	poll = std::move(poll_);
+	periodMs = periodMs_ > 0 ? periodMs_ : 1;
+	stopping = false;
+
+	Update();
+
+	running = true;
+	thread = std::thread(&PropertyMonitor::Thread, this);
+}
+
+void PropertyMonitor::Stop()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	cv.notify_one();
+	thread.join();
+
+	running = false;
+	poll = nullptr;
+}
+
+void PropertyMonitor::Update()
+{
+	if (!poll)
+		return;
+
+	DeviceProperties props = Get();
+	poll(props);
+	Set(props);
+}
+
+void PropertyMonitor::Thread()
+{
+#ifdef _WIN32
+	/* polling calls into the driver's COM interfaces */
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!cv.wait_for(lock, std::chrono::milliseconds(periodMs),
+			    [this]() { return stopping; })) {
+		lock.unlock();
+		Update();
+		lock.lock();
+	}
+
+#ifdef _WIN32
+	lock.unlock();
+	if (SUCCEEDED(hr))
+		CoUninitialize();
+#endif
+}
+
+}; /* namespace DShow */
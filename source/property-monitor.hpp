@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace DShow {
+
+/** Device state that can change while capturing */
+struct DeviceProperties {
+	bool hdr = false;
+	long roll = 0;
+};
+
+/**
+ * Polls device properties at a low rate on its own thread and publishes the
+ * latest values as a lock-free snapshot, so the streaming thread never has
+ * to talk to the driver itself.
+ */
+class PropertyMonitor {
+public:
+	typedef std::function<void(DeviceProperties &props)> PollProc;
+
+private:
+	PollProc poll;
+	int periodMs = 0;
+
+	std::atomic<uint64_t> snapshot{0};
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+	bool running = false;
+
+	static inline uint64_t Pack(const DeviceProperties &props)
+	{
+		return (uint64_t)(uint32_t)props.roll |
+		       ((uint64_t)props.hdr << 32);
+	}
+
+	static inline DeviceProperties Unpack(uint64_t val)
+	{
+		DeviceProperties props;
+		props.roll = (long)(int32_t)(uint32_t)val;
+		props.hdr = !!(val >> 32);
+		return props;
+	}
+
+	void Thread();
+
+public:
+	inline PropertyMonitor() = default;
+	inline ~PropertyMonitor() { Stop(); }
+
+	PropertyMonitor(const PropertyMonitor &) = delete;
+	PropertyMonitor &operator=(const PropertyMonitor &) = delete;
+
+	/** Polls once immediately, then every periodMs on a new thread */
+	void Start(int periodMs, PollProc poll);
+	void Stop();
+
+	inline bool Running() const { return running; }
+
+	/** Polls right now on the calling thread */
+	void Update();
+
+	inline void Set(const DeviceProperties &props)
+	{
+		snapshot.store(Pack(props), std::memory_order_release);
+	}
+
+	inline DeviceProperties Get() const
+	{
+		return Unpack(snapshot.load(std::memory_order_acquire));
+	}
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,299 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "slice-executor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+namespace DShow {
+
+static inline long long Now()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+struct SliceExecutor::Job {
+	const SliceProc *proc;
+	int priority;
+	long long deadline;
+	long long submitted;
+	std::atomic<long long> started{0};
+	std::atomic<int> remaining{0};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool done = false;
+
+	/* whether this job should be worked on before another one */
+	inline bool Before(int otherPriority, long long otherDeadline) const
+	{
+		if (priority != otherPriority)
+			return priority > otherPriority;
+		return deadline < otherDeadline;
+	}
+
+	inline bool Before(const Job &other) const
+	{
+		return Before(other.priority, other.deadline);
+	}
+};
+
+SliceExecutor::SliceExecutor(int count)
+{
+	if (count <= 0)
+		count = (int)std::thread::hardware_concurrency();
+	if (count <= 0)
+		count = 1;
+
+	for (int i = 0; i < count; i++)
+		workers.emplace_back(new Worker);
+	for (int i = 0; i < count; i++)
+		workers[i]->thread =
+			std::thread(&SliceExecutor::Thread, this, i);
+}
+
+SliceExecutor::~SliceExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	cv.notify_all();
+	for (std::unique_ptr<Worker> &worker : workers)
+		worker->thread.join();
+}
+
+std::shared_ptr<SliceExecutor> SliceExecutor::Shared(int count)
+{
+	static std::mutex sharedMutex;
+	static std::weak_ptr<SliceExecutor> shared;
+
+	std::lock_guard<std::mutex> lock(sharedMutex);
+	std::shared_ptr<SliceExecutor> executor = shared.lock();
+	if (!executor) {
+		executor = std::make_shared<SliceExecutor>(count);
+		shared = executor;
+	}
+
+	return executor;
+}
+
+SliceExecutor::RunStats SliceExecutor::Run(int count, const SliceProc &proc,
+					   int priority, long long budgetNs)
+{
+	RunStats stats;
+	if (count <= 0)
+		return stats;
+
+	Job job;
+	job.proc = &proc;
+	job.priority = priority;
+	job.submitted = Now();
+	job.deadline = budgetNs > 0 ? job.submitted + budgetNs : LLONG_MAX;
+	job.remaining.store(count);
+
+	{
+		std::lock_guard<std::mutex> lock(injectMutex);
+		auto pos = std::find_if(injected.begin(), injected.end(),
+					[&](const Task &task) {
+						return job.Before(*task.job);
+					});
+		injected.insert(pos, Task{&job, 0, count});
+		topPriority.store(injected.front().job->priority);
+	}
+
+	queued++;
+	Wake();
+
+	std::unique_lock<std::mutex> lock(job.mutex);
+	job.cv.wait(lock, [&]() { return job.done; });
+
+	stats.queueNs = job.started.load() - job.submitted;
+	stats.late = Now() > job.deadline;
+	return stats;
+}
+
+void SliceExecutor::Push(int index, const Task &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->mutex);
+		workers[index]->tasks.push_back(task);
+	}
+
+	queued++;
+	Wake();
+}
+
+void SliceExecutor::Wake()
+{
+	/* a thread going to sleep counts itself before it checks queued, with
+	 * the mutex held: either it sees the new task, or it is counted here
+	 * and is waiting by the time the mutex is free */
+	if (sleeping.load() == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	cv.notify_one();
+}
+
+bool SliceExecutor::Take(int index, Task &task)
+{
+	Worker &self = *workers[index];
+
+	/* the rest of the job already being worked on comes first, unless a
+	 * job of a higher priority is waiting */
+	{
+		std::lock_guard<std::mutex> lock(self.mutex);
+		if (!self.tasks.empty() &&
+		    self.tasks.back().job->priority >= topPriority.load()) {
+			task = self.tasks.back();
+			self.tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+
+	for (;;) {
+		/* the most urgent of: a new job, the biggest range another
+		 * thread hasn't got to yet, or this thread's own.  Jobs can
+		 * finish as soon as their lock is let go, so only their
+		 * urgency is kept. */
+		int from = INT_MIN;
+		int priority = 0;
+		long long deadline = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(injectMutex);
+			if (!injected.empty()) {
+				priority = injected.front().job->priority;
+				deadline = injected.front().job->deadline;
+				from = -1;
+			}
+		}
+
+		for (int i = 0; i < (int)workers.size(); i++) {
+			Worker &worker = *workers[i];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (worker.tasks.empty())
+				continue;
+
+			const Task &candidate = i == index
+							? worker.tasks.back()
+							: worker.tasks.front();
+			if (from == INT_MIN ||
+			    candidate.job->Before(priority, deadline)) {
+				priority = candidate.job->priority;
+				deadline = candidate.job->deadline;
+				from = i;
+			}
+		}
+
+		if (from == INT_MIN)
+			return false;
+
+		/* whatever is there by now is taken, even if it isn't quite
+		 * the most urgent any more */
+		if (from == -1) {
+			std::lock_guard<std::mutex> lock(injectMutex);
+			if (injected.empty())
+				continue;
+
+			task = injected.front();
+			injected.pop_front();
+
+			const Job *next = injected.empty()
+						  ? nullptr
+						  : injected.front().job;
+			topPriority.store(next ? next->priority : INT_MIN);
+		} else {
+			Worker &worker = *workers[from];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (worker.tasks.empty())
+				continue;
+
+			if (from == index) {
+				task = worker.tasks.back();
+				worker.tasks.pop_back();
+			} else {
+				task = worker.tasks.front();
+				worker.tasks.pop_front();
+			}
+		}
+
+		queued--;
+		return true;
+	}
+}
+
+void SliceExecutor::Execute(int index, Task task)
+{
+	Job *job = task.job;
+
+	/* halves are left for later at the back of the deque, the biggest
+	 * ones furthest from it where other threads steal from */
+	while (task.end - task.begin > 1) {
+		int mid = task.begin + (task.end - task.begin) / 2;
+		Push(index, Task{job, mid, task.end});
+		task.end = mid;
+	}
+
+	if (!job->started.load(std::memory_order_relaxed)) {
+		long long expected = 0;
+		job->started.compare_exchange_strong(expected, Now());
+	}
+
+	(*job->proc)(task.begin, index);
+
+	/* the job lives on the stack of Run, which returns as soon as it
+	 * can take the mutex; the job isn't touched after that */
+	if (job->remaining.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->done = true;
+		job->cv.notify_one();
+	}
+}
+
+void SliceExecutor::Thread(int index)
+{
+	for (;;) {
+		Task task;
+		if (Take(index, task)) {
+			Execute(index, task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping++;
+		cv.wait(lock,
+			[this]() { return stopping || queued.load() > 0; });
+		sleeping--;
+
+		if (stopping)
+			return;
+	}
+}
+
+}; /* namespace DShow */
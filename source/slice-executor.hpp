@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DShow {
+
+/**
+ * Process-wide pool of threads that the slices of frames (bands of rows)
+ * from every device are run on, so that many devices don't each bring
+ * their own threads and oversubscribe the CPU.
+ *
+ * Each thread keeps a deque of slice ranges.  It splits the range it takes
+ * in half until one slice is left, keeping the other halves at the back of
+ * its deque to work through next.  Threads with nothing left take new jobs
+ * or steal the largest range from the front of another thread's deque,
+ * whichever belongs to the more urgent job: higher priority first, then
+ * earliest deadline.
+ *
+ * Run may be called from any number of threads at once.
+ */
+class SliceExecutor {
+public:
+	/** Processes one slice; worker is the index of the thread */
+	typedef std::function<void(int slice, int worker)> SliceProc;
+
+	/** How a job went */
+	struct RunStats {
+		/** Time until a thread started on it (ns) */
+		long long queueNs = 0;
+
+		/** Whether it finished after its deadline */
+		bool late = false;
+	};
+
+private:
+	struct Job;
+
+	struct Task {
+		Job *job;
+		int begin;
+		int end;
+	};
+
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	/* jobs nobody has started on, sorted by urgency */
+	std::mutex injectMutex;
+	std::deque<Task> injected;
+	std::atomic<int> topPriority{INT_MIN};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::atomic<int> queued{0};
+	std::atomic<int> sleeping{0};
+	bool stopping = false;
+
+	void Push(int worker, const Task &task);
+	void Wake();
+	bool Take(int worker, Task &task);
+	void Execute(int worker, Task task);
+	void Thread(int worker);
+
+public:
+	/** Starts the threads, one per core if workers is 0 */
+	explicit SliceExecutor(int workers);
+	~SliceExecutor();
+
+	SliceExecutor(const SliceExecutor &) = delete;
+	SliceExecutor &operator=(const SliceExecutor &) = delete;
+
+	/**
+	 * Returns the executor shared by the whole process, starting it with
+	 * the given number of workers if nothing holds it yet
+	 */
+	static std::shared_ptr<SliceExecutor> Shared(int workers);
+
+	/** Threads slices are run on */
+	inline int Workers() const { return (int)workers.size(); }
+
+	/**
+	 * Calls proc for each slice in [0, count) on the executor's threads,
+	 * and waits for them all.  Jobs with a higher priority go first, then
+	 * those due soonest; budgetNs is how long from now the job should be
+	 * done in, or 0 for no deadline.
+	 */
+	RunStats Run(int count, const SliceProc &proc, int priority = 0,
+		     long long budgetNs = 0);
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace DShow {
+
+/**
+ * Bounded single-producer ring buffer.
+ *
+ * Push may only be called from one thread.  Pop is normally called from one
+ * other thread, but is also safe to call from the producer to evict the
+ * oldest entry when the ring is full.  No side ever blocks or takes a lock;
+ * each cell carries a sequence number that tells whose turn it is.
+ */
+template<typename T> class SPSCRing {
+	struct Cell {
+		std::atomic<size_t> sequence{0};
+		T item;
+	};
+
+	/* keep the producer and consumer indices on separate cache lines */
+	struct alignas(64) Index {
+		std::atomic<size_t> value{0};
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t cellCount = 0;
+	size_t capacity = 0;
+
+	Index head; /* written by the producer */
+	Index tail; /* advanced by whoever pops */
+
+public:
+	inline SPSCRing() = default;
+	inline explicit SPSCRing(size_t capacity_) { Reset(capacity_); }
+
+	SPSCRing(const SPSCRing &) = delete;
+	SPSCRing &operator=(const SPSCRing &) = delete;
+
+	/** Not thread safe, only call while neither side is running */
+	inline void Reset(size_t capacity_)
+	{
+		/* the sequence numbers need at least two cells to tell a full
+		 * cell from an empty one */
+		capacity = capacity_ ? capacity_ : 1;
+		cellCount = capacity < 2 ? 2 : capacity;
+		cells.reset(new Cell[cellCount]);
+
+		for (size_t i = 0; i < cellCount; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+
+		head.value.store(0, std::memory_order_relaxed);
+		tail.value.store(0, std::memory_order_relaxed);
+	}
+
+	inline size_t Capacity() const { return capacity; }
+
+	inline size_t Size() const
+	{
+		size_t t = tail.value.load(std::memory_order_acquire);
+		size_t h = head.value.load(std::memory_order_acquire);
+		return h > t ? h - t : 0;
+	}
+
+	inline bool Empty() const { return Size() == 0; }
+	inline bool Full() const { return Size() >= capacity; }
+
+	/**
+	 * Producer side.  Returns false (leaving the item untouched) if the
+	 * ring is full.
+	 */
+	inline bool Push(T &&item)
+	{
+		size_t pos = head.value.load(std::memory_order_relaxed);
+		Cell &cell = cells[pos % cellCount];
+
+		if (pos - tail.value.load(std::memory_order_acquire) >= capacity)
+			return false;
+		if (cell.sequence.load(std::memory_order_acquire) != pos)
+			return false;
+
+		cell.item = std::move(item);
+		cell.sequence.store(pos + 1, std::memory_order_release);
+		head.value.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Returns false if the ring is empty. */
+	inline bool Pop(T &item)
+	{
+		size_t pos = tail.value.load(std::memory_order_relaxed);
+
+		for (;;) {
+			Cell &cell = cells[pos % cellCount];
+			size_t seq = cell.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)(seq - (pos + 1));
+
+			if (diff < 0)
+				return false;
+
+			if (diff > 0) {
+				/* someone else popped this one first */
+				pos = tail.value.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (tail.value.compare_exchange_weak(
+				    pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+
+		Cell &cell = cells[pos % cellCount];
+		item = std::move(cell.item);
+		cell.item = T();
+		cell.sequence.store(pos + cellCount, std::memory_order_release);
+		return true;
+	}
+};
+
+}; /* namespace DShow */
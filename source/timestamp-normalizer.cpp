@@ -0,0 +1,166 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "timestamp-normalizer.hpp"
+#include "frame-ref.hpp"
+#include "packet-assembler.hpp"
+
+#include <algorithm>
+
+namespace DShow {
+
+#define MAX_REORDER_WINDOW 16
+
+/* going back further than this without a new segment is treated as one
+ * (the graph was restarted and stream time started over) */
+#define MAX_BACKWARD_JUMP 10000000LL /* 1s */
+
+void StreamTimeline::Extend(long long end)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!haveInput || end > inputEnd)
+		inputEnd = end;
+	haveInput = true;
+}
+
+long long StreamTimeline::Rebase(unsigned long long &streamSegment,
+				 long long start)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/* the first stream here decides, the others follow */
+	if (streamSegment == segment) {
+		if (haveInput && start + offset < inputEnd)
+			offset = inputEnd - start;
+		segment++;
+	}
+
+	streamSegment = segment;
+	return offset;
+}
+
+void TimestampNormalizer::Restart(StreamTimeline &timeline_, int window_,
+				  bool reorder_, OutputProc output_)
+{
+	pending.clear();
+
+	timeline = &timeline_;
+	window = std::min(std::max(window_, 0), MAX_REORDER_WINDOW);
+	reorder = reorder_;
+	output = std::move(output_);
+	pending.reserve(window + 1);
+	pool.reset();
+
+	/* stream time starts over, carry on from where it was */
+	newSegment = true;
+}
+
+void TimestampNormalizer::Rebase(long long start)
+{
+	/* frames from different segments are never reordered together */
+	Flush();
+
+	long long next = timeline->Rebase(segment, start);
+	if (next != offset) {
+		offset = next;
+		rebased++;
+	}
+}
+
+void TimestampNormalizer::Output(FrameRef &frame)
+{
+	if (reorder && haveLast && frame.startTime <= lastStart) {
+		long long shift = lastStart + 1 - frame.startTime;
+		frame.startTime += shift;
+		frame.stopTime += shift;
+		corrected++;
+	}
+
+	lastStart = frame.startTime;
+	haveLast = true;
+
+	if (output)
+		output(frame);
+}
+
+void TimestampNormalizer::Push(FrameRef &&frame)
+{
+	long long start = frame.startTime + offset;
+
+	if (newSegment ||
+	    (haveInput && start < inputEnd - MAX_BACKWARD_JUMP)) {
+		Rebase(frame.startTime);
+		start = frame.startTime + offset;
+	}
+
+	newSegment = false;
+
+	frame.stopTime += start - frame.startTime;
+	frame.startTime = start;
+
+	long long end = std::max(frame.startTime, frame.stopTime);
+	if (!haveInput || end > inputEnd)
+		inputEnd = end;
+	haveInput = true;
+	timeline->Extend(end);
+
+	if (!reorder || !window) {
+		Output(frame);
+		return;
+	}
+
+	/* one buffer for each held frame, plus the one being output */
+	if (!frame.owner)
+		CopyFrameToPool(frame, pool, window + 2);
+
+	auto compare = [](const FrameRef &a, const FrameRef &b) {
+		return a.startTime < b.startTime;
+	};
+
+	auto pos = std::upper_bound(pending.begin(), pending.end(), frame,
+				    compare);
+	if (pos != pending.end())
+		reordered++;
+
+	pending.insert(pos, std::move(frame));
+
+	if (pending.size() > (size_t)window) {
+		FrameRef next = std::move(pending.front());
+		pending.erase(pending.begin());
+		Output(next);
+	}
+}
+
+void TimestampNormalizer::Flush()
+{
+	for (FrameRef &frame : pending)
+		Output(frame);
+
+	pending.clear();
+}
+
+void TimestampNormalizer::GetStats(StreamStats &stats) const
+{
+	stats.timestampsRebased = rebased;
+	stats.timestampsReordered = reordered;
+	stats.timestampsCorrected = corrected;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <mutex>
+
+namespace DShow {
+
+class ChunkPool;
+
+/**
+ * The offset that rebases the timestamps of all of a device's streams, so
+ * they stay in sync across a discontinuity.  The first stream to reach one
+ * decides the offset, from the latest time any of the streams has reached,
+ * and the others take it over when they reach theirs.
+ *
+ * Streams can be on different threads.
+ */
+class StreamTimeline {
+	std::mutex mutex;
+	long long offset = 0;
+	long long inputEnd = 0;
+	bool haveInput = false;
+	unsigned long long segment = 0;
+
+public:
+	/** A stream's (rebased) times have reached end */
+	void Extend(long long end);
+
+	/**
+	 * Called by a stream at a discontinuity with the start time of its
+	 * first frame, not yet rebased, and the segment the stream was in,
+	 * which is updated.  Returns the offset of the new segment.
+	 */
+	long long Rebase(unsigned long long &segment, long long start);
+};
+
+/**
+ * Cleans up the timestamps of one stream before they reach the callback.
+ *
+ * - At a segment boundary (NewSegment, or a large jump backwards), times
+ *   are rebased so they carry on from where the last segment ended, by an
+ *   offset shared with the device's other streams.
+ * - Up to a few frames can be held back and put back in timestamp order.
+ *   Frames without an owner are copied as they are held, as they point
+ *   into a device sample buffer that is only theirs during Push.
+ * - Start times are made strictly increasing.
+ *
+ * Reordering and monotonic correction can be turned off (encoded streams
+ * may legitimately have out-of-order presentation times); rebasing always
+ * applies.
+ */
+class TimestampNormalizer {
+public:
+	typedef std::function<void(FrameRef &frame)> OutputProc;
+
+private:
+	OutputProc output;
+	StreamTimeline *timeline = nullptr;
+	int window = 0;
+	bool reorder = true;
+	std::vector<FrameRef> pending;
+	std::shared_ptr<ChunkPool> pool;
+
+	long long offset = 0;
+	unsigned long long segment = 0;
+	long long inputEnd = 0;
+	bool haveInput = false;
+	bool newSegment = false;
+
+	long long lastStart = 0;
+	bool haveLast = false;
+
+	unsigned long long rebased = 0;
+	unsigned long long reordered = 0;
+	unsigned long long corrected = 0;
+
+	void Rebase(long long start);
+	void Output(FrameRef &frame);
+
+public:
+	/**
+	 * Sets up the normalizer for a new run of the stream, which starts a
+	 * new segment: times keep increasing from those of earlier runs.
+	 *
+	 * @param  timeline Rebases this and the device's other streams
+	 * @param  window   Frames that may be held back for reordering
+	 * @param  reorder  Whether to reorder and enforce increasing times
+	 * @param  output   Receives the frames once they are ready
+	 */
+	void Restart(StreamTimeline &timeline, int window, bool reorder,
+		     OutputProc output);
+
+	/** The next frame starts a new segment */
+	inline void NewSegment() { newSegment = true; }
+
+	void Push(FrameRef &&frame);
+
+	/** Sends out any frames still held back */
+	void Flush();
+
+	void GetStats(StreamStats &stats) const;
+};
+
+}; /* namespace DShow */
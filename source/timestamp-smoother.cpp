@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "timestamp-smoother.hpp"
+
+#include <cmath>
+
+namespace DShow {
+
+/* loop gains, critically damped */
+#define PHASE_GAIN 0.1
+#define PERIOD_GAIN 0.0025
+
+/* intervals in a row that are off the period before relocking to a new
+ * rate */
+#define RELOCK_FRAMES 4
+
+void TimestampSmoother::Reset(long long interval)
+{
+	*this = TimestampSmoother();
+	nominal = (double)interval;
+}
+
+long long TimestampSmoother::Output(long long raw, double smoothed)
+{
+	long long out = std::llround(smoothed);
+	if (frames && out <= lastOut)
+		out = lastOut + 1;
+
+	long long error = std::llabs(raw - out);
+	errorSum += (double)error;
+	if (error > errorMax)
+		errorMax = error;
+
+	frames++;
+	lastRaw = raw;
+	lastOut = out;
+	return out;
+}
+
+long long TimestampSmoother::Smooth(long long raw)
+{
+	if (nominal <= 0.0)
+		return raw;
+
+	if (!locked) {
+		phase = (double)raw;
+		period = nominal;
+		locked = true;
+		return Output(raw, phase);
+	}
+
+	double expected = phase + period;
+	double error = (double)raw - expected;
+	unsigned long long skipped = 0;
+	bool anomaly = std::fabs(error) > period * 0.5;
+
+	/* late by whole frames: frames were dropped */
+	if (anomaly && error > 0.0) {
+		double frameCount = std::floor(error / period + 0.5);
+		skipped = (unsigned long long)frameCount;
+		expected += frameCount * period;
+		error = (double)raw - expected;
+	}
+
+	/* the run of off frames is judged by the interval actually measured,
+	 * not by the phase error: at a new rate the phase error drifts back
+	 * inside the tolerance every few frames (at twice the rate, every
+	 * other frame), which would keep ending the run.  Jitter seldom puts
+	 * several intervals in a row a quarter of a frame off. */
+	double interval = (double)(raw - lastRaw);
+	if (std::fabs(interval - period) <= period * 0.25) {
+		drops += pendingDrops;
+		pendingDrops = 0;
+		anomalies = 0;
+
+	} else if (anomalies++ == 0) {
+		runStart = lastRaw;
+	}
+
+	/* timing has been off for a while, the rate must have changed */
+	if (anomalies >= RELOCK_FRAMES) {
+		period = (double)(raw - runStart) / (double)anomalies;
+		if (period < nominal * 0.1)
+			period = nominal * 0.1;
+		else if (period > nominal * 10.0)
+			period = nominal * 10.0;
+
+		phase = (double)raw;
+		anomalies = 0;
+		pendingDrops = 0;
+		rateChanges++;
+		return Output(raw, phase);
+	}
+
+	/* early by more than half a frame: just resync */
+	if (anomaly && !skipped) {
+		phase = (double)raw;
+		return Output(raw, phase);
+	}
+
+	pendingDrops += skipped;
+	phase = expected + PHASE_GAIN * error;
+	period += PERIOD_GAIN * error;
+	return Output(raw, phase);
+}
+
+void TimestampSmoother::GetStats(StreamStats &stats) const
+{
+	stats.smoothingMeanError =
+		frames ? std::llround(errorSum / (double)frames) : 0;
+	stats.smoothingMaxError = errorMax;
+	stats.detectedFrameDrops = drops;
+	stats.detectedRateChanges = rateChanges;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+namespace DShow {
+
+/**
+ * Removes jitter from video timestamps with a second-order PLL locked to
+ * the negotiated frame interval.
+ *
+ * A frame late by about a whole number of intervals counts as dropped
+ * frames, and the loop carries on from the right phase.  It doesn't
+ * smooth the gap away.  If the measured interval between frames stays off
+ * the period for several frames in a row, the frame rate is taken to have
+ * changed and the loop relocks to the new interval.
+ */
+class TimestampSmoother {
+	double nominal = 0.0;
+	double period = 0.0;
+	double phase = 0.0;
+	bool locked = false;
+
+	long long lastRaw = 0;
+	long long lastOut = 0;
+
+	long long runStart = 0;
+	int anomalies = 0;
+	unsigned long long pendingDrops = 0;
+
+	unsigned long long frames = 0;
+	double errorSum = 0.0;
+	long long errorMax = 0;
+	unsigned long long drops = 0;
+	unsigned long long rateChanges = 0;
+
+	long long Output(long long raw, double smoothed);
+
+public:
+	/** @param  interval  Nominal frame interval, 0 to pass times through */
+	void Reset(long long interval);
+
+	/** Returns the smoothed version of a frame's start time */
+	long long Smooth(long long raw);
+
+	void GetStats(StreamStats &stats) const;
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "timestamp-synth.hpp"
+
+namespace DShow {
+
+/* how far extrapolated time may fall behind arrival time before it snaps
+ * forward (frames were dropped, or the interval is wrong) */
+#define MAX_LAG_SAMPLES 4
+#define MIN_MAX_LAG 1000000LL /* 100ms */
+
+void TimestampSynthesizer::Reset()
+{
+	*this = TimestampSynthesizer();
+}
+
+void TimestampSynthesizer::Observe(long long start, long long stop,
+				   long long duration, long long arrival)
+{
+	offset = start - arrival;
+	haveOffset = true;
+
+	if (stop > start) {
+		nextStart = stop;
+		haveNext = true;
+	} else if (duration > 0) {
+		nextStart = start + duration;
+		haveNext = true;
+	} else {
+		nextStart = start;
+		haveNext = false;
+	}
+}
+
+void TimestampSynthesizer::Synthesize(long long arrival, long long duration,
+				      long long &start, long long &stop)
+{
+	/* with no device time at all, the stream starts at the first
+	 * sample, like stream time does */
+	if (!haveOffset) {
+		offset = -arrival;
+		haveOffset = true;
+	}
+
+	long long arrivalTime = arrival + offset;
+
+	if (haveNext && duration > 0) {
+		long long maxLag = duration * MAX_LAG_SAMPLES;
+		if (maxLag < MIN_MAX_LAG)
+			maxLag = MIN_MAX_LAG;
+
+		start = (arrivalTime - nextStart > maxLag) ? arrivalTime
+							   : nextStart;
+	} else {
+		/* never go back before the last sample */
+		start = arrivalTime < nextStart ? nextStart : arrivalTime;
+	}
+
+	stop = start + duration;
+	nextStart = stop;
+	haveNext = duration > 0;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+namespace DShow {
+
+/**
+ * Makes up timestamps for samples that arrive without one.
+ *
+ * Untimed samples continue on from the last timestamp (real or made up)
+ * by the duration of the sample, i.e. the frame interval for video or the
+ * sample count for audio.  When that isn't possible, or when it has fallen
+ * too far behind, the arrival time of the sample is used instead, mapped
+ * onto the device's timeline through the last real timestamp.
+ *
+ * All times are in 100-nanosecond units.  Arrival times are passed in so
+ * the caller picks the clock.
+ */
+class TimestampSynthesizer {
+	long long offset = 0;
+	long long nextStart = 0;
+	bool haveOffset = false;
+	bool haveNext = false;
+
+public:
+	void Reset();
+
+	/** Records a sample that had a timestamp */
+	void Observe(long long start, long long stop, long long duration,
+		     long long arrival);
+
+	/**
+	 * Makes up a timestamp for a sample without one
+	 *
+	 * @param  arrival   When the sample arrived, on a monotonic clock
+	 * @param  duration  Length of the sample, or 0 if unknown
+	 */
+	void Synthesize(long long arrival, long long duration,
+			long long &start, long long &stop);
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,511 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+
+#if DSHOW_X86
+#include <immintrin.h>
+
+namespace DShow {
+
+namespace {
+
+/* same split as the SSSE3 kernel, repeated in both 128-bit lanes */
+template<class L, bool NV12> static inline __m256i SplitMask()
+{
+	const char y = (char)L::Y, u = (char)L::U, v = (char)L::V;
+
+	if (NV12)
+		return _mm256_setr_epi8(
+			y, y + 2, y + 4, y + 6, y + 8, y + 10, y + 12, y + 14,
+			u, v, u + 4, v + 4, u + 8, v + 8, u + 12, v + 12, y,
+			y + 2, y + 4, y + 6, y + 8, y + 10, y + 12, y + 14, u,
+			v, u + 4, v + 4, u + 8, v + 8, u + 12, v + 12);
+	else
+		return _mm256_setr_epi8(
+			y, y + 2, y + 4, y + 6, y + 8, y + 10, y + 12, y + 14,
+			u, u + 4, u + 8, u + 12, v, v + 4, v + 8, v + 12, y,
+			y + 2, y + 4, y + 6, y + 8, y + 10, y + 12, y + 14, u,
+			u + 4, u + 8, u + 12, v, v + 4, v + 8, v + 12);
+}
+
+/* 64-bit element order after unpacking two split registers */
+#define QWORD_ORDER _MM_SHUFFLE(3, 1, 2, 0)
+
+template<class L, bool NV12> struct PackedRowAVX2 {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width)
+	{
+		const __m256i mask = SplitMask<L, NV12>();
+		const __m256i planar = _mm256_setr_epi8(
+			0, 1, 2, 3, 8, 9, 10, 11, 4, 5, 6, 7, 12, 13, 14, 15,
+			0, 1, 2, 3, 8, 9, 10, 11, 4, 5, 6, 7, 12, 13, 14, 15);
+		const int end = width & ~31;
+
+		for (int x = 0; x < end; x += 32) {
+			const unsigned char *p0 = s0 + x * 2;
+			const unsigned char *p1 = s1 + x * 2;
+
+			__m256i a0 = _mm256_shuffle_epi8(
+				_mm256_loadu_si256((const __m256i *)p0), mask);
+			__m256i b0 = _mm256_shuffle_epi8(
+				_mm256_loadu_si256(
+					(const __m256i *)(p0 + 32)),
+				mask);
+			__m256i a1 = _mm256_shuffle_epi8(
+				_mm256_loadu_si256((const __m256i *)p1), mask);
+			__m256i b1 = _mm256_shuffle_epi8(
+				_mm256_loadu_si256(
+					(const __m256i *)(p1 + 32)),
+				mask);
+
+			__m256i luma0 = _mm256_permute4x64_epi64(
+				_mm256_unpacklo_epi64(a0, b0), QWORD_ORDER);
+			__m256i luma1 = _mm256_permute4x64_epi64(
+				_mm256_unpacklo_epi64(a1, b1), QWORD_ORDER);
+			_mm256_storeu_si256((__m256i *)(y0 + x), luma0);
+			_mm256_storeu_si256((__m256i *)(y1 + x), luma1);
+
+			__m256i c = _mm256_avg_epu8(
+				_mm256_unpackhi_epi64(a0, b0),
+				_mm256_unpackhi_epi64(a1, b1));
+			c = _mm256_permute4x64_epi64(c, QWORD_ORDER);
+
+			if (NV12) {
+				_mm256_storeu_si256((__m256i *)(u + x), c);
+			} else {
+				c = _mm256_permute4x64_epi64(
+					_mm256_shuffle_epi8(c, planar),
+					QWORD_ORDER);
+				_mm_storeu_si128((__m128i *)(u + x / 2),
+						 _mm256_castsi256_si128(c));
+				_mm_storeu_si128(
+					(__m128i *)(v + x / 2),
+					_mm256_extracti128_si256(c, 1));
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+static inline __m256i Combine(__m128i lo, __m128i hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+/* 32-bit (first, second) chroma pairs to per-pixel 16-bit samples */
+static inline void SplitPairs(__m256i c, __m256i &first, __m256i &second)
+{
+	first = _mm256_and_si256(c, _mm256_set1_epi32(0xFFFF));
+	first = _mm256_or_si256(first, _mm256_slli_epi32(first, 16));
+	second = _mm256_srli_epi32(c, 16);
+	second = _mm256_or_si256(second, _mm256_slli_epi32(second, 16));
+}
+
+/* 16-bit luma and chroma samples of 16 pixels, in pixel order */
+template<class Src> struct LoadAVX2;
+
+template<bool Swap> struct LoadAVX2<SrcPlanar<Swap>> {
+	static inline void Run(const YUVRow &r, int x, __m256i &y, __m256i &u,
+			       __m256i &v)
+	{
+		y = _mm256_cvtepu8_epi16(
+			_mm_loadu_si128((const __m128i *)(r.y + x)));
+
+		__m128i cu = _mm_cvtepu8_epi16(
+			_mm_loadl_epi64((const __m128i *)(r.u + x / 2)));
+		__m128i cv = _mm_cvtepu8_epi16(
+			_mm_loadl_epi64((const __m128i *)(r.v + x / 2)));
+		u = Combine(_mm_unpacklo_epi16(cu, cu),
+			    _mm_unpackhi_epi16(cu, cu));
+		v = Combine(_mm_unpacklo_epi16(cv, cv),
+			    _mm_unpackhi_epi16(cv, cv));
+	}
+};
+
+template<> struct LoadAVX2<SrcNV12> {
+	static inline void Run(const YUVRow &r, int x, __m256i &y, __m256i &u,
+			       __m256i &v)
+	{
+		y = _mm256_cvtepu8_epi16(
+			_mm_loadu_si128((const __m128i *)(r.y + x)));
+		SplitPairs(_mm256_cvtepu8_epi16(_mm_loadu_si128(
+				   (const __m128i *)(r.u + x))),
+			   u, v);
+	}
+};
+
+template<class L> struct LoadAVX2<SrcPacked<L>> {
+	static inline void Run(const YUVRow &r, int x, __m256i &y, __m256i &u,
+			       __m256i &v)
+	{
+		const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+		__m256i p = _mm256_loadu_si256((const __m256i *)(r.y + x * 2));
+		__m256i c;
+
+		if (L::Y == 0) {
+			y = _mm256_and_si256(p, lowBytes);
+			c = _mm256_srli_epi16(p, 8);
+		} else {
+			y = _mm256_srli_epi16(p, 8);
+			c = _mm256_and_si256(p, lowBytes);
+		}
+
+		if (L::U < L::V)
+			SplitPairs(c, u, v);
+		else
+			SplitPairs(c, v, u);
+	}
+};
+
+template<> struct LoadAVX2<SrcP010> {
+	static inline void Run(const YUVRow &r, int x, __m256i &y, __m256i &u,
+			       __m256i &v)
+	{
+		y = _mm256_srli_epi16(
+			_mm256_loadu_si256((const __m256i *)(r.y + x * 2)), 6);
+		__m256i c = _mm256_loadu_si256((const __m256i *)(r.u + x * 2));
+		SplitPairs(_mm256_srli_epi16(c, 6), u, v);
+	}
+};
+
+static inline __m256i ToByte(__m256i val)
+{
+	return _mm256_min_epi16(_mm256_max_epi16(_mm256_srai_epi16(val, 3),
+						 _mm256_setzero_si256()),
+				_mm256_set1_epi16(255));
+}
+
+template<class Src, class Dst> struct YUVRowAVX2 {
+	static int Run(const YUVRow &r, unsigned char *out, int width,
+		       const YUVCoefficients &c)
+	{
+		const __m256i yOffset =
+			_mm256_set1_epi16((short)(c.yOffset * Src::Scale));
+		const __m256i center = _mm256_set1_epi16(128 * Src::Scale);
+		const __m256i cy = _mm256_set1_epi16(c.y);
+		const __m256i crv = _mm256_set1_epi16(c.rv);
+		const __m256i cgu = _mm256_set1_epi16(c.gu);
+		const __m256i cgv = _mm256_set1_epi16(c.gv);
+		const __m256i cbu = _mm256_set1_epi16(c.bu);
+		const __m256i round = _mm256_set1_epi16(4);
+		const __m256i alpha = _mm256_set1_epi16((short)0xFF00);
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			__m256i y, u, v;
+			LoadAVX2<Src>::Run(r, x, y, u, v);
+
+			y = _mm256_slli_epi16(_mm256_sub_epi16(y, yOffset),
+					      Src::Shift);
+			u = _mm256_slli_epi16(_mm256_sub_epi16(u, center),
+					      Src::Shift);
+			v = _mm256_slli_epi16(_mm256_sub_epi16(v, center),
+					      Src::Shift);
+
+			__m256i yt = _mm256_add_epi16(
+				_mm256_mulhi_epi16(y, cy), round);
+			__m256i cr = ToByte(_mm256_add_epi16(
+				yt, _mm256_mulhi_epi16(v, crv)));
+			__m256i cg = ToByte(_mm256_add_epi16(
+				_mm256_add_epi16(yt,
+						 _mm256_mulhi_epi16(u, cgu)),
+				_mm256_mulhi_epi16(v, cgv)));
+			__m256i cb = ToByte(_mm256_add_epi16(
+				yt, _mm256_mulhi_epi16(u, cbu)));
+
+			__m256i lo = _mm256_or_si256(Dst::R == 0 ? cr : cb,
+						     _mm256_slli_epi16(cg, 8));
+			__m256i hi =
+				_mm256_or_si256(Dst::R == 0 ? cb : cr, alpha);
+
+			/* unpacking is per 128-bit lane: pixels 0-3 and 8-11,
+			 * then 4-7 and 12-15 */
+			__m256i a = _mm256_unpacklo_epi16(lo, hi);
+			__m256i b = _mm256_unpackhi_epi16(lo, hi);
+
+			_mm256_storeu_si256((__m256i *)(out + x * 4),
+					    _mm256_permute2x128_si256(a, b,
+								      0x20));
+			_mm256_storeu_si256((__m256i *)(out + x * 4 + 32),
+					    _mm256_permute2x128_si256(a, b,
+								      0x31));
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+struct NarrowRowAVX2 {
+	static int Run(const unsigned char *src, unsigned char *dst, int count,
+		       const uint16_t *bias)
+	{
+		const __m256i b = _mm256_set1_epi64x(
+			(long long)((uint64_t)bias[0] |
+				    ((uint64_t)bias[1] << 16) |
+				    ((uint64_t)bias[2] << 32) |
+				    ((uint64_t)bias[3] << 48)));
+		const int end = count & ~31;
+
+		for (int x = 0; x < end; x += 32) {
+			__m256i lo = _mm256_loadu_si256(
+				(const __m256i *)(src + x * 2));
+			__m256i hi = _mm256_loadu_si256(
+				(const __m256i *)(src + x * 2 + 32));
+
+			lo = _mm256_srli_epi16(_mm256_adds_epu16(lo, b), 8);
+			hi = _mm256_srli_epi16(_mm256_adds_epu16(hi, b), 8);
+			_mm256_storeu_si256(
+				(__m256i *)(dst + x),
+				_mm256_permute4x64_epi64(
+					_mm256_packus_epi16(lo, hi),
+					QWORD_ORDER));
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+/* the SSSE3 expansion shuffle, in both 128-bit lanes */
+template<class Dst> static inline __m256i ExpandMask()
+{
+	/* source byte of each output byte: BGRA keeps the order and RGBA
+	 * swaps the first and third, which is just Dst::B and Dst::R */
+	const char b = (char)Dst::B, r = (char)Dst::R;
+	const char none = (char)0x80;
+
+	return _mm256_setr_epi8(b, 1, r, none, b + 3, 4, r + 3, none, b + 6,
+				7, r + 6, none, b + 9, 10, r + 9, none, b, 1,
+				r, none, b + 3, 4, r + 3, none, b + 6, 7,
+				r + 6, none, b + 9, 10, r + 9, none);
+}
+
+template<class Dst> struct ExpandRowAVX2 {
+	/* eight pixels: four from each of two overlapping 16-byte loads */
+	static inline __m256i Load(const unsigned char *s)
+	{
+		return Combine(_mm_loadu_si128((const __m128i *)s),
+			       _mm_loadu_si128((const __m128i *)(s + 12)));
+	}
+
+	static int Run(const unsigned char *src, unsigned char *dst, int width)
+	{
+		const __m256i mask = ExpandMask<Dst>();
+		const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+		/* the last load reads 4 bytes past its pixels, so two more
+		 * pixels must be left in the row */
+		const int end = width >= 34 ? (width - 2) & ~31 : 0;
+
+		for (int x = 0; x < end; x += 32) {
+			const unsigned char *s = src + x * 3;
+			unsigned char *d = dst + x * 4;
+
+			for (int i = 0; i < 4; i++) {
+				__m256i p = _mm256_shuffle_epi8(
+					Load(s + i * 24), mask);
+				_mm256_storeu_si256(
+					(__m256i *)(d + i * 32),
+					_mm256_or_si256(p, alpha));
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+/* tone mapping eight pixels at a time in 32-bit lanes, gathering from the
+ * tables */
+
+static inline __m256i LoadP010x8(const unsigned char *p)
+{
+	return _mm256_srli_epi32(
+		_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p)), 6);
+}
+
+static inline __m256i Clamp32(__m256i val, int max)
+{
+	return _mm256_min_epi32(_mm256_max_epi32(val, _mm256_setzero_si256()),
+				_mm256_set1_epi32(max));
+}
+
+static inline __m256i MulAdd(__m256i sum, __m256i val, int coefficient)
+{
+	return _mm256_add_epi32(
+		sum, _mm256_mullo_epi32(val, _mm256_set1_epi32(coefficient)));
+}
+
+/* one row of the gamut matrix, then the gamma table */
+static inline __m256i ToGamma(const TonemapTables &t, const int32_t *m,
+			      __m256i r, __m256i g, __m256i b)
+{
+	__m256i sum = _mm256_set1_epi32(1 << (TONEMAP_SHIFT - 1));
+	sum = MulAdd(MulAdd(MulAdd(sum, r, m[0]), g, m[1]), b, m[2]);
+	sum = Clamp32(_mm256_srai_epi32(sum, TONEMAP_SHIFT), TONEMAP_MAX);
+	return _mm256_i32gather_epi32((const int *)t.toGamma, sum, 4);
+}
+
+static inline void TonemapPixels(const TonemapTables &t,
+				 const YUVCoefficients &c, __m256i y, __m256i u,
+				 __m256i v, __m256i &r, __m256i &g, __m256i &b)
+{
+	const int *toLinear = (const int *)t.toLinear;
+
+	__m256i yt = _mm256_sub_epi32(y, _mm256_set1_epi32(c.yOffset * 4));
+	yt = MulAdd(_mm256_set1_epi32(4096), yt, c.y);
+	u = _mm256_sub_epi32(u, _mm256_set1_epi32(512));
+	v = _mm256_sub_epi32(v, _mm256_set1_epi32(512));
+
+	__m256i er = Clamp32(_mm256_srai_epi32(MulAdd(yt, v, c.rv), 13), 1023);
+	__m256i eg = Clamp32(
+		_mm256_srai_epi32(MulAdd(MulAdd(yt, u, c.gu), v, c.gv), 13),
+		1023);
+	__m256i eb = Clamp32(_mm256_srai_epi32(MulAdd(yt, u, c.bu), 13), 1023);
+
+	__m256i lr = _mm256_i32gather_epi32(toLinear, er, 4);
+	__m256i lg = _mm256_i32gather_epi32(toLinear, eg, 4);
+	__m256i lb = _mm256_i32gather_epi32(toLinear, eb, 4);
+
+	r = ToGamma(t, t.gamut, lr, lg, lb);
+	g = ToGamma(t, t.gamut + 3, lr, lg, lb);
+	b = ToGamma(t, t.gamut + 6, lr, lg, lb);
+}
+
+static inline __m256i WeightedSum(__m256i r, __m256i g, __m256i b, int cr,
+				  int cg, int cb, int bias, int shift)
+{
+	__m256i sum = _mm256_set1_epi32(bias + (1 << (shift - 1)));
+	sum = MulAdd(MulAdd(MulAdd(sum, r, cr), g, cg), b, cb);
+	return Clamp32(_mm256_sra_epi32(sum, _mm_cvtsi32_si128(shift)), 255);
+}
+
+/* eight 32-bit values of 0-255 to bytes */
+static inline void StoreBytes(unsigned char *dst, __m256i val)
+{
+	__m128i words = _mm_packs_epi32(_mm256_castsi256_si128(val),
+					_mm256_extracti128_si256(val, 1));
+	_mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(words, words));
+}
+
+/* sums of adjacent pairs, in the even lanes */
+static inline __m256i PairSums(__m256i val)
+{
+	return _mm256_add_epi32(val, _mm256_srli_epi64(val, 32));
+}
+
+struct TonemapRowAVX2 {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       const unsigned char *uv, unsigned char *y0,
+		       unsigned char *y1, unsigned char *out, int width,
+		       const ConvertFrame &f)
+	{
+		const TonemapTables &t = *f.tonemap;
+		const RGBCoefficients &c = f.toYUV;
+		const __m256i firsts =
+			_mm256_setr_epi32(0, 0, 2, 2, 4, 4, 6, 6);
+		const __m256i seconds =
+			_mm256_setr_epi32(1, 1, 3, 3, 5, 5, 7, 7);
+		const int lumaBias = c.yOffset << RGB_LUMA_SHIFT;
+		const int chromaBias = 128 << RGB_CHROMA_SHIFT;
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			__m256i chroma = LoadP010x8(uv + x * 2);
+			__m256i u = _mm256_permutevar8x32_epi32(chroma, firsts);
+			__m256i v =
+				_mm256_permutevar8x32_epi32(chroma, seconds);
+
+			__m256i r0, g0, b0, r1, g1, b1;
+			TonemapPixels(t, f.toRGB, LoadP010x8(s0 + x * 2), u, v,
+				      r0, g0, b0);
+			TonemapPixels(t, f.toRGB, LoadP010x8(s1 + x * 2), u, v,
+				      r1, g1, b1);
+
+			StoreBytes(y0 + x,
+				   WeightedSum(r0, g0, b0, c.yr, c.yg, c.yb,
+					       lumaBias, RGB_LUMA_SHIFT));
+			StoreBytes(y1 + x,
+				   WeightedSum(r1, g1, b1, c.yr, c.yg, c.yb,
+					       lumaBias, RGB_LUMA_SHIFT));
+
+			__m256i rs = PairSums(_mm256_add_epi32(r0, r1));
+			__m256i gs = PairSums(_mm256_add_epi32(g0, g1));
+			__m256i bs = PairSums(_mm256_add_epi32(b0, b1));
+
+			__m256i cu = WeightedSum(rs, gs, bs, c.ur, c.ug, c.ub,
+						 chromaBias, RGB_CHROMA_SHIFT);
+			__m256i cv = WeightedSum(rs, gs, bs, c.vr, c.vg, c.vb,
+						 chromaBias, RGB_CHROMA_SHIFT);
+			/* u in the even lanes, v moved to the odd ones */
+			cv = _mm256_slli_epi64(cv, 32);
+			StoreBytes(out + x, _mm256_blend_epi32(cu, cv, 0xAA));
+		}
+
+		return end;
+	}
+};
+
+}
+
+ConvertKernel GetConvertKernelAVX2(VideoFormat from, VideoFormat to)
+{
+	ConvertKernel kernel = SelectPackedTo420<PackedRowAVX2>(from, to);
+	if (!kernel)
+		kernel = SelectYUVToRGB<YUVRowAVX2>(from, to);
+	if (!kernel)
+		kernel = SelectNarrow<NarrowRowAVX2>(from, to);
+	if (!kernel)
+		kernel = SelectExpandRGB24<ExpandRowAVX2>(from, to);
+	return kernel;
+}
+
+ConvertKernel GetTonemapKernelAVX2(VideoFormat from, VideoFormat to)
+{
+	return SelectTonemap<TonemapRowAVX2>(from, to);
+}
+
+}; /* namespace DShow */
+
+#else
+
+namespace DShow {
+
+ConvertKernel GetConvertKernelAVX2(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+ConvertKernel GetTonemapKernelAVX2(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+}; /* namespace DShow */
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+
+#if DSHOW_X86
+#include <immintrin.h>
+
+namespace DShow {
+
+namespace {
+
+/* the plain forms of some intrinsics pass an undefined vector through,
+ * which GCC 12 warns may be used uninitialized.  Their zero-masking forms
+ * with every element selected compile to the same instructions. */
+#define ALL_QWORDS ((__mmask8)-1)
+#define ALL_DWORDS ((__mmask16)-1)
+
+/* the SSSE3 split mask in all four 128-bit lanes */
+template<class L, bool NV12> static inline __m512i SplitMask()
+{
+	const char y = (char)L::Y, u = (char)L::U, v = (char)L::V;
+	__m128i mask;
+
+	if (NV12)
+		mask = _mm_setr_epi8(y, y + 2, y + 4, y + 6, y + 8, y + 10,
+				     y + 12, y + 14, u, v, u + 4, v + 4, u + 8,
+				     v + 8, u + 12, v + 12);
+	else
+		mask = _mm_setr_epi8(y, y + 2, y + 4, y + 6, y + 8, y + 10,
+				     y + 12, y + 14, u, u + 4, u + 8, u + 12, v,
+				     v + 4, v + 8, v + 12);
+
+	return _mm512_maskz_broadcast_i32x4(ALL_DWORDS, mask);
+}
+
+template<class L, bool NV12> struct PackedRowAVX512 {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width)
+	{
+		const __m512i mask = SplitMask<L, NV12>();
+		/* each lane holds luma in its low and chroma in its high
+		 * 64 bits, so gather the even and odd qwords of a pair */
+		const __m512i evens =
+			_mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+		const __m512i odds =
+			_mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+		/* UUUUVVVV dwords to all the U, then all the V */
+		const __m512i planar = _mm512_setr_epi32(
+			0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+		const int end = width & ~63;
+
+		for (int x = 0; x < end; x += 64) {
+			const unsigned char *p0 = s0 + x * 2;
+			const unsigned char *p1 = s1 + x * 2;
+
+			__m512i a0 = _mm512_shuffle_epi8(
+				_mm512_loadu_si512(p0), mask);
+			__m512i b0 = _mm512_shuffle_epi8(
+				_mm512_loadu_si512(p0 + 64), mask);
+			__m512i a1 = _mm512_shuffle_epi8(
+				_mm512_loadu_si512(p1), mask);
+			__m512i b1 = _mm512_shuffle_epi8(
+				_mm512_loadu_si512(p1 + 64), mask);
+
+			_mm512_storeu_si512(
+				y0 + x, _mm512_permutex2var_epi64(a0, evens,
+								  b0));
+			_mm512_storeu_si512(
+				y1 + x, _mm512_permutex2var_epi64(a1, evens,
+								  b1));
+
+			__m512i c = _mm512_avg_epu8(
+				_mm512_permutex2var_epi64(a0, odds, b0),
+				_mm512_permutex2var_epi64(a1, odds, b1));
+
+			if (NV12) {
+				_mm512_storeu_si512(u + x, c);
+			} else {
+				c = _mm512_maskz_permutexvar_epi32(ALL_DWORDS,
+								   planar, c);
+				_mm256_storeu_si256(
+					(__m256i *)(u + x / 2),
+					_mm512_maskz_extracti64x4_epi64(
+						ALL_QWORDS, c, 0));
+				_mm256_storeu_si256(
+					(__m256i *)(v + x / 2),
+					_mm512_maskz_extracti64x4_epi64(
+						ALL_QWORDS, c, 1));
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+/* 16 chroma bytes to 32 words, each repeated for the pixel pair */
+static inline __m512i Duplicate(const unsigned char *p)
+{
+	__m128i c = _mm_loadu_si128((const __m128i *)p);
+	__m256i pairs = _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_unpacklo_epi8(c, c)),
+		_mm_unpackhi_epi8(c, c), 1);
+	return _mm512_cvtepu8_epi16(pairs);
+}
+
+/* 32-bit (first, second) chroma pairs to per-pixel 16-bit samples, by
+ * repeating the low or high word of each dword */
+static inline void SplitPairs(__m512i c, __m512i &first, __m512i &second)
+{
+	const __m512i low = _mm512_set4_epi64(
+		0x0D0C0D0C09080908, 0x0504050401000100, 0x0D0C0D0C09080908,
+		0x0504050401000100);
+	const __m512i high = _mm512_set4_epi64(
+		0x0F0E0F0E0B0A0B0A, 0x0706070603020302, 0x0F0E0F0E0B0A0B0A,
+		0x0706070603020302);
+
+	first = _mm512_shuffle_epi8(c, low);
+	second = _mm512_shuffle_epi8(c, high);
+}
+
+/* 16-bit luma and chroma samples of 32 pixels, in pixel order */
+template<class Src> struct LoadAVX512;
+
+template<bool Swap> struct LoadAVX512<SrcPlanar<Swap>> {
+	static inline void Run(const YUVRow &r, int x, __m512i &y, __m512i &u,
+			       __m512i &v)
+	{
+		y = _mm512_cvtepu8_epi16(
+			_mm256_loadu_si256((const __m256i *)(r.y + x)));
+		u = Duplicate(r.u + x / 2);
+		v = Duplicate(r.v + x / 2);
+	}
+};
+
+template<> struct LoadAVX512<SrcNV12> {
+	static inline void Run(const YUVRow &r, int x, __m512i &y, __m512i &u,
+			       __m512i &v)
+	{
+		y = _mm512_cvtepu8_epi16(
+			_mm256_loadu_si256((const __m256i *)(r.y + x)));
+		SplitPairs(_mm512_cvtepu8_epi16(_mm256_loadu_si256(
+				   (const __m256i *)(r.u + x))),
+			   u, v);
+	}
+};
+
+template<class L> struct LoadAVX512<SrcPacked<L>> {
+	static inline void Run(const YUVRow &r, int x, __m512i &y, __m512i &u,
+			       __m512i &v)
+	{
+		const __m512i lowBytes = _mm512_set1_epi16(0x00FF);
+		__m512i p = _mm512_loadu_si512(r.y + x * 2);
+		__m512i c;
+
+		if (L::Y == 0) {
+			y = _mm512_and_si512(p, lowBytes);
+			c = _mm512_srli_epi16(p, 8);
+		} else {
+			y = _mm512_srli_epi16(p, 8);
+			c = _mm512_and_si512(p, lowBytes);
+		}
+
+		if (L::U < L::V)
+			SplitPairs(c, u, v);
+		else
+			SplitPairs(c, v, u);
+	}
+};
+
+template<> struct LoadAVX512<SrcP010> {
+	static inline void Run(const YUVRow &r, int x, __m512i &y, __m512i &u,
+			       __m512i &v)
+	{
+		y = _mm512_srli_epi16(_mm512_loadu_si512(r.y + x * 2), 6);
+		__m512i c = _mm512_loadu_si512(r.u + x * 2);
+		SplitPairs(_mm512_srli_epi16(c, 6), u, v);
+	}
+};
+
+static inline __m512i ToByte(__m512i val)
+{
+	return _mm512_min_epi16(_mm512_max_epi16(_mm512_srai_epi16(val, 3),
+						 _mm512_setzero_si512()),
+				_mm512_set1_epi16(255));
+}
+
+template<class Src, class Dst> struct YUVRowAVX512 {
+	static int Run(const YUVRow &r, unsigned char *out, int width,
+		       const YUVCoefficients &c)
+	{
+		const __m512i yOffset =
+			_mm512_set1_epi16((short)(c.yOffset * Src::Scale));
+		const __m512i center = _mm512_set1_epi16(128 * Src::Scale);
+		const __m512i cy = _mm512_set1_epi16(c.y);
+		const __m512i crv = _mm512_set1_epi16(c.rv);
+		const __m512i cgu = _mm512_set1_epi16(c.gu);
+		const __m512i cgv = _mm512_set1_epi16(c.gv);
+		const __m512i cbu = _mm512_set1_epi16(c.bu);
+		const __m512i round = _mm512_set1_epi16(4);
+		const __m512i alpha = _mm512_set1_epi16((short)0xFF00);
+		/* unpacking is per 128-bit lane, giving pixels 0-3, 8-11,
+		 * 16-19, 24-27 and 4-7, 12-15, 20-23, 28-31 */
+		const __m512i first =
+			_mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+		const __m512i second =
+			_mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+		const int end = width & ~31;
+
+		for (int x = 0; x < end; x += 32) {
+			__m512i y, u, v;
+			LoadAVX512<Src>::Run(r, x, y, u, v);
+
+			y = _mm512_slli_epi16(_mm512_sub_epi16(y, yOffset),
+					      Src::Shift);
+			u = _mm512_slli_epi16(_mm512_sub_epi16(u, center),
+					      Src::Shift);
+			v = _mm512_slli_epi16(_mm512_sub_epi16(v, center),
+					      Src::Shift);
+
+			__m512i yt = _mm512_add_epi16(
+				_mm512_mulhi_epi16(y, cy), round);
+			__m512i cr = ToByte(_mm512_add_epi16(
+				yt, _mm512_mulhi_epi16(v, crv)));
+			__m512i cg = ToByte(_mm512_add_epi16(
+				_mm512_add_epi16(yt,
+						 _mm512_mulhi_epi16(u, cgu)),
+				_mm512_mulhi_epi16(v, cgv)));
+			__m512i cb = ToByte(_mm512_add_epi16(
+				yt, _mm512_mulhi_epi16(u, cbu)));
+
+			__m512i lo = _mm512_or_si512(Dst::R == 0 ? cr : cb,
+						     _mm512_slli_epi16(cg, 8));
+			__m512i hi =
+				_mm512_or_si512(Dst::R == 0 ? cb : cr, alpha);
+
+			__m512i a = _mm512_unpacklo_epi16(lo, hi);
+			__m512i b = _mm512_unpackhi_epi16(lo, hi);
+
+			_mm512_storeu_si512(
+				out + x * 4,
+				_mm512_permutex2var_epi64(a, first, b));
+			_mm512_storeu_si512(
+				out + x * 4 + 64,
+				_mm512_permutex2var_epi64(a, second, b));
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+struct NarrowRowAVX512 {
+	static int Run(const unsigned char *src, unsigned char *dst, int count,
+		       const uint16_t *bias)
+	{
+		const __m512i b = _mm512_set1_epi64(
+			(long long)((uint64_t)bias[0] |
+				    ((uint64_t)bias[1] << 16) |
+				    ((uint64_t)bias[2] << 32) |
+				    ((uint64_t)bias[3] << 48)));
+		/* packing is per 128-bit lane too */
+		const __m512i order =
+			_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+		const int end = count & ~63;
+
+		for (int x = 0; x < end; x += 64) {
+			__m512i lo = _mm512_loadu_si512(src + x * 2);
+			__m512i hi = _mm512_loadu_si512(src + x * 2 + 64);
+
+			lo = _mm512_srli_epi16(_mm512_adds_epu16(lo, b), 8);
+			hi = _mm512_srli_epi16(_mm512_adds_epu16(hi, b), 8);
+			_mm512_storeu_si512(
+				dst + x,
+				_mm512_maskz_permutexvar_epi64(
+					ALL_QWORDS, order,
+					_mm512_packus_epi16(lo, hi)));
+		}
+
+		return end;
+	}
+};
+
+}
+
+ConvertKernel GetConvertKernelAVX512(VideoFormat from, VideoFormat to)
+{
+	ConvertKernel kernel = SelectPackedTo420<PackedRowAVX512>(from, to);
+	if (!kernel)
+		kernel = SelectYUVToRGB<YUVRowAVX512>(from, to);
+	if (!kernel)
+		kernel = SelectNarrow<NarrowRowAVX512>(from, to);
+	return kernel;
+}
+
+}; /* namespace DShow */
+
+#else
+
+namespace DShow {
+
+ConvertKernel GetConvertKernelAVX512(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+}; /* namespace DShow */
+
+#endif
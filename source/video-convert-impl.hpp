@@ -0,0 +1,1300 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+/* Shared by the per-instruction-set kernel files.  Everything in here must
+ * have internal linkage: each file is built with different code generation
+ * flags, and the linker must not merge their copies. */
+
+#pragma once
+
+#include "video-convert.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace DShow {
+
+/* byte positions within a 4:2:2 macropixel (two pixels); the second luma
+ * sample is always Y + 2 */
+struct LayoutYUY2 {
+	enum { Y = 0, U = 1, V = 3 };
+};
+
+struct LayoutYVYU {
+	enum { Y = 0, U = 3, V = 1 };
+};
+
+struct LayoutUYVY {
+	enum { Y = 1, U = 0, V = 2 };
+};
+
+/* scalar reference, also used for the columns left over by SIMD code.  The
+ * chroma of the two rows is averaged rounding up, like pavgb/vrhadd */
+template<class L, bool NV12>
+static inline void PackedRowsTo420Scalar(const unsigned char *s0,
+					 const unsigned char *s1,
+					 unsigned char *y0, unsigned char *y1,
+					 unsigned char *u, unsigned char *v,
+					 int x, int width)
+{
+	for (; x < width; x += 2) {
+		const unsigned char *p0 = s0 + x * 2;
+		const unsigned char *p1 = s1 + x * 2;
+
+		y0[x] = p0[L::Y];
+		y1[x] = p1[L::Y];
+		if (x + 1 < width) {
+			y0[x + 1] = p0[L::Y + 2];
+			y1[x + 1] = p1[L::Y + 2];
+		}
+
+		unsigned char cu =
+			(unsigned char)((p0[L::U] + p1[L::U] + 1) >> 1);
+		unsigned char cv =
+			(unsigned char)((p0[L::V] + p1[L::V] + 1) >> 1);
+
+		if (NV12) {
+			u[x] = cu;
+			u[x + 1] = cv;
+		} else {
+			u[x / 2] = cu;
+			v[x / 2] = cv;
+		}
+	}
+}
+
+/* row functions convert as many leading pixels of a row pair as they can and
+ * return how many they did (always even) */
+namespace {
+template<class L, bool NV12> struct PackedRowNone {
+	static inline int Run(const unsigned char *, const unsigned char *,
+			      unsigned char *, unsigned char *, unsigned char *,
+			      unsigned char *, int)
+	{
+		return 0;
+	}
+};
+}
+
+/* destination chroma planes of 4:2:0 output; YV12 has V before U */
+template<bool NV12, bool SwapUV>
+static inline void ChromaRows(const ConvertFrame &f, int y, unsigned char *&u,
+			      unsigned char *&v)
+{
+	const int up = SwapUV ? 2 : 1;
+	const int vp = SwapUV ? 1 : 2;
+
+	u = f.dst[up] + (ptrdiff_t)(y / 2) * f.dstStride[up];
+	v = NV12 ? nullptr : f.dst[vp] + (ptrdiff_t)(y / 2) * f.dstStride[vp];
+}
+
+template<template<class, bool> class Row, class L, bool NV12,
+	 bool SwapUV = false>
+static void PackedTo420(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y += 2) {
+		const unsigned char *s0 =
+			f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		unsigned char *y0 = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+		unsigned char *u, *v;
+		ChromaRows<NV12, SwapUV>(f, y, u, v);
+
+		/* for an odd last row, the row is simply paired with itself,
+		 * which writes its luma twice to the same place */
+		bool pair = y + 1 < f.height;
+		const unsigned char *s1 = pair ? s0 + f.srcStride[0] : s0;
+		unsigned char *y1 = pair ? y0 + f.dstStride[0] : y0;
+
+		int x = Row<L, NV12>::Run(s0, s1, y0, y1, u, v, f.width);
+		PackedRowsTo420Scalar<L, NV12>(s0, s1, y0, y1, u, v, x,
+					       f.width);
+	}
+}
+
+template<template<class, bool> class Row>
+static ConvertKernel SelectPackedTo420(VideoFormat from, VideoFormat to)
+{
+	if (to == VideoFormat::NV12) {
+		switch (from) {
+		case VideoFormat::YUY2:
+			return PackedTo420<Row, LayoutYUY2, true>;
+		case VideoFormat::YVYU:
+			return PackedTo420<Row, LayoutYVYU, true>;
+		case VideoFormat::UYVY:
+		case VideoFormat::HDYC:
+			return PackedTo420<Row, LayoutUYVY, true>;
+		default:
+			return nullptr;
+		}
+
+	} else if (to == VideoFormat::I420) {
+		switch (from) {
+		case VideoFormat::YUY2:
+			return PackedTo420<Row, LayoutYUY2, false>;
+		case VideoFormat::YVYU:
+			return PackedTo420<Row, LayoutYVYU, false>;
+		case VideoFormat::UYVY:
+		case VideoFormat::HDYC:
+			return PackedTo420<Row, LayoutUYVY, false>;
+		default:
+			return nullptr;
+		}
+
+	} else if (to == VideoFormat::YV12) {
+		switch (from) {
+		case VideoFormat::YUY2:
+			return PackedTo420<Row, LayoutYUY2, false, true>;
+		case VideoFormat::YVYU:
+			return PackedTo420<Row, LayoutYVYU, false, true>;
+		case VideoFormat::UYVY:
+		case VideoFormat::HDYC:
+			return PackedTo420<Row, LayoutUYVY, false, true>;
+		default:
+			return nullptr;
+		}
+	}
+
+	return nullptr;
+}
+
+/* ------------------------------------------------------------------------ */
+/* YUV to RGB
+ *
+ * Every kernel does the same 16-bit fixed point math, so they all give the
+ * same result as the scalar code here.  Samples are centred and scaled up by
+ * 1 << Shift (6 for 8-bit, 4 for 10-bit, which lines 10-bit up with 8-bit),
+ * multiplied by the 13-bit coefficients keeping the high 16 bits (pmulhw),
+ * summed, then rounded off from 3 fractional bits and clamped. */
+
+struct YUVRow {
+	const unsigned char *y;
+	const unsigned char *u;
+	const unsigned char *v;
+};
+
+static inline int MulHi(int a, int b)
+{
+	return (a * b) >> 16;
+}
+
+static inline int ClampByte(int val)
+{
+	return val < 0 ? 0 : (val > 255 ? 255 : val);
+}
+
+/* I420 (u, v) and YV12 (v, u) */
+template<bool Swap> struct SrcPlanar {
+	enum { Shift = 6, Scale = 1 };
+
+	static inline YUVRow Row(const ConvertFrame &f, int y)
+	{
+		YUVRow r;
+		r.y = f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		r.u = f.src[Swap ? 2 : 1] +
+		      (ptrdiff_t)(y / 2) * f.srcStride[Swap ? 2 : 1];
+		r.v = f.src[Swap ? 1 : 2] +
+		      (ptrdiff_t)(y / 2) * f.srcStride[Swap ? 1 : 2];
+		return r;
+	}
+
+	static inline void Pixel(const YUVRow &r, int x, int &y, int &u,
+				 int &v)
+	{
+		y = r.y[x];
+		u = r.u[x / 2];
+		v = r.v[x / 2];
+	}
+};
+
+struct SrcNV12 {
+	enum { Shift = 6, Scale = 1 };
+
+	static inline YUVRow Row(const ConvertFrame &f, int y)
+	{
+		YUVRow r;
+		r.y = f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		r.u = f.src[1] + (ptrdiff_t)(y / 2) * f.srcStride[1];
+		r.v = r.u + 1;
+		return r;
+	}
+
+	static inline void Pixel(const YUVRow &r, int x, int &y, int &u,
+				 int &v)
+	{
+		y = r.y[x];
+		u = r.u[x & ~1];
+		v = r.v[x & ~1];
+	}
+};
+
+template<class L> struct SrcPacked {
+	enum { Shift = 6, Scale = 1 };
+
+	static inline YUVRow Row(const ConvertFrame &f, int y)
+	{
+		YUVRow r;
+		r.y = f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		r.u = r.y;
+		r.v = r.y;
+		return r;
+	}
+
+	static inline void Pixel(const YUVRow &r, int x, int &y, int &u,
+				 int &v)
+	{
+		const unsigned char *p = r.y + (x & ~1) * 2;
+		y = p[L::Y + (x & 1) * 2];
+		u = p[L::U];
+		v = p[L::V];
+	}
+};
+
+/* 10-bit samples in the high bits of 16-bit words */
+struct SrcP010 {
+	enum { Shift = 4, Scale = 4 };
+
+	static inline YUVRow Row(const ConvertFrame &f, int y)
+	{
+		YUVRow r;
+		r.y = f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		r.u = f.src[1] + (ptrdiff_t)(y / 2) * f.srcStride[1];
+		r.v = r.u + 2;
+		return r;
+	}
+
+	static inline int Sample(const unsigned char *p)
+	{
+		return (p[0] | (p[1] << 8)) >> 6;
+	}
+
+	static inline void Pixel(const YUVRow &r, int x, int &y, int &u,
+				 int &v)
+	{
+		y = Sample(r.y + x * 2);
+		u = Sample(r.u + (x & ~1) * 2);
+		v = Sample(r.v + (x & ~1) * 2);
+	}
+};
+
+/* byte positions of a 32-bit RGB pixel; alpha is always last */
+struct LayoutBGRA {
+	enum { R = 2, G = 1, B = 0 };
+};
+
+struct LayoutRGBA {
+	enum { R = 0, G = 1, B = 2 };
+};
+
+template<class Src, class Dst>
+static inline void YUVToRGBScalar(const YUVRow &r, unsigned char *out, int x,
+				  int width, const YUVCoefficients &c)
+{
+	const int yOffset = c.yOffset * Src::Scale;
+	const int center = 128 * Src::Scale;
+	const int scale = 1 << Src::Shift;
+
+	for (; x < width; x++) {
+		int y, u, v;
+		Src::Pixel(r, x, y, u, v);
+
+		int yt = MulHi((y - yOffset) * scale, c.y);
+		u = (u - center) * scale;
+		v = (v - center) * scale;
+
+		unsigned char *p = out + x * 4;
+		p[Dst::R] = (unsigned char)ClampByte(
+			(yt + MulHi(v, c.rv) + 4) >> 3);
+		p[Dst::G] = (unsigned char)ClampByte(
+			(yt + MulHi(u, c.gu) + MulHi(v, c.gv) + 4) >> 3);
+		p[Dst::B] = (unsigned char)ClampByte(
+			(yt + MulHi(u, c.bu) + 4) >> 3);
+		p[3] = 255;
+	}
+}
+
+/* row functions convert as many leading pixels of a row as they can and
+ * return how many they did */
+namespace {
+template<class Src, class Dst> struct YUVRowNone {
+	static inline int Run(const YUVRow &, unsigned char *, int,
+			      const YUVCoefficients &)
+	{
+		return 0;
+	}
+};
+}
+
+template<template<class, class> class Row, class Src, class Dst>
+static void YUVToRGB(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y++) {
+		YUVRow r = Src::Row(f, y);
+		unsigned char *out = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+
+		int x = Row<Src, Dst>::Run(r, out, f.width, f.toRGB);
+		YUVToRGBScalar<Src, Dst>(r, out, x, f.width, f.toRGB);
+	}
+}
+
+template<template<class, class> class Row, class Dst>
+static ConvertKernel SelectYUVToRGBSource(VideoFormat from)
+{
+	switch (from) {
+	case VideoFormat::I420:
+		return YUVToRGB<Row, SrcPlanar<false>, Dst>;
+	case VideoFormat::YV12:
+		return YUVToRGB<Row, SrcPlanar<true>, Dst>;
+	case VideoFormat::NV12:
+		return YUVToRGB<Row, SrcNV12, Dst>;
+	case VideoFormat::YUY2:
+		return YUVToRGB<Row, SrcPacked<LayoutYUY2>, Dst>;
+	case VideoFormat::YVYU:
+		return YUVToRGB<Row, SrcPacked<LayoutYVYU>, Dst>;
+	case VideoFormat::UYVY:
+	case VideoFormat::HDYC:
+		return YUVToRGB<Row, SrcPacked<LayoutUYVY>, Dst>;
+	case VideoFormat::P010:
+		return YUVToRGB<Row, SrcP010, Dst>;
+	default:
+		return nullptr;
+	}
+}
+
+template<template<class, class> class Row>
+static ConvertKernel SelectYUVToRGB(VideoFormat from, VideoFormat to)
+{
+	switch (to) {
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		return SelectYUVToRGBSource<Row, LayoutBGRA>(from);
+	case VideoFormat::RGBA:
+		return SelectYUVToRGBSource<Row, LayoutRGBA>(from);
+	default:
+		return nullptr;
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+/* RGB to 4:2:0
+ *
+ * Luma is the 15-bit weighted sum of each pixel, chroma the weighted sum of
+ * each 2x2 block (so 17 fractional bits), both rounded to nearest.  Again
+ * every kernel matches the scalar code exactly. */
+
+#define RGB_LUMA_SHIFT 15
+#define RGB_CHROMA_SHIFT 17
+
+static inline int RGBToLuma(int r, int g, int b, const RGBCoefficients &c)
+{
+	return ClampByte((c.yr * r + c.yg * g + c.yb * b +
+			  (c.yOffset << RGB_LUMA_SHIFT) +
+			  (1 << (RGB_LUMA_SHIFT - 1))) >>
+			 RGB_LUMA_SHIFT);
+}
+
+template<class L>
+static inline int RGBToLuma(const unsigned char *p, const RGBCoefficients &c)
+{
+	return RGBToLuma(p[L::R], p[L::G], p[L::B], c);
+}
+
+static inline int RGBToChroma(int r, int g, int b, int cr, int cg, int cb)
+{
+	return ClampByte((cr * r + cg * g + cb * b + (128 << RGB_CHROMA_SHIFT) +
+			  (1 << (RGB_CHROMA_SHIFT - 1))) >>
+			 RGB_CHROMA_SHIFT);
+}
+
+/* a last odd column is paired with itself, like a last odd row */
+template<class L, bool NV12>
+static inline void RGBRowsTo420Scalar(const unsigned char *s0,
+				      const unsigned char *s1,
+				      unsigned char *y0, unsigned char *y1,
+				      unsigned char *u, unsigned char *v,
+				      int x, int width,
+				      const RGBCoefficients &c)
+{
+	for (; x < width; x += 2) {
+		const unsigned char *p0 = s0 + x * 4;
+		const unsigned char *p1 = s1 + x * 4;
+		const bool pair = x + 1 < width;
+		const unsigned char *q0 = pair ? p0 + 4 : p0;
+		const unsigned char *q1 = pair ? p1 + 4 : p1;
+
+		y0[x] = (unsigned char)RGBToLuma<L>(p0, c);
+		y1[x] = (unsigned char)RGBToLuma<L>(p1, c);
+		if (pair) {
+			y0[x + 1] = (unsigned char)RGBToLuma<L>(q0, c);
+			y1[x + 1] = (unsigned char)RGBToLuma<L>(q1, c);
+		}
+
+		int r = p0[L::R] + q0[L::R] + p1[L::R] + q1[L::R];
+		int g = p0[L::G] + q0[L::G] + p1[L::G] + q1[L::G];
+		int b = p0[L::B] + q0[L::B] + p1[L::B] + q1[L::B];
+
+		unsigned char cu = (unsigned char)RGBToChroma(r, g, b, c.ur,
+							      c.ug, c.ub);
+		unsigned char cv = (unsigned char)RGBToChroma(r, g, b, c.vr,
+							      c.vg, c.vb);
+
+		if (NV12) {
+			u[x] = cu;
+			u[x + 1] = cv;
+		} else {
+			u[x / 2] = cu;
+			v[x / 2] = cv;
+		}
+	}
+}
+
+namespace {
+template<class L, bool NV12> struct RGBRowNone {
+	static inline int Run(const unsigned char *, const unsigned char *,
+			      unsigned char *, unsigned char *, unsigned char *,
+			      unsigned char *, int, const RGBCoefficients &)
+	{
+		return 0;
+	}
+};
+}
+
+template<template<class, bool> class Row, class L, bool NV12, bool SwapUV>
+static void RGBTo420(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y += 2) {
+		const unsigned char *s0 =
+			f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		unsigned char *y0 = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+		unsigned char *u, *v;
+		ChromaRows<NV12, SwapUV>(f, y, u, v);
+
+		bool pair = y + 1 < f.height;
+		const unsigned char *s1 = pair ? s0 + f.srcStride[0] : s0;
+		unsigned char *y1 = pair ? y0 + f.dstStride[0] : y0;
+
+		int x = Row<L, NV12>::Run(s0, s1, y0, y1, u, v, f.width,
+					  f.toYUV);
+		RGBRowsTo420Scalar<L, NV12>(s0, s1, y0, y1, u, v, x, f.width,
+					    f.toYUV);
+	}
+}
+
+template<template<class, bool> class Row, class L>
+static ConvertKernel SelectRGBTo420Dest(VideoFormat to)
+{
+	switch (to) {
+	case VideoFormat::NV12:
+		return RGBTo420<Row, L, true, false>;
+	case VideoFormat::I420:
+		return RGBTo420<Row, L, false, false>;
+	case VideoFormat::YV12:
+		return RGBTo420<Row, L, false, true>;
+	default:
+		return nullptr;
+	}
+}
+
+template<template<class, bool> class Row>
+static ConvertKernel SelectRGBTo420(VideoFormat from, VideoFormat to)
+{
+	switch (from) {
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		return SelectRGBTo420Dest<Row, LayoutBGRA>(to);
+	case VideoFormat::RGBA:
+		return SelectRGBTo420Dest<Row, LayoutRGBA>(to);
+	default:
+		return nullptr;
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+/* NV12 to I420/YV12: luma is copied, chroma de-interleaved */
+
+namespace {
+struct SplitUVNone {
+	static inline int Run(const unsigned char *, unsigned char *,
+			      unsigned char *, int)
+	{
+		return 0;
+	}
+};
+}
+
+template<class Row, bool SwapUV>
+static void NV12To420(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	const int halfWidth = (f.width + 1) / 2;
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		memcpy(f.dst[0] + (ptrdiff_t)y * f.dstStride[0],
+		       f.src[0] + (ptrdiff_t)y * f.srcStride[0], f.width);
+
+		if (y & 1)
+			continue;
+
+		const unsigned char *uv =
+			f.src[1] + (ptrdiff_t)(y / 2) * f.srcStride[1];
+		unsigned char *u, *v;
+		ChromaRows<false, SwapUV>(f, y, u, v);
+
+		for (int x = Row::Run(uv, u, v, halfWidth); x < halfWidth;
+		     x++) {
+			u[x] = uv[x * 2];
+			v[x] = uv[x * 2 + 1];
+		}
+	}
+}
+
+template<class Row>
+static ConvertKernel SelectSplitUV(VideoFormat from, VideoFormat to)
+{
+	if (from != VideoFormat::NV12)
+		return nullptr;
+
+	if (to == VideoFormat::I420)
+		return NV12To420<Row, false>;
+	else if (to == VideoFormat::YV12)
+		return NV12To420<Row, true>;
+
+	return nullptr;
+}
+
+/* ------------------------------------------------------------------------ */
+/* RGB24 (B, G, R bytes) to 32-bit RGB with opaque alpha */
+
+template<class Dst>
+static inline void ExpandRGB24Scalar(const unsigned char *src,
+				     unsigned char *dst, int x, int width)
+{
+	for (; x < width; x++) {
+		const unsigned char *s = src + x * 3;
+		unsigned char *d = dst + x * 4;
+
+		d[Dst::R] = s[2];
+		d[Dst::G] = s[1];
+		d[Dst::B] = s[0];
+		d[3] = 255;
+	}
+}
+
+/* row functions expand as many leading pixels as they can without reading
+ * past the end of the row, and return how many they did */
+namespace {
+template<class Dst> struct ExpandRowNone {
+	static inline int Run(const unsigned char *, unsigned char *, int)
+	{
+		return 0;
+	}
+};
+}
+
+template<template<class> class Row, class Dst>
+static void ExpandRGB24(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y++) {
+		const unsigned char *src =
+			f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		unsigned char *dst = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+
+		int x = Row<Dst>::Run(src, dst, f.width);
+		ExpandRGB24Scalar<Dst>(src, dst, x, f.width);
+	}
+}
+
+template<template<class> class Row>
+static ConvertKernel SelectExpandRGB24(VideoFormat from, VideoFormat to)
+{
+	if (from != VideoFormat::RGB24)
+		return nullptr;
+
+	switch (to) {
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		return ExpandRGB24<Row, LayoutBGRA>;
+	case VideoFormat::RGBA:
+		return ExpandRGB24<Row, LayoutRGBA>;
+	default:
+		return nullptr;
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+/* P010 to NV12
+ *
+ * Both planes are 16-bit words with the sample in the high bits, so each
+ * word is narrowed to its high byte after adding a bias: 128 to round, or a
+ * 4x4 ordered dither with the same mean.  The addition saturates (paddusw),
+ * which keeps white from wrapping to black. */
+
+static const unsigned char DitherMatrix[4][4] = {
+	{0, 8, 2, 10},
+	{12, 4, 14, 6},
+	{3, 11, 1, 9},
+	{15, 7, 13, 5},
+};
+
+/* bias of each word of a row, repeating every four words */
+static inline void NarrowBias(bool dither, int row, uint16_t bias[4])
+{
+	for (int i = 0; i < 4; i++)
+		bias[i] = dither ? (uint16_t)(DitherMatrix[row & 3][i] * 16 + 8)
+				 : 128;
+}
+
+static inline void NarrowRowScalar(const unsigned char *src,
+				   unsigned char *dst, int x, int count,
+				   const uint16_t bias[4])
+{
+	for (; x < count; x++) {
+		int val = (src[x * 2] | (src[x * 2 + 1] << 8)) + bias[x & 3];
+		dst[x] = (unsigned char)((val > 0xFFFF ? 0xFFFF : val) >> 8);
+	}
+}
+
+/* row functions narrow as many leading words as they can (always a multiple
+ * of four, so the bias pattern lines up) and return how many they did */
+namespace {
+struct NarrowRowNone {
+	static inline int Run(const unsigned char *, unsigned char *, int,
+			      const uint16_t *)
+	{
+		return 0;
+	}
+};
+}
+
+template<class Row>
+static void P010ToNV12(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	const int chromaWords = (f.width + 1) & ~1;
+	uint16_t bias[4];
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		const unsigned char *src =
+			f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		unsigned char *dst = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+
+		NarrowBias(f.dither, y, bias);
+		int x = Row::Run(src, dst, f.width, bias);
+		NarrowRowScalar(src, dst, x, f.width, bias);
+
+		if (y & 1)
+			continue;
+
+		src = f.src[1] + (ptrdiff_t)(y / 2) * f.srcStride[1];
+		dst = f.dst[1] + (ptrdiff_t)(y / 2) * f.dstStride[1];
+
+		NarrowBias(f.dither, y / 2, bias);
+		x = Row::Run(src, dst, chromaWords, bias);
+		NarrowRowScalar(src, dst, x, chromaWords, bias);
+	}
+}
+
+template<class Row>
+static ConvertKernel SelectNarrow(VideoFormat from, VideoFormat to)
+{
+	if (from == VideoFormat::P010 && to == VideoFormat::NV12)
+		return P010ToNV12<Row>;
+
+	return nullptr;
+}
+
+/* ------------------------------------------------------------------------ */
+/* P010 HDR to NV12 SDR
+ *
+ * Each pixel goes to 10-bit non-linear RGB, through a table to tone mapped
+ * linear light, to BT.709 primaries, and through a second table to 8-bit
+ * BT.709 RGB, which is then converted to YUV like RGB input.  It is all
+ * 32-bit integer math, so SIMD kernels that gather the table entries match
+ * this exactly. */
+
+#define TONEMAP_SHIFT 12
+#define TONEMAP_MAX ((1 << TONEMAP_SHIFT) - 1)
+
+static inline int ClampInt(int val, int max)
+{
+	return val < 0 ? 0 : (val > max ? max : val);
+}
+
+static inline void TonemapPixel(const TonemapTables &t,
+				const YUVCoefficients &c, int y, int u, int v,
+				int &r, int &g, int &b)
+{
+	const int32_t *m = t.gamut;
+	const int round = 1 << (TONEMAP_SHIFT - 1);
+
+	int yt = (y - c.yOffset * 4) * c.y + 4096;
+	u -= 512;
+	v -= 512;
+
+	int lr = t.toLinear[ClampInt((yt + v * c.rv) >> 13, 1023)];
+	int lg = t.toLinear[ClampInt((yt + u * c.gu + v * c.gv) >> 13, 1023)];
+	int lb = t.toLinear[ClampInt((yt + u * c.bu) >> 13, 1023)];
+
+	r = t.toGamma[ClampInt((m[0] * lr + m[1] * lg + m[2] * lb + round) >>
+				       TONEMAP_SHIFT,
+			       TONEMAP_MAX)];
+	g = t.toGamma[ClampInt((m[3] * lr + m[4] * lg + m[5] * lb + round) >>
+				       TONEMAP_SHIFT,
+			       TONEMAP_MAX)];
+	b = t.toGamma[ClampInt((m[6] * lr + m[7] * lg + m[8] * lb + round) >>
+				       TONEMAP_SHIFT,
+			       TONEMAP_MAX)];
+}
+
+/* a last odd column is paired with itself, like a last odd row */
+static inline void TonemapRowsScalar(const unsigned char *s0,
+				     const unsigned char *s1,
+				     const unsigned char *uv,
+				     unsigned char *y0, unsigned char *y1,
+				     unsigned char *out, int x, int width,
+				     const ConvertFrame &f)
+{
+	const TonemapTables &t = *f.tonemap;
+	const RGBCoefficients &c = f.toYUV;
+
+	for (; x < width; x += 2) {
+		const int x1 = x + 1 < width ? x + 1 : x;
+		const int u = SrcP010::Sample(uv + x * 2);
+		const int v = SrcP010::Sample(uv + x * 2 + 2);
+		int r[4], g[4], b[4];
+
+		TonemapPixel(t, f.toRGB, SrcP010::Sample(s0 + x * 2), u, v,
+			     r[0], g[0], b[0]);
+		TonemapPixel(t, f.toRGB, SrcP010::Sample(s0 + x1 * 2), u, v,
+			     r[1], g[1], b[1]);
+		TonemapPixel(t, f.toRGB, SrcP010::Sample(s1 + x * 2), u, v,
+			     r[2], g[2], b[2]);
+		TonemapPixel(t, f.toRGB, SrcP010::Sample(s1 + x1 * 2), u, v,
+			     r[3], g[3], b[3]);
+
+		y0[x] = (unsigned char)RGBToLuma(r[0], g[0], b[0], c);
+		y0[x1] = (unsigned char)RGBToLuma(r[1], g[1], b[1], c);
+		y1[x] = (unsigned char)RGBToLuma(r[2], g[2], b[2], c);
+		y1[x1] = (unsigned char)RGBToLuma(r[3], g[3], b[3], c);
+
+		int rs = r[0] + r[1] + r[2] + r[3];
+		int gs = g[0] + g[1] + g[2] + g[3];
+		int bs = b[0] + b[1] + b[2] + b[3];
+
+		out[x] = (unsigned char)RGBToChroma(rs, gs, bs, c.ur, c.ug,
+						    c.ub);
+		out[x + 1] = (unsigned char)RGBToChroma(rs, gs, bs, c.vr, c.vg,
+							c.vb);
+	}
+}
+
+namespace {
+struct TonemapRowNone {
+	static inline int Run(const unsigned char *, const unsigned char *,
+			      const unsigned char *, unsigned char *,
+			      unsigned char *, unsigned char *, int,
+			      const ConvertFrame &)
+	{
+		return 0;
+	}
+};
+}
+
+template<class Row>
+static void TonemapP010(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y += 2) {
+		const unsigned char *s0 =
+			f.src[0] + (ptrdiff_t)y * f.srcStride[0];
+		const unsigned char *uv =
+			f.src[1] + (ptrdiff_t)(y / 2) * f.srcStride[1];
+		unsigned char *y0 = f.dst[0] + (ptrdiff_t)y * f.dstStride[0];
+		unsigned char *out =
+			f.dst[1] + (ptrdiff_t)(y / 2) * f.dstStride[1];
+
+		bool pair = y + 1 < f.height;
+		const unsigned char *s1 = pair ? s0 + f.srcStride[0] : s0;
+		unsigned char *y1 = pair ? y0 + f.dstStride[0] : y0;
+
+		int x = Row::Run(s0, s1, uv, y0, y1, out, f.width, f);
+		TonemapRowsScalar(s0, s1, uv, y0, y1, out, x, f.width, f);
+	}
+}
+
+template<class Row>
+static ConvertKernel SelectTonemap(VideoFormat from, VideoFormat to)
+{
+	if (from == VideoFormat::P010 && to == VideoFormat::NV12)
+		return TonemapP010<Row>;
+
+	return nullptr;
+}
+
+/* side of the blocks planes are transposed in, small enough for a block's
+ * source and destination rows to stay in the L1 cache together */
+#define ROTATE_BLOCK 32
+
+/* rotation tiles move elements of Size bytes.  Transpose turns an N x N
+ * block around its diagonal, Reverse fills as many leading elements of a
+ * row as it can with the source row's elements in reverse order, and
+ * MergePairs combines two 4:2:2 rows into the 4-byte elements described at
+ * RotatePacked.  Reverse and MergePairs return how many they did. */
+namespace {
+template<int Size> struct RotateTileNone {
+	enum { N = 1 };
+
+	static inline void Transpose(const unsigned char *src, int,
+				     unsigned char *dst, int)
+	{
+		memcpy(dst, src, Size);
+	}
+
+	static inline int Reverse(const unsigned char *, unsigned char *, int)
+	{
+		return 0;
+	}
+
+	template<class L>
+	static inline int MergePairs(const unsigned char *,
+				     const unsigned char *, unsigned char *,
+				     int)
+	{
+		return 0;
+	}
+};
+}
+
+/* dst(x, y) = src(y, x) for a plane of width x height elements */
+template<class T, int Size>
+static void TransposePlane(const unsigned char *src, int srcStride,
+			   unsigned char *dst, int dstStride, int width,
+			   int height)
+{
+	for (int by = 0; by < height; by += ROTATE_BLOCK) {
+		const int bh = height - by < ROTATE_BLOCK ? height - by
+							  : ROTATE_BLOCK;
+		const int fullH = bh - bh % T::N;
+
+		for (int bx = 0; bx < width; bx += ROTATE_BLOCK) {
+			const int bw = width - bx < ROTATE_BLOCK ? width - bx
+								 : ROTATE_BLOCK;
+			const int fullW = bw - bw % T::N;
+			const unsigned char *s =
+				src + (ptrdiff_t)by * srcStride + bx * Size;
+			unsigned char *d = dst + (ptrdiff_t)bx * dstStride +
+					   by * Size;
+
+			for (int y = 0; y < fullH; y += T::N) {
+				for (int x = 0; x < fullW; x += T::N)
+					T::Transpose(
+						s + (ptrdiff_t)y * srcStride +
+							x * Size,
+						srcStride,
+						d + (ptrdiff_t)x * dstStride +
+							y * Size,
+						dstStride);
+			}
+
+			/* the edges of the block that don't fill a tile */
+			for (int y = 0; y < bh; y++) {
+				for (int x = y < fullH ? fullW : 0; x < bw;
+				     x++)
+					memcpy(d + (ptrdiff_t)x * dstStride +
+						       y * Size,
+					       s + (ptrdiff_t)y * srcStride +
+						       x * Size,
+					       Size);
+			}
+		}
+	}
+}
+
+template<class T, int Size>
+static inline void ReverseRow(const unsigned char *src, unsigned char *dst,
+			      int width)
+{
+	for (int x = T::Reverse(src, dst, width); x < width; x++)
+		memcpy(dst + x * Size, src + (width - 1 - x) * Size, Size);
+}
+
+/*
+ * Rotates rows [rowBegin, rowEnd) of a plane clockwise into dst, which is
+ * the plane of the rotated frame.  src holds the plane's rows from row top
+ * on.  90 and 270 degrees are transposes of the rows read bottom-up or
+ * written bottom-up, 180 reverses the rows and their order.
+ */
+template<template<int> class T, int Size, int Degrees>
+static void RotatePlane(const unsigned char *src, int srcStride,
+			unsigned char *dst, int dstStride, int width,
+			int height, int top, int rowBegin, int rowEnd)
+{
+	typedef T<Size> Tile;
+	const unsigned char *s = src + (ptrdiff_t)(rowBegin - top) * srcStride;
+	const int rows = rowEnd - rowBegin;
+
+	if (Degrees == 90) {
+		/* the last row becomes the first column */
+		TransposePlane<Tile, Size>(
+			s + (ptrdiff_t)(rows - 1) * srcStride, -srcStride,
+			dst + (height - rowEnd) * Size, dstStride, width,
+			rows);
+	} else if (Degrees == 270) {
+		/* the first row becomes the first column, read upwards */
+		TransposePlane<Tile, Size>(
+			s, srcStride,
+			dst + (ptrdiff_t)(width - 1) * dstStride +
+				rowBegin * Size,
+			-dstStride, width, rows);
+	} else {
+		for (int y = 0; y < rows; y++)
+			ReverseRow<Tile, Size>(
+				s + (ptrdiff_t)y * srcStride,
+				dst + (ptrdiff_t)(height - 1 - rowBegin - y) *
+					      dstStride,
+				width);
+	}
+}
+
+/* planar formats; 4:2:0 chroma rows are half of the luma rows */
+template<template<int> class T, int LumaSize, int ChromaSize, int Planes,
+	 int Degrees>
+static void RotatePlanar(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	RotatePlane<T, LumaSize, Degrees>(f.src[0], f.srcStride[0], f.dst[0],
+					  f.dstStride[0], f.width, f.height,
+					  f.srcTop, rowBegin, rowEnd);
+
+	const int halfWidth = (f.width + 1) / 2;
+	const int halfHeight = (f.height + 1) / 2;
+
+	for (int i = 1; i < Planes; i++)
+		RotatePlane<T, ChromaSize, Degrees>(
+			f.src[i], f.srcStride[i], f.dst[i], f.dstStride[i],
+			halfWidth, halfHeight, f.srcTop / 2, rowBegin / 2,
+			(rowEnd + 1) / 2);
+}
+
+template<class L>
+static inline void MergePairsScalar(const unsigned char *a,
+				    const unsigned char *b, unsigned char *dst,
+				    int x, int width)
+{
+	for (; x < width; x++) {
+		const unsigned char *pa = a + (x & ~1) * 2;
+		const unsigned char *pb = b + (x & ~1) * 2;
+		const int luma = L::Y + (x & 1) * 2;
+		unsigned char *out = dst + x * 4;
+
+		out[L::Y] = pa[luma];
+		out[L::Y + 2] = pb[luma];
+		out[L::U] = (unsigned char)((pa[L::U] + pb[L::U] + 1) >> 1);
+		out[L::V] = (unsigned char)((pa[L::V] + pb[L::V] + 1) >> 1);
+	}
+}
+
+/*
+ * Packed 4:2:2, with even dimensions.  Turned 90 degrees, each column of the
+ * source becomes a row whose macropixels pair up two source rows, so row
+ * pairs are first merged into one macropixel per source pixel (the chroma
+ * averaged, like PackedTo420) and those are transposed as 4-byte elements.
+ * Turned 180 degrees, the macropixels are reversed and their luma swapped.
+ */
+template<template<int> class T, class L, int Degrees>
+static void RotatePacked(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	typedef T<4> Tile;
+	const int halfWidth = f.width / 2;
+
+	if (Degrees == 180) {
+		for (int y = rowBegin; y < rowEnd; y++) {
+			const unsigned char *s =
+				f.src[0] +
+				(ptrdiff_t)(y - f.srcTop) * f.srcStride[0];
+			unsigned char *d =
+				f.dst[0] +
+				(ptrdiff_t)(f.height - 1 - y) * f.dstStride[0];
+
+			ReverseRow<Tile, 4>(s, d, halfWidth);
+
+			for (int x = 0; x < halfWidth; x++) {
+				unsigned char *p = d + x * 4;
+				unsigned char luma = p[L::Y];
+				p[L::Y] = p[L::Y + 2];
+				p[L::Y + 2] = luma;
+			}
+		}
+		return;
+	}
+
+	/* merged pairs of ROTATE_BLOCK rows, a block of columns at a time */
+	unsigned char merged[ROTATE_BLOCK / 2][ROTATE_BLOCK * 4];
+
+	for (int by = rowBegin; by < rowEnd; by += ROTATE_BLOCK) {
+		const int bh = rowEnd - by < ROTATE_BLOCK ? rowEnd - by
+							  : ROTATE_BLOCK;
+		const int pairs = bh / 2;
+
+		for (int bx = 0; bx < f.width; bx += ROTATE_BLOCK) {
+			const int bw = f.width - bx < ROTATE_BLOCK
+					       ? f.width - bx
+					       : ROTATE_BLOCK;
+
+			for (int i = 0; i < pairs; i++) {
+				/* clockwise, the bottom row of a pair comes
+				 * first in the rotated macropixel */
+				int ya = Degrees == 90 ? by + bh - 1 - i * 2
+						       : by + i * 2;
+				int yb = Degrees == 90 ? ya - 1 : ya + 1;
+				const unsigned char *a =
+					f.src[0] +
+					(ptrdiff_t)(ya - f.srcTop) *
+						f.srcStride[0] +
+					bx * 2;
+				const unsigned char *b =
+					f.src[0] +
+					(ptrdiff_t)(yb - f.srcTop) *
+						f.srcStride[0] +
+					bx * 2;
+
+				int x = Tile::template MergePairs<L>(
+					a, b, merged[i], bw);
+				MergePairsScalar<L>(a, b, merged[i], x, bw);
+			}
+
+			if (Degrees == 90) {
+				/* merged rows run upwards from the band's
+				 * bottom, which is f.height - by - bh columns
+				 * from the left */
+				TransposePlane<Tile, 4>(
+					merged[0], ROTATE_BLOCK * 4,
+					f.dst[0] +
+						(ptrdiff_t)bx * f.dstStride[0] +
+						(f.height - by - bh) * 2,
+					f.dstStride[0], bw, pairs);
+			} else {
+				TransposePlane<Tile, 4>(
+					merged[0], ROTATE_BLOCK * 4,
+					f.dst[0] +
+						(ptrdiff_t)(f.width - 1 - bx) *
+							f.dstStride[0] +
+						by * 2,
+					-f.dstStride[0], bw, pairs);
+			}
+		}
+	}
+}
+
+template<template<int> class T, int Degrees>
+static ConvertKernel SelectRotateDegrees(VideoFormat format)
+{
+	switch (format) {
+	case VideoFormat::I420:
+	case VideoFormat::YV12:
+		return RotatePlanar<T, 1, 1, 3, Degrees>;
+	case VideoFormat::NV12:
+		return RotatePlanar<T, 1, 2, 2, Degrees>;
+	case VideoFormat::P010:
+		return RotatePlanar<T, 2, 4, 2, Degrees>;
+	case VideoFormat::Y800:
+		return RotatePlanar<T, 1, 1, 1, Degrees>;
+	case VideoFormat::ARGB:
+	case VideoFormat::XRGB:
+	case VideoFormat::RGBA:
+		return RotatePlanar<T, 4, 4, 1, Degrees>;
+	case VideoFormat::YUY2:
+		return RotatePacked<T, LayoutYUY2, Degrees>;
+	case VideoFormat::YVYU:
+		return RotatePacked<T, LayoutYVYU, Degrees>;
+	case VideoFormat::UYVY:
+	case VideoFormat::HDYC:
+		return RotatePacked<T, LayoutUYVY, Degrees>;
+	default:
+		return nullptr;
+	}
+}
+
+template<template<int> class T>
+static ConvertKernel SelectRotate(VideoFormat format, int degrees)
+{
+	switch (degrees) {
+	case 90:
+		return SelectRotateDegrees<T, 90>(format);
+	case 180:
+		return SelectRotateDegrees<T, 180>(format);
+	case 270:
+		return SelectRotateDegrees<T, 270>(format);
+	default:
+		return nullptr;
+	}
+}
+
+/* bilinear scaling samples at pixel centres, with 8-bit weights */
+static inline int ScaleSource(int pos, int srcSize, int dstSize, int &weight)
+{
+	long long fixed = (((long long)(pos * 2 + 1) * srcSize) << 16) /
+				  (dstSize * 2) -
+			  32768;
+	int index = fixed < 0 ? 0 : (int)(fixed >> 16);
+
+	weight = fixed < 0 ? 0 : (int)((fixed >> 8) & 255);
+	if (index >= srcSize - 1) {
+		index = srcSize - 1;
+		weight = 0;
+	}
+	return index;
+}
+
+/*
+ * Source rows [first, last) that destination rows [rowBegin, rowEnd) are
+ * interpolated from, covering the chroma rows of 4:2:0 as well.  first is
+ * rounded down to a multiple of 4 so that the dither matrix lines up.
+ */
+static inline void ScaleSourceRows(int rowBegin, int rowEnd, int srcHeight,
+				   int height, bool halfChroma, int &first,
+				   int &last)
+{
+	int weight;
+
+	first = ScaleSource(rowBegin, srcHeight, height, weight);
+	last = ScaleSource(rowEnd - 1, srcHeight, height, weight) + 2;
+
+	if (halfChroma) {
+		const int srcHalf = (srcHeight + 1) / 2;
+		const int half = (height + 1) / 2;
+		int cFirst = ScaleSource(rowBegin / 2, srcHalf, half, weight);
+		int cLast = ScaleSource((rowEnd + 1) / 2 - 1, srcHalf, half,
+					weight) +
+			    2;
+
+		if (cFirst * 2 < first)
+			first = cFirst * 2;
+		if (cLast * 2 > last)
+			last = cLast * 2;
+	}
+
+	first &= ~3;
+	last = (last + 1) & ~1;
+	if (last > srcHeight)
+		last = srcHeight;
+}
+
+/*
+ * Scales rows [rowBegin, rowEnd) of a plane of Channels interleaved samples
+ * of type T.  src and dst hold the rows from srcTop and dstTop on.  Each
+ * row is blended vertically first, in a loop simple enough for compilers
+ * to vectorize, then interpolated horizontally.
+ */
+template<class T, int Channels>
+static void ScalePlane(const unsigned char *src, int srcStride, int srcWidth,
+		       int srcHeight, int srcTop, unsigned char *dst,
+		       int dstStride, int width, int height, int dstTop,
+		       int rowBegin, int rowEnd)
+{
+	/* 8-bit samples blend in 16 bits, so twice as many fit a vector */
+	typedef typename std::conditional<sizeof(T) == 1, uint16_t,
+					  uint32_t>::type Blend;
+
+	std::vector<int> xs(width);
+	std::vector<int> xw(width);
+	std::vector<Blend> blend((size_t)srcWidth * Channels);
+
+	for (int x = 0; x < width; x++)
+		xs[x] = ScaleSource(x, srcWidth, width, xw[x]) * Channels;
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		int wy;
+		int sy = ScaleSource(y, srcHeight, height, wy);
+		const T *s0 = (const T *)(src +
+					  (ptrdiff_t)(sy - srcTop) * srcStride);
+		const T *s1 = wy ? (const T *)((const unsigned char *)s0 +
+					       srcStride)
+				 : s0;
+
+		const Blend w0 = (Blend)(256 - wy);
+		const Blend w1 = (Blend)wy;
+		Blend *b = blend.data();
+
+		for (int i = 0; i < srcWidth * Channels; i++)
+			b[i] = (Blend)(s0[i] * w0 + s1[i] * w1);
+
+		T *d = (T *)(dst + (ptrdiff_t)(y - dstTop) * dstStride);
+
+		for (int x = 0; x < width; x++) {
+			const Blend *p = b + xs[x];
+			const uint32_t w = (uint32_t)xw[x];
+			const int next = w ? Channels : 0;
+
+			for (int c = 0; c < Channels; c++)
+				d[x * Channels + c] =
+					(T)((p[c] * (256 - w) +
+					     (uint32_t)p[c + next] * w +
+					     32768) >>
+					    16);
+		}
+	}
+}
+
+/* planar formats and RGB; 4:2:0 chroma planes are half the size */
+template<class T, int LumaChannels, int ChromaChannels, int Planes>
+static void ScalePlanar(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	ScalePlane<T, LumaChannels>(f.src[0], f.srcStride[0], f.srcWidth,
+				    f.srcHeight, f.srcTop, f.dst[0],
+				    f.dstStride[0], f.width, f.height,
+				    f.dstTop, rowBegin, rowEnd);
+
+	for (int i = 1; i < Planes; i++)
+		ScalePlane<T, ChromaChannels>(
+			f.src[i], f.srcStride[i], (f.srcWidth + 1) / 2,
+			(f.srcHeight + 1) / 2, f.srcTop / 2, f.dst[i],
+			f.dstStride[i], (f.width + 1) / 2, (f.height + 1) / 2,
+			f.dstTop / 2, rowBegin / 2, (rowEnd + 1) / 2);
+}
+
+static inline ConvertKernel SelectScale(VideoFormat format)
+{
+	switch (format) {
+	case VideoFormat::I420:
+	case VideoFormat::YV12:
+		return ScalePlanar<uint8_t, 1, 1, 3>;
+	case VideoFormat::NV12:
+		return ScalePlanar<uint8_t, 1, 2, 2>;
+	case VideoFormat::P010:
+		return ScalePlanar<uint16_t, 1, 2, 2>;
+	case VideoFormat::Y800:
+		return ScalePlanar<uint8_t, 1, 1, 1>;
+	case VideoFormat::ARGB:
+	case VideoFormat::XRGB:
+	case VideoFormat::RGBA:
+		return ScalePlanar<uint8_t, 4, 4, 1>;
+	default:
+		return nullptr;
+	}
+}
+
+/* per-instruction-set kernels, nullptr if not supported or not built */
+ConvertKernel GetConvertKernelSSE2(VideoFormat from, VideoFormat to);
+ConvertKernel GetConvertKernelSSSE3(VideoFormat from, VideoFormat to);
+ConvertKernel GetConvertKernelAVX2(VideoFormat from, VideoFormat to);
+ConvertKernel GetConvertKernelAVX512(VideoFormat from, VideoFormat to);
+ConvertKernel GetConvertKernelNEON(VideoFormat from, VideoFormat to);
+ConvertKernel GetTonemapKernelAVX2(VideoFormat from, VideoFormat to);
+ConvertKernel GetRotateKernelSSE2(VideoFormat format, int degrees);
+ConvertKernel GetRotateKernelNEON(VideoFormat format, int degrees);
+
+}; /* namespace DShow */
@@ -0,0 +1,479 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+
+#if DSHOW_ARM64
+#include <arm_neon.h>
+
+namespace DShow {
+
+namespace {
+
+template<class L, bool NV12> struct PackedRowNEON {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width)
+	{
+		const int end = width & ~31;
+
+		for (int x = 0; x < end; x += 32) {
+			/* de-interleaves the four bytes of 16 macropixels */
+			uint8x16x4_t p0 = vld4q_u8(s0 + x * 2);
+			uint8x16x4_t p1 = vld4q_u8(s1 + x * 2);
+
+			uint8x16x2_t luma0 = {{p0.val[L::Y], p0.val[L::Y + 2]}};
+			uint8x16x2_t luma1 = {{p1.val[L::Y], p1.val[L::Y + 2]}};
+			vst2q_u8(y0 + x, luma0);
+			vst2q_u8(y1 + x, luma1);
+
+			uint8x16_t cu = vrhaddq_u8(p0.val[L::U], p1.val[L::U]);
+			uint8x16_t cv = vrhaddq_u8(p0.val[L::V], p1.val[L::V]);
+
+			if (NV12) {
+				uint8x16x2_t uv = {{cu, cv}};
+				vst2q_u8(u + x, uv);
+			} else {
+				vst1q_u8(u + x / 2, cu);
+				vst1q_u8(v + x / 2, cv);
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+static inline int16x8_t Widen(uint8x8_t val)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(val));
+}
+
+/* 16-bit luma and chroma samples of 16 pixels, as two halves */
+template<class Src> struct LoadNEON;
+
+template<bool Swap> struct LoadNEON<SrcPlanar<Swap>> {
+	static inline void Run(const YUVRow &r, int x, int16x8_t y[2],
+			       int16x8_t u[2], int16x8_t v[2])
+	{
+		uint8x16_t luma = vld1q_u8(r.y + x);
+		uint8x8_t cu = vld1_u8(r.u + x / 2);
+		uint8x8_t cv = vld1_u8(r.v + x / 2);
+		uint8x8x2_t du = vzip_u8(cu, cu);
+		uint8x8x2_t dv = vzip_u8(cv, cv);
+
+		y[0] = Widen(vget_low_u8(luma));
+		y[1] = Widen(vget_high_u8(luma));
+		u[0] = Widen(du.val[0]);
+		u[1] = Widen(du.val[1]);
+		v[0] = Widen(dv.val[0]);
+		v[1] = Widen(dv.val[1]);
+	}
+};
+
+template<> struct LoadNEON<SrcNV12> {
+	static inline void Run(const YUVRow &r, int x, int16x8_t y[2],
+			       int16x8_t u[2], int16x8_t v[2])
+	{
+		uint8x16_t luma = vld1q_u8(r.y + x);
+		uint8x8x2_t uv = vld2_u8(r.u + x);
+		uint8x8x2_t du = vzip_u8(uv.val[0], uv.val[0]);
+		uint8x8x2_t dv = vzip_u8(uv.val[1], uv.val[1]);
+
+		y[0] = Widen(vget_low_u8(luma));
+		y[1] = Widen(vget_high_u8(luma));
+		u[0] = Widen(du.val[0]);
+		u[1] = Widen(du.val[1]);
+		v[0] = Widen(dv.val[0]);
+		v[1] = Widen(dv.val[1]);
+	}
+};
+
+template<class L> struct LoadNEON<SrcPacked<L>> {
+	static inline void Run(const YUVRow &r, int x, int16x8_t y[2],
+			       int16x8_t u[2], int16x8_t v[2])
+	{
+		/* de-interleaves the four bytes of 8 macropixels */
+		uint8x8x4_t p = vld4_u8(r.y + x * 2);
+		uint8x8x2_t luma = vzip_u8(p.val[L::Y], p.val[L::Y + 2]);
+		uint8x8x2_t du = vzip_u8(p.val[L::U], p.val[L::U]);
+		uint8x8x2_t dv = vzip_u8(p.val[L::V], p.val[L::V]);
+
+		y[0] = Widen(luma.val[0]);
+		y[1] = Widen(luma.val[1]);
+		u[0] = Widen(du.val[0]);
+		u[1] = Widen(du.val[1]);
+		v[0] = Widen(dv.val[0]);
+		v[1] = Widen(dv.val[1]);
+	}
+};
+
+template<> struct LoadNEON<SrcP010> {
+	static inline void Run(const YUVRow &r, int x, int16x8_t y[2],
+			       int16x8_t u[2], int16x8_t v[2])
+	{
+		const uint16_t *luma = (const uint16_t *)r.y + x;
+		uint16x8x2_t uv = vld2q_u16((const uint16_t *)r.u + x);
+		uint16x8_t cu = vshrq_n_u16(uv.val[0], 6);
+		uint16x8_t cv = vshrq_n_u16(uv.val[1], 6);
+		uint16x8x2_t du = vzipq_u16(cu, cu);
+		uint16x8x2_t dv = vzipq_u16(cv, cv);
+
+		y[0] = vreinterpretq_s16_u16(vshrq_n_u16(vld1q_u16(luma), 6));
+		y[1] = vreinterpretq_s16_u16(
+			vshrq_n_u16(vld1q_u16(luma + 8), 6));
+		u[0] = vreinterpretq_s16_u16(du.val[0]);
+		u[1] = vreinterpretq_s16_u16(du.val[1]);
+		v[0] = vreinterpretq_s16_u16(dv.val[0]);
+		v[1] = vreinterpretq_s16_u16(dv.val[1]);
+	}
+};
+
+/* high 16 bits of the product, like pmulhw */
+static inline int16x8_t MulHi(int16x8_t a, int16_t c)
+{
+	return vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(a), c), 16),
+			    vshrn_n_s32(vmull_n_s16(vget_high_s16(a), c), 16));
+}
+
+template<class Src, class Dst> struct YUVRowNEON {
+	static int Run(const YUVRow &r, unsigned char *out, int width,
+		       const YUVCoefficients &c)
+	{
+		const int16x8_t yOffset =
+			vdupq_n_s16((int16_t)(c.yOffset * Src::Scale));
+		const int16x8_t center = vdupq_n_s16(128 * Src::Scale);
+		const int16x8_t round = vdupq_n_s16(4);
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			int16x8_t y[2], u[2], v[2];
+			LoadNEON<Src>::Run(r, x, y, u, v);
+
+			for (int i = 0; i < 2; i++) {
+				int16x8_t ys = vshlq_n_s16(
+					vsubq_s16(y[i], yOffset), Src::Shift);
+				int16x8_t us = vshlq_n_s16(
+					vsubq_s16(u[i], center), Src::Shift);
+				int16x8_t vs = vshlq_n_s16(
+					vsubq_s16(v[i], center), Src::Shift);
+
+				int16x8_t yt = vaddq_s16(MulHi(ys, c.y), round);
+				int16x8_t cr = vaddq_s16(yt, MulHi(vs, c.rv));
+				int16x8_t cg = vaddq_s16(
+					vaddq_s16(yt, MulHi(us, c.gu)),
+					MulHi(vs, c.gv));
+				int16x8_t cb = vaddq_s16(yt, MulHi(us, c.bu));
+
+				uint8x8x4_t px;
+				px.val[Dst::R] =
+					vqmovun_s16(vshrq_n_s16(cr, 3));
+				px.val[Dst::G] =
+					vqmovun_s16(vshrq_n_s16(cg, 3));
+				px.val[Dst::B] =
+					vqmovun_s16(vshrq_n_s16(cb, 3));
+				px.val[3] = vdup_n_u8(255);
+				vst4_u8(out + (x + i * 8) * 4, px);
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+struct NarrowRowNEON {
+	static int Run(const unsigned char *src, unsigned char *dst, int count,
+		       const uint16_t *bias)
+	{
+		const uint16_t pattern[8] = {bias[0], bias[1], bias[2],
+					     bias[3], bias[0], bias[1],
+					     bias[2], bias[3]};
+		const uint16x8_t b = vld1q_u16(pattern);
+		const int end = count & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			uint16x8_t lo =
+				vreinterpretq_u16_u8(vld1q_u8(src + x * 2));
+			uint16x8_t hi = vreinterpretq_u16_u8(
+				vld1q_u8(src + x * 2 + 16));
+
+			uint8x8_t a = vshrn_n_u16(vqaddq_u16(lo, b), 8);
+			uint8x8_t c = vshrn_n_u16(vqaddq_u16(hi, b), 8);
+			vst1q_u8(dst + x, vcombine_u8(a, c));
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+template<class Dst> struct ExpandRowNEON {
+	static int Run(const unsigned char *src, unsigned char *dst, int width)
+	{
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			uint8x16x3_t p = vld3q_u8(src + x * 3);
+			uint8x16x4_t out;
+
+			out.val[Dst::R] = p.val[2];
+			out.val[Dst::G] = p.val[1];
+			out.val[Dst::B] = p.val[0];
+			out.val[3] = vdupq_n_u8(255);
+			vst4q_u8(dst + x * 4, out);
+		}
+
+		return end;
+	}
+};
+
+template<int Size> struct RotateTileNEON;
+
+template<> struct RotateTileNEON<1> {
+	enum { N = 8 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		uint8x8_t r[8];
+		for (int i = 0; i < 8; i++)
+			r[i] = vld1_u8(src + (ptrdiff_t)i * srcStride);
+
+		/* swap ever larger pieces across the diagonal: bytes, then
+		 * pairs of bytes, then quads */
+		uint16x4_t a[8];
+		for (int i = 0; i < 4; i++) {
+			a[i * 2] = vreinterpret_u16_u8(
+				vtrn1_u8(r[i * 2], r[i * 2 + 1]));
+			a[i * 2 + 1] = vreinterpret_u16_u8(
+				vtrn2_u8(r[i * 2], r[i * 2 + 1]));
+		}
+
+		uint32x2_t b[8];
+		for (int i = 0; i < 2; i++) {
+			b[i * 4] = vreinterpret_u32_u16(
+				vtrn1_u16(a[i * 4], a[i * 4 + 2]));
+			b[i * 4 + 1] = vreinterpret_u32_u16(
+				vtrn1_u16(a[i * 4 + 1], a[i * 4 + 3]));
+			b[i * 4 + 2] = vreinterpret_u32_u16(
+				vtrn2_u16(a[i * 4], a[i * 4 + 2]));
+			b[i * 4 + 3] = vreinterpret_u32_u16(
+				vtrn2_u16(a[i * 4 + 1], a[i * 4 + 3]));
+		}
+
+		for (int i = 0; i < 4; i++) {
+			vst1_u8(dst + (ptrdiff_t)i * dstStride,
+				vreinterpret_u8_u32(vtrn1_u32(b[i], b[i + 4])));
+			vst1_u8(dst + (ptrdiff_t)(i + 4) * dstStride,
+				vreinterpret_u8_u32(vtrn2_u32(b[i], b[i + 4])));
+		}
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			uint8x16_t v =
+				vrev64q_u8(vld1q_u8(src + width - 16 - x));
+			vst1q_u8(dst + x, vextq_u8(v, v, 8));
+		}
+
+		return end;
+	}
+};
+
+template<> struct RotateTileNEON<2> {
+	enum { N = 8 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		uint16x8_t r[8];
+		for (int i = 0; i < 8; i++)
+			r[i] = vld1q_u16((const uint16_t *)(src +
+							    (ptrdiff_t)i *
+								    srcStride));
+
+		uint32x4_t a[8];
+		for (int i = 0; i < 4; i++) {
+			a[i * 2] = vreinterpretq_u32_u16(
+				vtrn1q_u16(r[i * 2], r[i * 2 + 1]));
+			a[i * 2 + 1] = vreinterpretq_u32_u16(
+				vtrn2q_u16(r[i * 2], r[i * 2 + 1]));
+		}
+
+		uint64x2_t b[8];
+		for (int i = 0; i < 2; i++) {
+			b[i * 4] = vreinterpretq_u64_u32(
+				vtrn1q_u32(a[i * 4], a[i * 4 + 2]));
+			b[i * 4 + 1] = vreinterpretq_u64_u32(
+				vtrn1q_u32(a[i * 4 + 1], a[i * 4 + 3]));
+			b[i * 4 + 2] = vreinterpretq_u64_u32(
+				vtrn2q_u32(a[i * 4], a[i * 4 + 2]));
+			b[i * 4 + 3] = vreinterpretq_u64_u32(
+				vtrn2q_u32(a[i * 4 + 1], a[i * 4 + 3]));
+		}
+
+		for (int i = 0; i < 4; i++) {
+			vst1q_u8(dst + (ptrdiff_t)i * dstStride,
+				 vreinterpretq_u8_u64(
+					 vtrn1q_u64(b[i], b[i + 4])));
+			vst1q_u8(dst + (ptrdiff_t)(i + 4) * dstStride,
+				 vreinterpretq_u8_u64(
+					 vtrn2q_u64(b[i], b[i + 4])));
+		}
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			uint16x8_t v = vrev64q_u16(vld1q_u16(
+				(const uint16_t *)(src + (width - 8 - x) * 2)));
+			vst1q_u16((uint16_t *)(dst + x * 2),
+				  vextq_u16(v, v, 4));
+		}
+
+		return end;
+	}
+};
+
+template<> struct RotateTileNEON<4> {
+	enum { N = 4 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		uint32x4_t r[4];
+		for (int i = 0; i < 4; i++)
+			r[i] = vld1q_u32((const uint32_t *)(src +
+							    (ptrdiff_t)i *
+								    srcStride));
+
+		uint64x2_t a0 = vreinterpretq_u64_u32(vtrn1q_u32(r[0], r[1]));
+		uint64x2_t a1 = vreinterpretq_u64_u32(vtrn2q_u32(r[0], r[1]));
+		uint64x2_t a2 = vreinterpretq_u64_u32(vtrn1q_u32(r[2], r[3]));
+		uint64x2_t a3 = vreinterpretq_u64_u32(vtrn2q_u32(r[2], r[3]));
+
+		vst1q_u8(dst, vreinterpretq_u8_u64(vtrn1q_u64(a0, a2)));
+		vst1q_u8(dst + dstStride,
+			 vreinterpretq_u8_u64(vtrn1q_u64(a1, a3)));
+		vst1q_u8(dst + (ptrdiff_t)2 * dstStride,
+			 vreinterpretq_u8_u64(vtrn2q_u64(a0, a2)));
+		vst1q_u8(dst + (ptrdiff_t)3 * dstStride,
+			 vreinterpretq_u8_u64(vtrn2q_u64(a1, a3)));
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~3;
+
+		for (int x = 0; x < end; x += 4) {
+			uint32x4_t v = vrev64q_u32(vld1q_u32(
+				(const uint32_t *)(src + (width - 4 - x) * 4)));
+			vst1q_u32((uint32_t *)(dst + x * 4),
+				  vextq_u32(v, v, 2));
+		}
+
+		return end;
+	}
+
+	template<class L>
+	static inline int MergePairs(const unsigned char *a,
+				     const unsigned char *b, unsigned char *dst,
+				     int width)
+	{
+		const int end = width & ~31;
+
+		for (int x = 0; x < end; x += 32) {
+			uint8x16x4_t pa = vld4q_u8(a + x * 2);
+			uint8x16x4_t pb = vld4q_u8(b + x * 2);
+			uint8x16_t cu = vrhaddq_u8(pa.val[L::U], pb.val[L::U]);
+			uint8x16_t cv = vrhaddq_u8(pa.val[L::V], pb.val[L::V]);
+
+			/* back in pixel order, each with its own macropixel */
+			uint8x16x2_t ya = vzipq_u8(pa.val[L::Y],
+						   pa.val[L::Y + 2]);
+			uint8x16x2_t yb = vzipq_u8(pb.val[L::Y],
+						   pb.val[L::Y + 2]);
+			uint8x16x2_t u = vzipq_u8(cu, cu);
+			uint8x16x2_t v = vzipq_u8(cv, cv);
+
+			for (int i = 0; i < 2; i++) {
+				uint8x16x4_t out;
+				out.val[L::Y] = ya.val[i];
+				out.val[L::Y + 2] = yb.val[i];
+				out.val[L::U] = u.val[i];
+				out.val[L::V] = v.val[i];
+				vst4q_u8(dst + x * 4 + i * 64, out);
+			}
+		}
+
+		return end;
+	}
+};
+
+}
+
+ConvertKernel GetConvertKernelNEON(VideoFormat from, VideoFormat to)
+{
+	ConvertKernel kernel = SelectPackedTo420<PackedRowNEON>(from, to);
+	if (!kernel)
+		kernel = SelectYUVToRGB<YUVRowNEON>(from, to);
+	if (!kernel)
+		kernel = SelectNarrow<NarrowRowNEON>(from, to);
+	if (!kernel)
+		kernel = SelectExpandRGB24<ExpandRowNEON>(from, to);
+	return kernel;
+}
+
+ConvertKernel GetRotateKernelNEON(VideoFormat format, int degrees)
+{
+	return SelectRotate<RotateTileNEON>(format, degrees);
+}
+
+}; /* namespace DShow */
+
+#else
+
+namespace DShow {
+
+ConvertKernel GetConvertKernelNEON(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+ConvertKernel GetRotateKernelNEON(VideoFormat, int)
+{
+	return nullptr;
+}
+
+}; /* namespace DShow */
+
+#endif
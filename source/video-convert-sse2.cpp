@@ -0,0 +1,649 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+
+#if DSHOW_X86
+#include <emmintrin.h>
+#include <cstring>
+
+namespace DShow {
+
+namespace {
+
+/* splits 16 packed pixels into luma and chroma pairs */
+template<class L>
+static inline void Split(const unsigned char *src, __m128i &y, __m128i &c)
+{
+	const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+
+	if (L::Y == 0) {
+		y = _mm_packus_epi16(_mm_and_si128(a, lowBytes),
+				     _mm_and_si128(b, lowBytes));
+		c = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+				     _mm_srli_epi16(b, 8));
+	} else {
+		y = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+				     _mm_srli_epi16(b, 8));
+		c = _mm_packus_epi16(_mm_and_si128(a, lowBytes),
+				     _mm_and_si128(b, lowBytes));
+	}
+}
+
+template<class L, bool NV12> struct PackedRowSSE2 {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width)
+	{
+		const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			__m128i luma0, luma1, c0, c1;
+			Split<L>(s0 + x * 2, luma0, c0);
+			Split<L>(s1 + x * 2, luma1, c1);
+
+			_mm_storeu_si128((__m128i *)(y0 + x), luma0);
+			_mm_storeu_si128((__m128i *)(y1 + x), luma1);
+
+			/* pairs of (first, second) chroma bytes */
+			__m128i c = _mm_avg_epu8(c0, c1);
+			__m128i first = _mm_and_si128(c, lowBytes);
+			__m128i second = _mm_srli_epi16(c, 8);
+
+			if (NV12) {
+				if (L::U > L::V)
+					c = _mm_or_si128(
+						_mm_slli_epi16(first, 8),
+						second);
+				_mm_storeu_si128((__m128i *)(u + x), c);
+			} else {
+				__m128i cu = L::U < L::V ? first : second;
+				__m128i cv = L::U < L::V ? second : first;
+				_mm_storel_epi64((__m128i *)(u + x / 2),
+						 _mm_packus_epi16(cu, cu));
+				_mm_storel_epi64((__m128i *)(v + x / 2),
+						 _mm_packus_epi16(cv, cv));
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+static inline __m128i LoadDword(const unsigned char *src)
+{
+	int val;
+	memcpy(&val, src, sizeof(val));
+	return _mm_cvtsi32_si128(val);
+}
+
+/* 32-bit (first, second) chroma pairs to per-pixel 16-bit samples */
+static inline void SplitPairs(__m128i c, __m128i &first, __m128i &second)
+{
+	first = _mm_and_si128(c, _mm_set1_epi32(0xFFFF));
+	first = _mm_or_si128(first, _mm_slli_epi32(first, 16));
+	second = _mm_srli_epi32(c, 16);
+	second = _mm_or_si128(second, _mm_slli_epi32(second, 16));
+}
+
+/* 16-bit luma and chroma samples of 8 pixels */
+template<class Src> struct LoadSSE2;
+
+template<bool Swap> struct LoadSSE2<SrcPlanar<Swap>> {
+	static inline void Run(const YUVRow &r, int x, __m128i &y, __m128i &u,
+			       __m128i &v)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		y = _mm_unpacklo_epi8(
+			_mm_loadl_epi64((const __m128i *)(r.y + x)), zero);
+		u = _mm_unpacklo_epi8(LoadDword(r.u + x / 2), zero);
+		v = _mm_unpacklo_epi8(LoadDword(r.v + x / 2), zero);
+		u = _mm_unpacklo_epi16(u, u);
+		v = _mm_unpacklo_epi16(v, v);
+	}
+};
+
+template<> struct LoadSSE2<SrcNV12> {
+	static inline void Run(const YUVRow &r, int x, __m128i &y, __m128i &u,
+			       __m128i &v)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		y = _mm_unpacklo_epi8(
+			_mm_loadl_epi64((const __m128i *)(r.y + x)), zero);
+		SplitPairs(_mm_unpacklo_epi8(
+				   _mm_loadl_epi64((const __m128i *)(r.u + x)),
+				   zero),
+			   u, v);
+	}
+};
+
+template<class L> struct LoadSSE2<SrcPacked<L>> {
+	static inline void Run(const YUVRow &r, int x, __m128i &y, __m128i &u,
+			       __m128i &v)
+	{
+		const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+		__m128i p = _mm_loadu_si128((const __m128i *)(r.y + x * 2));
+		__m128i c;
+
+		if (L::Y == 0) {
+			y = _mm_and_si128(p, lowBytes);
+			c = _mm_srli_epi16(p, 8);
+		} else {
+			y = _mm_srli_epi16(p, 8);
+			c = _mm_and_si128(p, lowBytes);
+		}
+
+		if (L::U < L::V)
+			SplitPairs(c, u, v);
+		else
+			SplitPairs(c, v, u);
+	}
+};
+
+template<> struct LoadSSE2<SrcP010> {
+	static inline void Run(const YUVRow &r, int x, __m128i &y, __m128i &u,
+			       __m128i &v)
+	{
+		y = _mm_srli_epi16(
+			_mm_loadu_si128((const __m128i *)(r.y + x * 2)), 6);
+		__m128i c = _mm_loadu_si128((const __m128i *)(r.u + x * 2));
+		SplitPairs(_mm_srli_epi16(c, 6), u, v);
+	}
+};
+
+template<class Src, class Dst> struct YUVRowSSE2 {
+	static int Run(const YUVRow &r, unsigned char *out, int width,
+		       const YUVCoefficients &c)
+	{
+		const __m128i yOffset =
+			_mm_set1_epi16((short)(c.yOffset * Src::Scale));
+		const __m128i center = _mm_set1_epi16(128 * Src::Scale);
+		const __m128i cy = _mm_set1_epi16(c.y);
+		const __m128i crv = _mm_set1_epi16(c.rv);
+		const __m128i cgu = _mm_set1_epi16(c.gu);
+		const __m128i cgv = _mm_set1_epi16(c.gv);
+		const __m128i cbu = _mm_set1_epi16(c.bu);
+		const __m128i round = _mm_set1_epi16(4);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i maxVal = _mm_set1_epi16(255);
+		const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			__m128i y, u, v;
+			LoadSSE2<Src>::Run(r, x, y, u, v);
+
+			y = _mm_slli_epi16(_mm_sub_epi16(y, yOffset),
+					   Src::Shift);
+			u = _mm_slli_epi16(_mm_sub_epi16(u, center),
+					   Src::Shift);
+			v = _mm_slli_epi16(_mm_sub_epi16(v, center),
+					   Src::Shift);
+
+			__m128i yt = _mm_add_epi16(_mm_mulhi_epi16(y, cy),
+						   round);
+			__m128i cr = _mm_add_epi16(yt, _mm_mulhi_epi16(v, crv));
+			__m128i cg = _mm_add_epi16(
+				_mm_add_epi16(yt, _mm_mulhi_epi16(u, cgu)),
+				_mm_mulhi_epi16(v, cgv));
+			__m128i cb = _mm_add_epi16(yt, _mm_mulhi_epi16(u, cbu));
+
+			cr = _mm_min_epi16(
+				_mm_max_epi16(_mm_srai_epi16(cr, 3), zero),
+				maxVal);
+			cg = _mm_min_epi16(
+				_mm_max_epi16(_mm_srai_epi16(cg, 3), zero),
+				maxVal);
+			cb = _mm_min_epi16(
+				_mm_max_epi16(_mm_srai_epi16(cb, 3), zero),
+				maxVal);
+
+			/* (first, green) and (third, alpha) byte pairs */
+			__m128i lo = _mm_or_si128(Dst::R == 0 ? cr : cb,
+						  _mm_slli_epi16(cg, 8));
+			__m128i hi = _mm_or_si128(Dst::R == 0 ? cb : cr, alpha);
+
+			_mm_storeu_si128((__m128i *)(out + x * 4),
+					 _mm_unpacklo_epi16(lo, hi));
+			_mm_storeu_si128((__m128i *)(out + x * 4 + 16),
+					 _mm_unpackhi_epi16(lo, hi));
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+/* weights for the bytes of two pixels, widened to 16 bits */
+template<class L>
+static inline __m128i PixelWeights(int16_t r, int16_t g, int16_t b)
+{
+	int16_t w[8] = {};
+	w[L::R] = w[L::R + 4] = r;
+	w[L::G] = w[L::G + 4] = g;
+	w[L::B] = w[L::B + 4] = b;
+	return _mm_loadu_si128((const __m128i *)w);
+}
+
+/* weighted sums of the 16-bit pixels in a and b (two each) */
+static inline __m128i WeightedSums(__m128i a, __m128i b, __m128i weights)
+{
+	__m128 ma = _mm_castsi128_ps(_mm_madd_epi16(a, weights));
+	__m128 mb = _mm_castsi128_ps(_mm_madd_epi16(b, weights));
+
+	__m128 first = _mm_shuffle_ps(ma, mb, _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 second = _mm_shuffle_ps(ma, mb, _MM_SHUFFLE(3, 1, 3, 1));
+
+	return _mm_add_epi32(_mm_castps_si128(first),
+			     _mm_castps_si128(second));
+}
+
+/* sums of the two rows and two columns of the 2x2 blocks of 4 pixels */
+static inline __m128i BlockSums(__m128i row0, __m128i row1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero),
+				   _mm_unpacklo_epi8(row1, zero));
+	__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero),
+				   _mm_unpackhi_epi8(row1, zero));
+
+	lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+	hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+template<class L, bool NV12> struct RGBRowSSE2 {
+	static inline __m128i Luma(__m128i a, __m128i b, __m128i weights,
+				   __m128i bias)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i la = WeightedSums(_mm_unpacklo_epi8(a, zero),
+					  _mm_unpackhi_epi8(a, zero), weights);
+		__m128i lb = WeightedSums(_mm_unpacklo_epi8(b, zero),
+					  _mm_unpackhi_epi8(b, zero), weights);
+
+		la = _mm_srai_epi32(_mm_add_epi32(la, bias), RGB_LUMA_SHIFT);
+		lb = _mm_srai_epi32(_mm_add_epi32(lb, bias), RGB_LUMA_SHIFT);
+
+		__m128i luma = _mm_packs_epi32(la, lb);
+		return _mm_packus_epi16(luma, luma);
+	}
+
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width, const RGBCoefficients &c)
+	{
+		const __m128i yWeights = PixelWeights<L>(c.yr, c.yg, c.yb);
+		const __m128i uWeights = PixelWeights<L>(c.ur, c.ug, c.ub);
+		const __m128i vWeights = PixelWeights<L>(c.vr, c.vg, c.vb);
+		const __m128i yBias =
+			_mm_set1_epi32((c.yOffset << RGB_LUMA_SHIFT) +
+				       (1 << (RGB_LUMA_SHIFT - 1)));
+		const __m128i cBias =
+			_mm_set1_epi32((128 << RGB_CHROMA_SHIFT) +
+				       (1 << (RGB_CHROMA_SHIFT - 1)));
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			const __m128i *p0 = (const __m128i *)(s0 + x * 4);
+			const __m128i *p1 = (const __m128i *)(s1 + x * 4);
+			__m128i a0 = _mm_loadu_si128(p0);
+			__m128i b0 = _mm_loadu_si128(p0 + 1);
+			__m128i a1 = _mm_loadu_si128(p1);
+			__m128i b1 = _mm_loadu_si128(p1 + 1);
+
+			_mm_storel_epi64((__m128i *)(y0 + x),
+					 Luma(a0, b0, yWeights, yBias));
+			_mm_storel_epi64((__m128i *)(y1 + x),
+					 Luma(a1, b1, yWeights, yBias));
+
+			__m128i blockA = BlockSums(a0, a1);
+			__m128i blockB = BlockSums(b0, b1);
+			__m128i cu = WeightedSums(blockA, blockB, uWeights);
+			__m128i cv = WeightedSums(blockA, blockB, vWeights);
+
+			cu = _mm_srai_epi32(_mm_add_epi32(cu, cBias),
+					    RGB_CHROMA_SHIFT);
+			cv = _mm_srai_epi32(_mm_add_epi32(cv, cBias),
+					    RGB_CHROMA_SHIFT);
+
+			/* UUUUVVVV in the low 8 bytes */
+			__m128i c8 = _mm_packs_epi32(cu, cv);
+			c8 = _mm_packus_epi16(c8, c8);
+
+			if (NV12) {
+				_mm_storel_epi64(
+					(__m128i *)(u + x),
+					_mm_unpacklo_epi8(
+						c8, _mm_srli_si128(c8, 4)));
+			} else {
+				int val = _mm_cvtsi128_si32(c8);
+				memcpy(u + x / 2, &val, sizeof(val));
+				val = _mm_cvtsi128_si32(_mm_srli_si128(c8, 4));
+				memcpy(v + x / 2, &val, sizeof(val));
+			}
+		}
+
+		return end;
+	}
+};
+
+struct SplitUVSSE2 {
+	static int Run(const unsigned char *uv, unsigned char *u,
+		       unsigned char *v, int count)
+	{
+		const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+		const int end = count & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			const __m128i *p = (const __m128i *)(uv + x * 2);
+			__m128i a = _mm_loadu_si128(p);
+			__m128i b = _mm_loadu_si128(p + 1);
+
+			__m128i cu = _mm_packus_epi16(
+				_mm_and_si128(a, lowBytes),
+				_mm_and_si128(b, lowBytes));
+			__m128i cv = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+						      _mm_srli_epi16(b, 8));
+
+			_mm_storeu_si128((__m128i *)(u + x), cu);
+			_mm_storeu_si128((__m128i *)(v + x), cv);
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+struct NarrowRowSSE2 {
+	static int Run(const unsigned char *src, unsigned char *dst, int count,
+		       const uint16_t *bias)
+	{
+		const __m128i b = _mm_setr_epi16(
+			(short)bias[0], (short)bias[1], (short)bias[2],
+			(short)bias[3], (short)bias[0], (short)bias[1],
+			(short)bias[2], (short)bias[3]);
+		const int end = count & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			__m128i lo = _mm_loadu_si128(
+				(const __m128i *)(src + x * 2));
+			__m128i hi = _mm_loadu_si128(
+				(const __m128i *)(src + x * 2 + 16));
+
+			lo = _mm_srli_epi16(_mm_adds_epu16(lo, b), 8);
+			hi = _mm_srli_epi16(_mm_adds_epu16(hi, b), 8);
+			_mm_storeu_si128((__m128i *)(dst + x),
+					 _mm_packus_epi16(lo, hi));
+		}
+
+		return end;
+	}
+};
+
+template<int Size> struct RotateTileSSE2;
+
+template<> struct RotateTileSSE2<1> {
+	enum { N = 8 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		__m128i r[8];
+		for (int i = 0; i < 8; i++)
+			r[i] = _mm_loadl_epi64(
+				(const __m128i *)(src +
+						  (ptrdiff_t)i * srcStride));
+
+		/* interleave rows in pairs, then pairs of pairs, until
+		 * each column is a run of eight bytes */
+		__m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+		__m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+		__m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+		__m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+		__m128i b0 = _mm_unpacklo_epi16(a0, a1);
+		__m128i b1 = _mm_unpackhi_epi16(a0, a1);
+		__m128i b2 = _mm_unpacklo_epi16(a2, a3);
+		__m128i b3 = _mm_unpackhi_epi16(a2, a3);
+
+		__m128i c[4];
+		c[0] = _mm_unpacklo_epi32(b0, b2);
+		c[1] = _mm_unpackhi_epi32(b0, b2);
+		c[2] = _mm_unpacklo_epi32(b1, b3);
+		c[3] = _mm_unpackhi_epi32(b1, b3);
+
+		for (int i = 0; i < 4; i++) {
+			unsigned char *d = dst + (ptrdiff_t)(i * 2) * dstStride;
+			_mm_storel_epi64((__m128i *)d, c[i]);
+			_mm_storel_epi64((__m128i *)(d + dstStride),
+					 _mm_srli_si128(c[i], 8));
+		}
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			__m128i v = _mm_loadu_si128(
+				(const __m128i *)(src + width - 16 - x));
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8),
+					 _mm_srli_epi16(v, 8));
+			_mm_storeu_si128((__m128i *)(dst + x), v);
+		}
+
+		return end;
+	}
+};
+
+template<> struct RotateTileSSE2<2> {
+	enum { N = 8 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		__m128i r[8];
+		for (int i = 0; i < 8; i++)
+			r[i] = _mm_loadu_si128(
+				(const __m128i *)(src +
+						  (ptrdiff_t)i * srcStride));
+
+		__m128i a[8], b[8];
+		for (int i = 0; i < 4; i++) {
+			a[i * 2] = _mm_unpacklo_epi16(r[i * 2], r[i * 2 + 1]);
+			a[i * 2 + 1] =
+				_mm_unpackhi_epi16(r[i * 2], r[i * 2 + 1]);
+		}
+
+		/* columns 0-1, 2-3, 4-5 and 6-7 of rows 0-3, then 4-7 */
+		for (int i = 0; i < 2; i++) {
+			b[i * 4] = _mm_unpacklo_epi32(a[i * 4], a[i * 4 + 2]);
+			b[i * 4 + 1] =
+				_mm_unpackhi_epi32(a[i * 4], a[i * 4 + 2]);
+			b[i * 4 + 2] =
+				_mm_unpacklo_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+			b[i * 4 + 3] =
+				_mm_unpackhi_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+		}
+
+		for (int i = 0; i < 4; i++) {
+			unsigned char *d = dst + (ptrdiff_t)(i * 2) * dstStride;
+			_mm_storeu_si128((__m128i *)d,
+					 _mm_unpacklo_epi64(b[i], b[i + 4]));
+			_mm_storeu_si128((__m128i *)(d + dstStride),
+					 _mm_unpackhi_epi64(b[i], b[i + 4]));
+		}
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			__m128i v = _mm_loadu_si128(
+				(const __m128i *)(src + (width - 8 - x) * 2));
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			_mm_storeu_si128((__m128i *)(dst + x * 2), v);
+		}
+
+		return end;
+	}
+};
+
+template<> struct RotateTileSSE2<4> {
+	enum { N = 4 };
+
+	static inline void Transpose(const unsigned char *src, int srcStride,
+				     unsigned char *dst, int dstStride)
+	{
+		__m128i r[4];
+		for (int i = 0; i < 4; i++)
+			r[i] = _mm_loadu_si128(
+				(const __m128i *)(src +
+						  (ptrdiff_t)i * srcStride));
+
+		__m128i a0 = _mm_unpacklo_epi32(r[0], r[1]);
+		__m128i a1 = _mm_unpackhi_epi32(r[0], r[1]);
+		__m128i a2 = _mm_unpacklo_epi32(r[2], r[3]);
+		__m128i a3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi64(a0, a2));
+		_mm_storeu_si128((__m128i *)(dst + dstStride),
+				 _mm_unpackhi_epi64(a0, a2));
+		_mm_storeu_si128((__m128i *)(dst + (ptrdiff_t)2 * dstStride),
+				 _mm_unpacklo_epi64(a1, a3));
+		_mm_storeu_si128((__m128i *)(dst + (ptrdiff_t)3 * dstStride),
+				 _mm_unpackhi_epi64(a1, a3));
+	}
+
+	static inline int Reverse(const unsigned char *src, unsigned char *dst,
+				  int width)
+	{
+		const int end = width & ~3;
+
+		for (int x = 0; x < end; x += 4) {
+			__m128i v = _mm_loadu_si128(
+				(const __m128i *)(src + (width - 4 - x) * 4));
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			_mm_storeu_si128((__m128i *)(dst + x * 4), v);
+		}
+
+		return end;
+	}
+
+	template<class L>
+	static inline int MergePairs(const unsigned char *a,
+				     const unsigned char *b, unsigned char *dst,
+				     int width)
+	{
+		const __m128i first = _mm_set1_epi32(0xFF << (L::Y * 8));
+		const __m128i second = _mm_slli_epi32(first, 16);
+		const __m128i chroma =
+			_mm_andnot_si128(_mm_or_si128(first, second),
+					 _mm_set1_epi32(-1));
+		const int end = width & ~7;
+
+		for (int x = 0; x < end; x += 8) {
+			__m128i pa =
+				_mm_loadu_si128((const __m128i *)(a + x * 2));
+			__m128i pb =
+				_mm_loadu_si128((const __m128i *)(b + x * 2));
+			__m128i c = _mm_and_si128(_mm_avg_epu8(pa, pb), chroma);
+
+			/* each pixel's luma from a, then from b */
+			__m128i even = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(pa, first),
+					     _mm_slli_epi32(
+						     _mm_and_si128(pb, first),
+						     16)),
+				c);
+			__m128i odd = _mm_or_si128(
+				_mm_or_si128(_mm_srli_epi32(
+						     _mm_and_si128(pa, second),
+						     16),
+					     _mm_and_si128(pb, second)),
+				c);
+
+			_mm_storeu_si128((__m128i *)(dst + x * 4),
+					 _mm_unpacklo_epi32(even, odd));
+			_mm_storeu_si128((__m128i *)(dst + x * 4 + 16),
+					 _mm_unpackhi_epi32(even, odd));
+		}
+
+		return end;
+	}
+};
+
+}
+
+ConvertKernel GetConvertKernelSSE2(VideoFormat from, VideoFormat to)
+{
+	ConvertKernel kernel = SelectPackedTo420<PackedRowSSE2>(from, to);
+	if (!kernel)
+		kernel = SelectYUVToRGB<YUVRowSSE2>(from, to);
+	if (!kernel)
+		kernel = SelectRGBTo420<RGBRowSSE2>(from, to);
+	if (!kernel)
+		kernel = SelectSplitUV<SplitUVSSE2>(from, to);
+	if (!kernel)
+		kernel = SelectNarrow<NarrowRowSSE2>(from, to);
+	return kernel;
+}
+
+ConvertKernel GetRotateKernelSSE2(VideoFormat format, int degrees)
+{
+	return SelectRotate<RotateTileSSE2>(format, degrees);
+}
+
+}; /* namespace DShow */
+
+#else
+
+namespace DShow {
+
+ConvertKernel GetConvertKernelSSE2(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+ConvertKernel GetRotateKernelSSE2(VideoFormat, int)
+{
+	return nullptr;
+}
+
+}; /* namespace DShow */
+
+#endif
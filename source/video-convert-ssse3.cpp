@@ -0,0 +1,167 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+
+#if DSHOW_X86
+#include <tmmintrin.h>
+
+namespace DShow {
+
+namespace {
+
+/* shuffle that puts the 8 luma bytes of 8 packed pixels in the low half and
+ * their chroma in the high half, as UVUV (NV12) or UUUUVVVV (I420) */
+template<class L, bool NV12> static inline __m128i SplitMask()
+{
+	const char y = (char)L::Y, u = (char)L::U, v = (char)L::V;
+
+	if (NV12)
+		return _mm_setr_epi8(y, y + 2, y + 4, y + 6, y + 8, y + 10,
+				     y + 12, y + 14, u, v, u + 4, v + 4, u + 8,
+				     v + 8, u + 12, v + 12);
+	else
+		return _mm_setr_epi8(y, y + 2, y + 4, y + 6, y + 8, y + 10,
+				     y + 12, y + 14, u, u + 4, u + 8, u + 12, v,
+				     v + 4, v + 8, v + 12);
+}
+
+template<class L, bool NV12> struct PackedRowSSSE3 {
+	static int Run(const unsigned char *s0, const unsigned char *s1,
+		       unsigned char *y0, unsigned char *y1, unsigned char *u,
+		       unsigned char *v, int width)
+	{
+		const __m128i mask = SplitMask<L, NV12>();
+		/* UUUUVVVV UUUUVVVV -> UUUUUUUU VVVVVVVV */
+		const __m128i planar = _mm_setr_epi8(0, 1, 2, 3, 8, 9, 10, 11,
+						     4, 5, 6, 7, 12, 13, 14,
+						     15);
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			const unsigned char *p0 = s0 + x * 2;
+			const unsigned char *p1 = s1 + x * 2;
+
+			__m128i a0 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)p0), mask);
+			__m128i b0 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(p0 + 16)),
+				mask);
+			__m128i a1 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)p1), mask);
+			__m128i b1 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(p1 + 16)),
+				mask);
+
+			_mm_storeu_si128((__m128i *)(y0 + x),
+					 _mm_unpacklo_epi64(a0, b0));
+			_mm_storeu_si128((__m128i *)(y1 + x),
+					 _mm_unpacklo_epi64(a1, b1));
+
+			__m128i c = _mm_avg_epu8(_mm_unpackhi_epi64(a0, b0),
+						 _mm_unpackhi_epi64(a1, b1));
+
+			if (NV12) {
+				_mm_storeu_si128((__m128i *)(u + x), c);
+			} else {
+				c = _mm_shuffle_epi8(c, planar);
+				_mm_storel_epi64((__m128i *)(u + x / 2), c);
+				_mm_storel_epi64((__m128i *)(v + x / 2),
+						 _mm_srli_si128(c, 8));
+			}
+		}
+
+		return end;
+	}
+};
+
+/* ------------------------------------------------------------------------ */
+
+/* spreads four 3-byte pixels over 32 bits each, leaving alpha zero */
+template<class Dst> static inline __m128i ExpandMask()
+{
+	/* source byte of each output byte: BGRA keeps the order and RGBA
+	 * swaps the first and third, which is just Dst::B and Dst::R */
+	const char b = (char)Dst::B, r = (char)Dst::R;
+	const char none = (char)0x80;
+
+	return _mm_setr_epi8(b, 1, r, none, b + 3, 4, r + 3, none, b + 6, 7,
+			     r + 6, none, b + 9, 10, r + 9, none);
+}
+
+template<class Dst> struct ExpandRowSSSE3 {
+	static int Run(const unsigned char *src, unsigned char *dst, int width)
+	{
+		const __m128i mask = ExpandMask<Dst>();
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+		const int end = width & ~15;
+
+		for (int x = 0; x < end; x += 16) {
+			const unsigned char *s = src + x * 3;
+			unsigned char *d = dst + x * 4;
+
+			/* 48 bytes, the pixels of each output register
+			 * moved to the start of one */
+			__m128i a = _mm_loadu_si128((const __m128i *)s);
+			__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+			__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+			__m128i p1 = _mm_alignr_epi8(b, a, 12);
+			__m128i p2 = _mm_alignr_epi8(c, b, 8);
+			__m128i p3 = _mm_srli_si128(c, 4);
+
+			a = _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha);
+			p1 = _mm_or_si128(_mm_shuffle_epi8(p1, mask), alpha);
+			p2 = _mm_or_si128(_mm_shuffle_epi8(p2, mask), alpha);
+			p3 = _mm_or_si128(_mm_shuffle_epi8(p3, mask), alpha);
+
+			_mm_storeu_si128((__m128i *)d, a);
+			_mm_storeu_si128((__m128i *)(d + 16), p1);
+			_mm_storeu_si128((__m128i *)(d + 32), p2);
+			_mm_storeu_si128((__m128i *)(d + 48), p3);
+		}
+
+		return end;
+	}
+};
+
+}
+
+ConvertKernel GetConvertKernelSSSE3(VideoFormat from, VideoFormat to)
+{
+	ConvertKernel kernel = SelectPackedTo420<PackedRowSSSE3>(from, to);
+	if (!kernel)
+		kernel = SelectExpandRGB24<ExpandRowSSSE3>(from, to);
+	return kernel;
+}
+
+}; /* namespace DShow */
+
+#else
+
+namespace DShow {
+
+ConvertKernel GetConvertKernelSSSE3(VideoFormat, VideoFormat)
+{
+	return nullptr;
+}
+
+}; /* namespace DShow */
+
+#endif
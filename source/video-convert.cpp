@@ -0,0 +1,922 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-convert.hpp"
+#include "video-convert-impl.hpp"
+#include "cpu-features.hpp"
+#include "frame-ref.hpp"
+#include "packet-assembler.hpp"
+#include "slice-executor.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+namespace DShow {
+
+/* converted frames that may be in flight at once before the pool starts
+ * freeing buffers instead of keeping them */
+#define MAX_POOLED_FRAMES 8
+
+/* rows converted at a time before being rotated, a multiple of the dither
+ * matrix's height */
+#define ROTATE_BAND 16
+
+/* band buffers of different workers don't share cache lines */
+#define BAND_ALIGN 64
+
+/* I420 <-> YV12, the chroma planes just trade places */
+static void SwapPlanes420(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	const int halfWidth = (f.width + 1) / 2;
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		memcpy(f.dst[0] + (ptrdiff_t)y * f.dstStride[0],
+		       f.src[0] + (ptrdiff_t)y * f.srcStride[0], f.width);
+
+		if (y & 1)
+			continue;
+
+		const ptrdiff_t row = y / 2;
+		memcpy(f.dst[1] + row * f.dstStride[1],
+		       f.src[2] + row * f.srcStride[2], halfWidth);
+		memcpy(f.dst[2] + row * f.dstStride[2],
+		       f.src[1] + row * f.srcStride[1], halfWidth);
+	}
+}
+
+/* same format, single plane: copying each row to the other stride is all
+ * there is to it, which flips the frame when the signs differ */
+static void CopyRows(const ConvertFrame &f, int rowBegin, int rowEnd)
+{
+	const size_t rowBytes = (size_t)f.dstStride[0];
+
+	for (int y = rowBegin; y < rowEnd; y++)
+		memcpy(f.dst[0] + (ptrdiff_t)y * f.dstStride[0],
+		       f.src[0] + (ptrdiff_t)y * f.srcStride[0], rowBytes);
+}
+
+static ConvertKernel GetConvertKernelScalar(VideoFormat from, VideoFormat to)
+{
+	if ((from == VideoFormat::I420 && to == VideoFormat::YV12) ||
+	    (from == VideoFormat::YV12 && to == VideoFormat::I420))
+		return SwapPlanes420;
+
+	ConvertKernel kernel = SelectPackedTo420<PackedRowNone>(from, to);
+	if (!kernel)
+		kernel = SelectYUVToRGB<YUVRowNone>(from, to);
+	if (!kernel)
+		kernel = SelectRGBTo420<RGBRowNone>(from, to);
+	if (!kernel)
+		kernel = SelectSplitUV<SplitUVNone>(from, to);
+	if (!kernel)
+		kernel = SelectNarrow<NarrowRowNone>(from, to);
+	if (!kernel)
+		kernel = SelectExpandRGB24<ExpandRowNone>(from, to);
+	return kernel;
+}
+
+static inline int16_t Coefficient(double val)
+{
+	return (int16_t)lround(val * 8192.0);
+}
+
+static void GetLumaWeights(ColorMatrix matrix, double &kr, double &kb)
+{
+	switch (matrix) {
+	case ColorMatrix::BT601:
+		kr = 0.299;
+		kb = 0.114;
+		break;
+	case ColorMatrix::BT2020:
+		kr = 0.2627;
+		kb = 0.0593;
+		break;
+	default:
+		kr = 0.2126;
+		kb = 0.0722;
+		break;
+	}
+}
+
+ColorMatrix ResolveColorMatrix(ColorMatrix matrix, VideoFormat format,
+			       ColorTransfer transfer)
+{
+	if (matrix != ColorMatrix::Auto)
+		return matrix;
+
+	/* HDR P010 is all but always BT.2020, which the tone mapping has to
+	 * map down to BT.709 */
+	return format == VideoFormat::P010 && transfer != ColorTransfer::SDR
+		       ? ColorMatrix::BT2020
+		       : ColorMatrix::BT709;
+}
+
+YUVCoefficients GetYUVCoefficients(ColorMatrix matrix, ColorRange range)
+{
+	double kr, kb;
+	GetLumaWeights(matrix, kr, kb);
+
+	const double kg = 1.0 - kr - kb;
+	const bool full = range == ColorRange::Full;
+	const double yScale = full ? 1.0 : 255.0 / 219.0;
+	const double cScale = full ? 1.0 : 255.0 / 224.0;
+
+	YUVCoefficients c;
+	c.y = Coefficient(yScale);
+	c.rv = Coefficient(2.0 * (1.0 - kr) * cScale);
+	c.gu = Coefficient(-2.0 * (1.0 - kb) * kb / kg * cScale);
+	c.gv = Coefficient(-2.0 * (1.0 - kr) * kr / kg * cScale);
+	c.bu = Coefficient(2.0 * (1.0 - kb) * cScale);
+	c.yOffset = full ? 0 : 16;
+	return c;
+}
+
+static inline int16_t Coefficient15(double val)
+{
+	return (int16_t)lround(val * 32768.0);
+}
+
+RGBCoefficients GetRGBCoefficients(ColorMatrix matrix, ColorRange range)
+{
+	double kr, kb;
+	GetLumaWeights(matrix, kr, kb);
+
+	const double kg = 1.0 - kr - kb;
+	const bool full = range == ColorRange::Full;
+	const double yScale = full ? 1.0 : 219.0 / 255.0;
+	const double cScale = full ? 1.0 : 224.0 / 255.0;
+
+	RGBCoefficients c;
+	c.yr = Coefficient15(kr * yScale);
+	c.yg = Coefficient15(kg * yScale);
+	c.yb = Coefficient15(kb * yScale);
+	c.ur = Coefficient15(-kr / (2.0 * (1.0 - kb)) * cScale);
+	c.ug = Coefficient15(-kg / (2.0 * (1.0 - kb)) * cScale);
+	c.ub = Coefficient15(0.5 * cScale);
+	c.vr = Coefficient15(0.5 * cScale);
+	c.vg = Coefficient15(-kg / (2.0 * (1.0 - kr)) * cScale);
+	c.vb = Coefficient15(-kb / (2.0 * (1.0 - kr)) * cScale);
+	c.yOffset = full ? 0 : 16;
+	return c;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Tone mapping */
+
+/* SDR reference white in HDR, BT.2408 */
+#define REFERENCE_WHITE_NITS 203.0
+
+/* brightest HDR that is kept apart, the usual mastering display peak */
+#define HDR_PEAK_NITS 1000.0
+
+/* linear SDR below which HDR is left untouched */
+#define TONEMAP_KNEE 0.5
+
+/* SMPTE ST 2084 EOTF */
+static double PQToNits(double e)
+{
+	const double m1 = 2610.0 / 16384.0;
+	const double m2 = 2523.0 / 4096.0 * 128.0;
+	const double c1 = 3424.0 / 4096.0;
+	const double c2 = 2413.0 / 4096.0 * 32.0;
+	const double c3 = 2392.0 / 4096.0 * 32.0;
+
+	double p = pow(e, 1.0 / m2);
+	double num = p - c1 > 0.0 ? p - c1 : 0.0;
+	return 10000.0 * pow(num / (c2 - c3 * p), 1.0 / m1);
+}
+
+/* BT.2100 HLG inverse OETF, then the OOTF for a 1000 nit display (applied
+ * per channel rather than to luminance) */
+static double HLGToNits(double e)
+{
+	const double a = 0.17883277;
+	const double b = 0.28466892;
+	const double c = 0.55991073;
+
+	double scene = e <= 0.5 ? e * e / 3.0 : (exp((e - c) / a) + b) / 12.0;
+	return 1000.0 * pow(scene, 1.2);
+}
+
+/* linear up to the knee, then extended Reinhard bringing the peak to 1 */
+static double ToneCurve(double nits)
+{
+	const double k = TONEMAP_KNEE;
+	const double l = nits / REFERENCE_WHITE_NITS;
+
+	if (l <= k)
+		return l;
+
+	const double w = (HDR_PEAK_NITS / REFERENCE_WHITE_NITS - k) / (1.0 - k);
+	const double x = (l - k) / (1.0 - k);
+	return k + (1.0 - k) * x * (1.0 + x / (w * w)) / (1.0 + x);
+}
+
+/* BT.709 OETF */
+static double LinearTo709(double l)
+{
+	return l < 0.018 ? 4.5 * l : 1.099 * pow(l, 0.45) - 0.099;
+}
+
+/* BT.2087 */
+static const double Gamut2020To709[9] = {
+	1.6605, -0.5876, -0.0728, -0.1246, 1.1329,
+	-0.0083, -0.0182, -0.1006, 1.1187,
+};
+
+static TonemapTables MakeTonemapTables(double (*toNits)(double), bool wide)
+{
+	TonemapTables t;
+
+	/* non-linear RGB from 10-bit YUV ends up on a 0-1020 scale */
+	for (int i = 0; i < 1024; i++) {
+		double e = i < 1020 ? (double)i / 1020.0 : 1.0;
+		double l = ToneCurve(toNits(e));
+		t.toLinear[i] = (int32_t)lround((l < 1.0 ? l : 1.0) *
+						TONEMAP_MAX);
+	}
+
+	for (int i = 0; i < 9; i++) {
+		double val = wide ? Gamut2020To709[i] : (i % 4 ? 0.0 : 1.0);
+		t.gamut[i] = (int32_t)lround(val * (1 << TONEMAP_SHIFT));
+	}
+
+	for (int i = 0; i <= TONEMAP_MAX; i++) {
+		double l = (double)i / TONEMAP_MAX;
+		t.toGamma[i] = (int32_t)lround(LinearTo709(l) * 255.0);
+	}
+
+	return t;
+}
+
+const TonemapTables *GetTonemapTables(ColorTransfer transfer,
+				      ColorMatrix matrix)
+{
+	const bool wide = matrix == ColorMatrix::BT2020;
+
+	if (transfer == ColorTransfer::PQ) {
+		static const TonemapTables pq =
+			MakeTonemapTables(PQToNits, true);
+		static const TonemapTables pqNarrow =
+			MakeTonemapTables(PQToNits, false);
+		return wide ? &pq : &pqNarrow;
+
+	} else if (transfer == ColorTransfer::HLG) {
+		static const TonemapTables hlg =
+			MakeTonemapTables(HLGToNits, true);
+		static const TonemapTables hlgNarrow =
+			MakeTonemapTables(HLGToNits, false);
+		return wide ? &hlg : &hlgNarrow;
+	}
+
+	return nullptr;
+}
+
+static ConvertKernel GetTonemapKernelScalar(VideoFormat from, VideoFormat to)
+{
+	return SelectTonemap<TonemapRowNone>(from, to);
+}
+
+static ConvertKernel GetRotateKernelScalar(VideoFormat format, int degrees)
+{
+	return SelectRotate<RotateTileNone>(format, degrees);
+}
+
+typedef ConvertKernel (*ConvertGetter)(VideoFormat from, VideoFormat to);
+typedef ConvertKernel (*RotateGetter)(VideoFormat format, int degrees);
+
+/* the kernels of each instruction set, nullptr where it has none of a
+ * kind; also any that aren't built return nullptr */
+struct KernelTier {
+	uint32_t feature;
+	const char *name;
+	ConvertGetter convert;
+	ConvertGetter tonemap;
+	RotateGetter rotate;
+};
+
+/* fastest first, ending with the C kernels that need nothing */
+static const KernelTier kernelTiers[] = {
+	{CPU_AVX512, "avx512", GetConvertKernelAVX512, nullptr, nullptr},
+	{CPU_AVX2, "avx2", GetConvertKernelAVX2, GetTonemapKernelAVX2,
+	 nullptr},
+	{CPU_SSSE3, "ssse3", GetConvertKernelSSSE3, nullptr, nullptr},
+	{CPU_SSE2, "sse2", GetConvertKernelSSE2, nullptr, GetRotateKernelSSE2},
+	{CPU_NEON, "neon", GetConvertKernelNEON, nullptr, GetRotateKernelNEON},
+	{0, "c", GetConvertKernelScalar, GetTonemapKernelScalar,
+	 GetRotateKernelScalar},
+};
+
+/* the kernel of the first tier the CPU features allow that has one */
+template<class Getter, class Arg>
+static ConvertKernel FindKernel(Getter KernelTier::*getter,
+				uint32_t cpuFeatures, VideoFormat format,
+				Arg arg, const char **isa)
+{
+	for (const KernelTier &tier : kernelTiers) {
+		if ((cpuFeatures & tier.feature) != tier.feature ||
+		    !(tier.*getter))
+			continue;
+
+		ConvertKernel kernel = (tier.*getter)(format, arg);
+		if (kernel) {
+			if (isa)
+				*isa = tier.name;
+			return kernel;
+		}
+	}
+
+	if (isa)
+		*isa = nullptr;
+	return nullptr;
+}
+
+ConvertKernel GetTonemapKernel(VideoFormat from, VideoFormat to,
+			       uint32_t cpuFeatures, const char **isa)
+{
+	return FindKernel(&KernelTier::tonemap, cpuFeatures, from, to, isa);
+}
+
+ConvertKernel GetConvertKernel(VideoFormat from, VideoFormat to,
+			       uint32_t cpuFeatures, const char **isa)
+{
+	return FindKernel(&KernelTier::convert, cpuFeatures, from, to, isa);
+}
+
+ConvertKernel GetScaleKernel(VideoFormat format)
+{
+	return SelectScale(format);
+}
+
+ConvertKernel GetRotateKernel(VideoFormat format, int degrees,
+			      uint32_t cpuFeatures, const char **isa)
+{
+	return FindKernel(&KernelTier::rotate, cpuFeatures, format, degrees,
+			  isa);
+}
+
+/* only right angles are rotated, anything else is left to the consumer */
+static inline int RightAngle(long rotation)
+{
+	int degrees = (int)(rotation % 360);
+	if (degrees < 0)
+		degrees += 360;
+	return degrees % 90 ? 0 : degrees;
+}
+
+static inline bool Packed422(VideoFormat format)
+{
+	return format == VideoFormat::YUY2 || format == VideoFormat::YVYU ||
+	       format == VideoFormat::UYVY || format == VideoFormat::HDYC;
+}
+
+static inline bool HalfChroma(VideoFormat format)
+{
+	return format == VideoFormat::I420 || format == VideoFormat::YV12 ||
+	       format == VideoFormat::NV12 || format == VideoFormat::P010;
+}
+
+/* most source rows a band of scaled rows is interpolated from */
+static int ScaleBandRows(VideoFormat format, int srcHeight, int height)
+{
+	int rows = 0;
+
+	for (int y = 0; y < height; y += ROTATE_BAND) {
+		int end = height - y < ROTATE_BAND ? height : y + ROTATE_BAND;
+		int first, last;
+		ScaleSourceRows(y, end, srcHeight, height, HalfChroma(format),
+				first, last);
+		if (last - first > rows)
+			rows = last - first;
+	}
+
+	return rows;
+}
+
+/* rows per slice, a multiple of the band height.  By default the rows read
+ * and written for a slice take up half of the L2 cache, leaving the rest
+ * to the band buffers. */
+static int SliceRows(int setting, size_t rowBytes)
+{
+	if (setting > 0)
+		return (setting + ROTATE_BAND - 1) / ROTATE_BAND * ROTATE_BAND;
+
+	size_t rows = rowBytes ? GetL2CacheSize() / 2 / rowBytes : 0;
+	rows -= rows % ROTATE_BAND;
+	return rows > ROTATE_BAND ? (int)rows : ROTATE_BAND;
+}
+
+static inline size_t BandSize(VideoFormat format, int cx, int rows)
+{
+	size_t size = rows ? VideoFrameSize(format, cx, rows) : 0;
+	return (size + BAND_ALIGN - 1) & ~(size_t)(BAND_ALIGN - 1);
+}
+
+/* the size the pipeline scales frames of a size to, if it does */
+static bool ScaledSize(const VideoPipeline &pipeline, int cx, int cy,
+		       int &scaleCX, int &scaleCY)
+{
+	const bool scaling = pipeline.scaleCX > 0 && pipeline.scaleCY > 0 &&
+			     (pipeline.scaleCX != cx || pipeline.scaleCY != cy);
+	scaleCX = scaling ? pipeline.scaleCX : cx;
+	scaleCY = scaling ? pipeline.scaleCY : cy;
+	return scaling;
+}
+
+bool VideoConverter::Prepare(VideoFormat from_, int cx_, int cy_,
+			     long rotation, VideoFormat format,
+			     ColorMatrix matrix_, ColorRange range_,
+			     ColorTransfer transfer_, bool dither_,
+			     bool upright, const VideoPipeline &pipeline)
+{
+	int scaleCX_, scaleCY_;
+	const bool scaling =
+		ScaledSize(pipeline, cx_, cy_, scaleCX_, scaleCY_);
+	const int degrees_ = upright ? RightAngle(rotation) : 0;
+
+	if (format == VideoFormat::Any)
+		format = from_;
+	if (from_ == format && !degrees_ && !scaling)
+		return true;
+
+	/* the tone mapping tables depend on the transfer and matrix too */
+	bool reselect = from_ != from || format != to || cx_ != cx ||
+			cy_ != cy || transfer_ != transfer ||
+			matrix_ != matrix || degrees_ != degrees ||
+			scaleCX_ != scaleCX || scaleCY_ != scaleCY ||
+			kernel == CopyRows;
+
+	if (matrix_ != matrix || range_ != range || !toRGB.y) {
+		matrix = matrix_;
+		range = range_;
+		toRGB = GetYUVCoefficients(matrix, range);
+		toYUV = GetRGBCoefficients(matrix, range);
+		toSDR = GetRGBCoefficients(ColorMatrix::BT709, range);
+	}
+
+	transfer = transfer_;
+	dither = dither_;
+
+	if (reselect) {
+		Reset(from_, format, cx_, cy_);
+		degrees = degrees_;
+		scaleCX = scaleCX_;
+		scaleCY = scaleCY_;
+		kernel = nullptr;
+		tonemap = nullptr;
+		isa = nullptr;
+
+		/* HDR is tone mapped where possible, else converted as is */
+		if (from != to) {
+			tonemap = GetTonemapTables(transfer, matrix);
+			kernel = tonemap ? GetTonemapKernel(from, to,
+							    GetCPUFeatures(),
+							    &isa)
+					 : nullptr;
+		}
+		if (from != to && !kernel) {
+			tonemap = nullptr;
+			kernel = GetConvertKernel(from, to, GetCPUFeatures(),
+						  &isa);
+		}
+
+		/* frames that can't be converted aren't scaled or rotated
+		 * either */
+		const bool convertible = kernel || from == to;
+		scale = scaling && convertible ? GetScaleKernel(to) : nullptr;
+		if (scale && !isa)
+			isa = "c";
+
+		const int outCX = scale ? scaleCX : cx;
+		const int outCY = scale ? scaleCY : cy;
+		const bool oddPacked = Packed422(to) && ((outCX | outCY) & 1);
+		rotate = degrees && convertible && !oddPacked
+				 ? GetRotateKernel(to, degrees,
+						   GetCPUFeatures(),
+						   isa ? nullptr : &isa)
+				 : nullptr;
+
+		frameSize = rotate && degrees != 180
+				    ? VideoFrameSize(to, outCY, outCX)
+				    : VideoFrameSize(to, outCX, outCY);
+
+		/* rows of converted frame that are worked on at a time */
+		bandRows = !kernel ? 0
+			   : scale ? ScaleBandRows(to, cy, scaleCY)
+			   : rotate ? ROTATE_BAND
+				    : 0;
+		bandSize = BandSize(to, cx, bandRows);
+		scaledSize = scale && rotate
+				     ? BandSize(to, scaleCX, ROTATE_BAND)
+				     : 0;
+
+		/* slices are rows of the scaled frame when scaling, else of
+		 * the source */
+		const size_t srcRow = VideoFrameSize(from, cx, 2) / 2;
+		const size_t outRow = VideoFrameSize(to, outCX, 2) / 2;
+		rowBytes = outCY > 0 ? srcRow * (size_t)cy / (size_t)outCY +
+					       outRow
+				     : 0;
+
+		pool = kernel || rotate || scale
+			       ? std::make_shared<ChunkPool>(
+					 frameSize, MAX_POOLED_FRAMES)
+			       : nullptr;
+	}
+
+	/* the threads only change the buffers, not the kernels */
+	const int workers_ = executor ? executor->Workers() : 1;
+	if (reselect || workers_ != workers ||
+	    pipeline.sliceRows != sliceSetting) {
+		workers = workers_;
+		sliceSetting = pipeline.sliceRows;
+		sliceRows = SliceRows(sliceSetting, rowBytes);
+		band.resize(bandSize * workers);
+		scaled.resize(scaledSize * workers);
+	}
+
+	return from == to || kernel;
+}
+
+bool VideoConverter::Convert(FrameRef &frame, VideoFormat format,
+			     ColorMatrix matrix_, ColorRange range_,
+			     ColorTransfer transfer_, bool dither_,
+			     bool upright, const VideoPipeline &pipeline,
+			     bool cropInPlace)
+{
+	if (format == VideoFormat::Any)
+		format = frame.videoFormat;
+
+	int x = pipeline.cropX, y = pipeline.cropY;
+	int cropCX = pipeline.cropCX, cropCY = pipeline.cropCY;
+	const bool cropping = cropCX > 0 && cropCY > 0 &&
+			      ClipVideoRegion(frame.videoFormat, frame.cx,
+					      frame.cy, x, y, cropCX, cropCY);
+
+	int scaleCX_, scaleCY_;
+	const bool scaling = ScaledSize(pipeline, cropping ? cropCX : frame.cx,
+					cropping ? cropCY : frame.cy,
+					scaleCX_, scaleCY_);
+	const bool rotating = upright && RightAngle(frame.rotation);
+	const bool converting = frame.videoFormat != format || rotating ||
+				scaling;
+
+	/* cropping only moves the plane pointers */
+	if (!converting) {
+		if (cropping && cropInPlace)
+			CropVideoFrame(frame, x, y, cropCX, cropCY);
+		return true;
+	}
+	if (!frame.linesize[0])
+		return false;
+
+	if (!Prepare(frame.videoFormat, cropping ? cropCX : frame.cx,
+		     cropping ? cropCY : frame.cy, frame.rotation, format,
+		     matrix_, range_, transfer_, dither_, upright, pipeline))
+		return false;
+
+	/* a stage that isn't supported for the format leaves the frame as
+	 * it is, crop included, rather than half done */
+	if (!pool || (scaling && !scale) || (rotating && !rotate))
+		return false;
+
+	if (cropping)
+		CropVideoFrame(frame, x, y, cropCX, cropCY);
+
+	Run(frame);
+	return true;
+}
+
+bool VideoConverter::Flip(FrameRef &frame)
+{
+	if (frame.linesize[0] >= 0)
+		return true;
+	if (frame.data[1])
+		return false;
+
+	if (frame.videoFormat != from || frame.videoFormat != to ||
+	    frame.cx != cx || frame.cy != cy || kernel != CopyRows) {
+		Reset(frame.videoFormat, frame.videoFormat, frame.cx,
+		      frame.cy);
+
+		kernel = CopyRows;
+		isa = "copy";
+		tonemap = nullptr;
+		rotate = nullptr;
+		scale = nullptr;
+		degrees = 0;
+		sliceRows = SliceRows(0, frame.cy ? frameSize / frame.cy * 2
+						  : 0);
+		pool = frameSize ? std::make_shared<ChunkPool>(
+					   frameSize, MAX_POOLED_FRAMES)
+				 : nullptr;
+	}
+
+	if (!pool)
+		return false;
+
+	Run(frame);
+	return true;
+}
+
+void VideoConverter::Reset(VideoFormat from_, VideoFormat to_, int cx_,
+			   int cy_)
+{
+	from = from_;
+	to = to_;
+	cx = cx_;
+	cy = cy_;
+	frameSize = VideoFrameSize(to, cx, cy);
+}
+
+void VideoConverter::ConvertRotated(const ConvertFrame &convert, int worker,
+				    int rowBegin, int rowEnd)
+{
+	/* each band is converted into a buffer small enough to stay in the
+	 * cache and rotated from there, so the frame is only read once */
+	FrameRef scratch;
+	scratch.cx = cx;
+	scratch.cy = bandRows;
+	scratch.videoFormat = to;
+	SetVideoFramePlanes(scratch, band.data() + bandSize * worker,
+			    bandSize);
+
+	ConvertFrame part = convert;
+	ConvertFrame turn = convert;
+	for (int i = 0; i < 4; i++) {
+		part.dst[i] = scratch.data[i];
+		part.dstStride[i] = scratch.linesize[i];
+		turn.src[i] = scratch.data[i];
+		turn.srcStride[i] = scratch.linesize[i];
+	}
+
+	for (int y = rowBegin; y < rowEnd; y += ROTATE_BAND) {
+		const int rows = rowEnd - y < ROTATE_BAND ? rowEnd - y
+							  : ROTATE_BAND;
+
+		for (int i = 0; i < 4; i++) {
+			if (!convert.src[i])
+				continue;
+
+			int row = VideoPlaneHeight(from, i, y);
+			part.src[i] = convert.src[i] +
+				      (ptrdiff_t)row * convert.srcStride[i];
+		}
+		part.height = rows;
+		kernel(part, 0, rows);
+
+		turn.srcTop = y;
+		rotate(turn, y, y + rows);
+	}
+}
+
+void VideoConverter::ScaleBands(const ConvertFrame &convert, int worker,
+				int rowBegin, int rowEnd)
+{
+	/* a band of scaled rows is made at a time, from just the source rows
+	 * it is interpolated from (converted into a buffer first), and then
+	 * rotated while it is still in the cache */
+	FrameRef converted;
+	converted.cx = cx;
+	converted.cy = bandRows;
+	converted.videoFormat = to;
+	SetVideoFramePlanes(converted, band.data() + bandSize * worker,
+			    bandSize);
+
+	FrameRef rows;
+	rows.cx = scaleCX;
+	rows.cy = ROTATE_BAND;
+	rows.videoFormat = to;
+	SetVideoFramePlanes(rows, scaled.data() + scaledSize * worker,
+			    scaledSize);
+
+	ConvertFrame part = convert;
+	ConvertFrame resize = convert;
+	ConvertFrame turn = convert;
+	for (int i = 0; i < 4; i++) {
+		part.dst[i] = converted.data[i];
+		part.dstStride[i] = converted.linesize[i];
+
+		if (kernel) {
+			resize.src[i] = converted.data[i];
+			resize.srcStride[i] = converted.linesize[i];
+		}
+		if (rotate) {
+			resize.dst[i] = rows.data[i];
+			resize.dstStride[i] = rows.linesize[i];
+			turn.src[i] = rows.data[i];
+			turn.srcStride[i] = rows.linesize[i];
+		}
+	}
+
+	resize.srcWidth = cx;
+	resize.srcHeight = cy;
+	resize.width = turn.width = scaleCX;
+	resize.height = turn.height = scaleCY;
+
+	for (int y = rowBegin; y < rowEnd; y += ROTATE_BAND) {
+		const int end = rowEnd - y < ROTATE_BAND ? rowEnd
+							 : y + ROTATE_BAND;
+
+		if (kernel) {
+			int first, last;
+			ScaleSourceRows(y, end, cy, scaleCY, HalfChroma(to),
+					first, last);
+
+			for (int i = 0; i < 4; i++) {
+				if (!convert.src[i])
+					continue;
+
+				int row = VideoPlaneHeight(from, i, first);
+				part.src[i] = convert.src[i] +
+					      (ptrdiff_t)row *
+						      convert.srcStride[i];
+			}
+			part.height = last - first;
+			kernel(part, 0, last - first);
+
+			resize.srcTop = first;
+		}
+
+		if (rotate)
+			resize.dstTop = y;
+		scale(resize, y, end);
+
+		if (rotate) {
+			turn.srcTop = y;
+			rotate(turn, y, end);
+		}
+	}
+}
+
+void VideoConverter::RunSlice(const ConvertFrame &convert, int worker,
+			      int rowBegin, int rowEnd)
+{
+	if (scale)
+		ScaleBands(convert, worker, rowBegin, rowEnd);
+	else if (!rotate)
+		kernel(convert, rowBegin, rowEnd);
+	else if (!kernel)
+		rotate(convert, rowBegin, rowEnd);
+	else
+		ConvertRotated(convert, worker, rowBegin, rowEnd);
+}
+
+void VideoConverter::Run(FrameRef &frame)
+{
+	std::shared_ptr<ChunkPool> framePool = pool;
+	unsigned char *buffer = framePool->Acquire();
+
+	FrameRef out = frame;
+	out.videoFormat = to;
+	if (scale) {
+		out.cx = scaleCX;
+		out.cy = scaleCY;
+	}
+	if (rotate) {
+		out.rotation = 0;
+		if (degrees != 180)
+			std::swap(out.cx, out.cy);
+	}
+	SetVideoFramePlanes(out, buffer, frameSize);
+	out.owner = std::shared_ptr<unsigned char>(
+		buffer, [framePool](unsigned char *chunk) {
+			framePool->Recycle(chunk);
+		});
+
+	ConvertFrame convert = {};
+	for (int i = 0; i < 4; i++) {
+		convert.src[i] = frame.data[i];
+		convert.srcStride[i] = frame.linesize[i];
+		convert.dst[i] = out.data[i];
+		convert.dstStride[i] = out.linesize[i];
+	}
+	convert.width = cx;
+	convert.height = cy;
+	convert.toRGB = toRGB;
+	convert.toYUV = tonemap ? toSDR : toYUV;
+	convert.tonemap = tonemap;
+	convert.dither = dither;
+
+	const int rows = scale ? scaleCY : cy;
+	const int slices = (rows + sliceRows - 1) / sliceRows;
+
+	auto start = std::chrono::steady_clock::now();
+	if (executor) {
+		SliceExecutor::RunStats run = executor->Run(
+			slices,
+			[&](int slice, int worker) {
+				const int begin = slice * sliceRows;
+				const int end = rows - begin < sliceRows
+							? rows
+							: begin + sliceRows;
+				RunSlice(convert, worker, begin, end);
+			},
+			priority, budgetNs);
+
+		queuedFrames++;
+		totalQueueNs += run.queueNs;
+		if (run.queueNs > maxQueueNs)
+			maxQueueNs = run.queueNs;
+		if (run.late)
+			lateFrames++;
+	} else {
+		RunSlice(convert, 0, 0, rows);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	long long ns = (long long)std::chrono::duration_cast<
+			       std::chrono::nanoseconds>(end - start)
+			       .count();
+	totalNs += ns;
+	if (ns > maxNs)
+		maxNs = ns;
+	frames++;
+
+	frame = std::move(out);
+}
+
+void VideoConverter::GetStats(StreamStats &stats) const
+{
+	stats.conversionKernel = isa;
+	stats.convertedFrames = frames;
+	stats.conversionAvgNs = frames ? totalNs / (long long)frames : 0;
+	stats.conversionMaxNs = maxNs;
+	stats.processingQueueAvgNs =
+		queuedFrames ? totalQueueNs / (long long)queuedFrames : 0;
+	stats.processingQueueMaxNs = maxQueueNs;
+	stats.processingLateFrames = lateFrames;
+}
+
+void VideoConverter::ResetStats()
+{
+	frames = 0;
+	totalNs = 0;
+	maxNs = 0;
+	queuedFrames = 0;
+	totalQueueNs = 0;
+	maxQueueNs = 0;
+	lateFrames = 0;
+}
+
+bool ConvertVideoFrame(const unsigned char *const src[DSHOW_MAX_PLANES],
+		       const int srcLinesize[DSHOW_MAX_PLANES],
+		       VideoFormat srcFormat,
+		       unsigned char *const dst[DSHOW_MAX_PLANES],
+		       const int dstLinesize[DSHOW_MAX_PLANES],
+		       VideoFormat dstFormat, int cx, int cy,
+		       ColorMatrix matrix, ColorRange range,
+		       ColorTransfer transfer)
+{
+	matrix = ResolveColorMatrix(matrix, srcFormat, transfer);
+
+	const TonemapTables *tonemap = GetTonemapTables(transfer, matrix);
+	ConvertKernel kernel =
+		tonemap ? GetTonemapKernel(srcFormat, dstFormat,
+					   GetCPUFeatures())
+			: nullptr;
+	if (!kernel) {
+		tonemap = nullptr;
+		kernel = GetConvertKernel(srcFormat, dstFormat,
+					  GetCPUFeatures());
+	}
+	if (!kernel || cx <= 0 || cy <= 0)
+		return false;
+
+	ConvertFrame convert = {};
+	for (int i = 0; i < 4; i++) {
+		convert.src[i] = src[i];
+		convert.srcStride[i] = srcLinesize[i];
+		convert.dst[i] = dst[i];
+		convert.dstStride[i] = dstLinesize[i];
+	}
+	convert.width = cx;
+	convert.height = cy;
+	convert.toRGB = GetYUVCoefficients(matrix, range);
+	convert.toYUV = GetRGBCoefficients(tonemap ? ColorMatrix::BT709
+						   : matrix,
+					   range);
+	convert.tonemap = tonemap;
+
+	kernel(convert, 0, cy);
+	return true;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,292 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace DShow {
+
+class ChunkPool;
+class SliceExecutor;
+
+/**
+ * YUV to RGB coefficients, with 13 fractional bits.  Signed so every term
+ * is added; green's are negative.
+ */
+struct YUVCoefficients {
+	int16_t y;
+	int16_t rv;
+	int16_t gu;
+	int16_t gv;
+	int16_t bu;
+
+	/** Black level of 8-bit luma */
+	int16_t yOffset;
+};
+
+YUVCoefficients GetYUVCoefficients(ColorMatrix matrix, ColorRange range);
+
+/**
+ * The matrix that ColorMatrix::Auto stands for with frames of a format and
+ * transfer function; any other matrix is returned as it is
+ */
+ColorMatrix ResolveColorMatrix(ColorMatrix matrix, VideoFormat format,
+			       ColorTransfer transfer);
+
+/** RGB to YUV coefficients, with 15 fractional bits */
+struct RGBCoefficients {
+	int16_t yr, yg, yb;
+	int16_t ur, ug, ub;
+	int16_t vr, vg, vb;
+
+	/** Black level of luma */
+	int16_t yOffset;
+};
+
+RGBCoefficients GetRGBCoefficients(ColorMatrix matrix, ColorRange range);
+
+/**
+ * Tables for tone mapping HDR to SDR.  32-bit entries, so that SIMD kernels
+ * can gather them.
+ */
+struct TonemapTables {
+	/** 10-bit non-linear RGB to tone mapped linear light (12 bits) */
+	int32_t toLinear[1024];
+
+	/** Linear RGB to BT.709 primaries, 12 fractional bits, row major */
+	int32_t gamut[9];
+
+	/** 12-bit linear light to 8-bit BT.709 non-linear RGB */
+	int32_t toGamma[4096];
+};
+
+/**
+ * Returns the (static) tables for tone mapping video with the given
+ * transfer function and matrix, or nullptr for SDR
+ */
+const TonemapTables *GetTonemapTables(ColorTransfer transfer,
+				      ColorMatrix matrix);
+
+/** Planes of a frame being converted */
+struct ConvertFrame {
+	const unsigned char *src[4];
+	int srcStride[4];
+	unsigned char *dst[4];
+	int dstStride[4];
+	int width;
+	int height;
+
+	/* only used by conversions to and from RGB */
+	YUVCoefficients toRGB;
+	RGBCoefficients toYUV;
+
+	/* only used by conversions from 10-bit to 8-bit */
+	const TonemapTables *tonemap;
+	bool dither;
+
+	/* only used by rotation and scaling, which can work on bands of rows:
+	 * the rows of the frames that src and dst start at */
+	int srcTop;
+	int dstTop;
+
+	/* only used by scaling: width and height are the destination's */
+	int srcWidth;
+	int srcHeight;
+};
+
+/**
+ * Converts rows [rowBegin, rowEnd) of a frame.  When the output has
+ * vertically subsampled chroma, rowBegin must be even.
+ */
+typedef void (*ConvertKernel)(const ConvertFrame &frame, int rowBegin,
+			      int rowEnd);
+
+/**
+ * Returns the fastest kernel for a conversion that the given CPUFeature
+ * flags allow, or nullptr if the conversion isn't supported
+ *
+ * @param  isa  Optionally receives the name of the kernel's instruction set
+ */
+ConvertKernel GetConvertKernel(VideoFormat from, VideoFormat to,
+			       uint32_t cpuFeatures,
+			       const char **isa = nullptr);
+
+/**
+ * Like GetConvertKernel, for conversions that tone map HDR to BT.709 SDR
+ * (ConvertFrame::tonemap and toYUV must be set)
+ */
+ConvertKernel GetTonemapKernel(VideoFormat from, VideoFormat to,
+			       uint32_t cpuFeatures,
+			       const char **isa = nullptr);
+
+/**
+ * Returns the fastest kernel that rotates frames of a format clockwise by
+ * 90, 180 or 270 degrees, or nullptr if that isn't supported.  The kernel
+ * takes rows of the source frame (ConvertFrame::width/height) and writes
+ * them to their place in the rotated frame.  Packed 4:2:2 frames need even
+ * dimensions.
+ */
+ConvertKernel GetRotateKernel(VideoFormat format, int degrees,
+			      uint32_t cpuFeatures,
+			      const char **isa = nullptr);
+
+/**
+ * Returns a kernel that scales frames of a format bilinearly, or nullptr if
+ * that isn't supported.  ConvertFrame::width/height are the destination's
+ * size and srcWidth/srcHeight the source's; the kernel writes destination
+ * rows.
+ */
+ConvertKernel GetScaleKernel(VideoFormat format);
+
+/**
+ * Converts captured frames into another format, in buffers from a pool
+ * that is recreated whenever the frame size or formats change.  Frames are
+ * processed in slices, in parallel if there is an executor.
+ */
+class VideoConverter {
+	VideoFormat from = VideoFormat::Unknown;
+	VideoFormat to = VideoFormat::Unknown;
+	int cx = 0;
+	int cy = 0;
+	ColorMatrix matrix = ColorMatrix::BT709;
+	ColorRange range = ColorRange::Partial;
+	ColorTransfer transfer = ColorTransfer::SDR;
+	bool dither = false;
+	int degrees = 0;
+	int scaleCX = 0;
+	int scaleCY = 0;
+	YUVCoefficients toRGB = {};
+	RGBCoefficients toYUV = {};
+	RGBCoefficients toSDR = {};
+	const TonemapTables *tonemap = nullptr;
+
+	ConvertKernel kernel = nullptr;
+	ConvertKernel rotate = nullptr;
+	ConvertKernel scale = nullptr;
+	const char *isa = nullptr;
+	std::shared_ptr<ChunkPool> pool;
+	size_t frameSize = 0;
+
+	/* band buffers, one after the other for each worker */
+	std::vector<unsigned char> band;
+	std::vector<unsigned char> scaled;
+	size_t bandSize = 0;
+	size_t scaledSize = 0;
+	int bandRows = 0;
+
+	std::shared_ptr<SliceExecutor> executor;
+	long long budgetNs = 0;
+	int priority = 0;
+	int workers = 1;
+	int sliceSetting = 0;
+	int sliceRows = 0;
+	size_t rowBytes = 0;
+
+	unsigned long long frames = 0;
+	long long totalNs = 0;
+	long long maxNs = 0;
+	unsigned long long queuedFrames = 0;
+	long long totalQueueNs = 0;
+	long long maxQueueNs = 0;
+	unsigned long long lateFrames = 0;
+
+	void Reset(VideoFormat from, VideoFormat to, int cx, int cy);
+	void ConvertRotated(const ConvertFrame &convert, int worker,
+			    int rowBegin, int rowEnd);
+	void ScaleBands(const ConvertFrame &convert, int worker, int rowBegin,
+			int rowEnd);
+	void RunSlice(const ConvertFrame &convert, int worker, int rowBegin,
+		      int rowEnd);
+	void Run(FrameRef &frame);
+
+public:
+	/**
+	 * Converts the frame to the given format, replacing its planes and
+	 * owner.  Returns false (leaving the frame as is, uncropped) if there
+	 * is no kernel for the conversion or for the scaling or rotation it
+	 * asks for.  matrix and range describe the YUV side of conversions
+	 * between YUV and RGB.  HDR (PQ or HLG) frames are tone mapped where
+	 * there is a kernel for it; dither applies to 10-bit to 8-bit
+	 * conversions that aren't.  If upright is set, frames are also
+	 * rotated clockwise by FrameRef::rotation (when it is a right angle),
+	 * which is then 0.  The pipeline's
+	 * crop is applied first and its scaling between conversion and
+	 * rotation, all in one pass.  Frames that are only cropped are
+	 * described in place, unless cropInPlace is false, in which case they
+	 * are left as they are.
+	 */
+	bool Convert(FrameRef &frame, VideoFormat format,
+		     ColorMatrix matrix = ColorMatrix::BT709,
+		     ColorRange range = ColorRange::Partial,
+		     ColorTransfer transfer = ColorTransfer::SDR,
+		     bool dither = false, bool upright = false,
+		     const VideoPipeline &pipeline = VideoPipeline(),
+		     bool cropInPlace = true);
+
+	/**
+	 * Selects the kernels and allocates the buffers for converting frames
+	 * of a format and size (after cropping) as Convert would, so that is
+	 * done once ahead of the first frame.  Only the executor's thread
+	 * count can change later without selecting them again.  Returns false
+	 * if there is no kernel for the conversion.
+	 */
+	bool Prepare(VideoFormat from, int cx, int cy, long rotation,
+		     VideoFormat format,
+		     ColorMatrix matrix = ColorMatrix::BT709,
+		     ColorRange range = ColorRange::Partial,
+		     ColorTransfer transfer = ColorTransfer::SDR,
+		     bool dither = false, bool upright = false,
+		     const VideoPipeline &pipeline = VideoPipeline());
+
+	/**
+	 * Copies a frame whose rows run backwards in memory (negative
+	 * linesize, see ReverseVideoFrameRows) into a top-down buffer.  Other
+	 * frames are left as they are.  Only single plane formats are
+	 * supported.
+	 */
+	bool Flip(FrameRef &frame);
+
+	/**
+	 * Runs the slices of each frame on the executor's threads, or on the
+	 * calling thread if executor is null.  Frames are due a frame
+	 * interval (in 100-nanosecond units, 0 for none) after they arrive.
+	 */
+	inline void
+	SetExecutor(std::shared_ptr<SliceExecutor> executor_,
+		    ProcessingPriority priority_ = ProcessingPriority::Normal,
+		    long long frameInterval = 0)
+	{
+		executor = std::move(executor_);
+		priority = (int)priority_;
+		budgetNs = frameInterval * 100;
+	}
+
+	/** Whether frames are currently being converted */
+	inline bool Active() const { return kernel || rotate || scale; }
+
+	void GetStats(StreamStats &stats) const;
+	void ResetStats();
+};
+
+}; /* namespace DShow */
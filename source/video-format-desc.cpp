@@ -0,0 +1,243 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "video-format-desc.hpp"
+
+namespace DShow {
+
+#define RGB_SUBTYPE(data1)                               \
+	FormatGUID                                       \
+	{                                                \
+		data1, 0x524F, 0x11CE,                   \
+		{                                        \
+			0x9F, 0x53, 0x00, 0x20, 0xAF, 0x0B, \
+				0xA7, 0x70               \
+		}                                        \
+	}
+
+#define FOURCC(a, b, c, d) MakeFourCC(a, b, c, d)
+#define FOURCC_FORMAT(a, b, c, d) \
+	FOURCC(a, b, c, d), FourCCSubType(FOURCC(a, b, c, d))
+
+static constexpr FormatGUID subTypeRGB24 = RGB_SUBTYPE(0xE436EB7D);
+static constexpr FormatGUID subTypeRGB32 = RGB_SUBTYPE(0xE436EB7E);
+static constexpr FormatGUID subTypeARGB32 = {
+	0x773C9AC0,
+	0x3274,
+	0x11D0,
+	{0xB7, 0x24, 0x00, 0xAA, 0x00, 0x6C, 0x1A, 0x01}};
+
+static constexpr VideoFormatDesc formatDescs[] = {
+	/* raw formats */
+	{VideoFormat::ARGB, FOURCC('A', 'R', 'G', 'B'), subTypeARGB32, 32, 1, 1,
+	 {{1, 1, 4}}},
+	{VideoFormat::XRGB, FOURCC('R', 'G', 'B', '4'), subTypeRGB32, 32, 1, 1,
+	 {{1, 1, 4}}},
+	/* DIB rows are DWORD aligned */
+	{VideoFormat::RGB24, 0, subTypeRGB24, 24, 4, 1, {{1, 1, 3}}},
+	{VideoFormat::RGBA, 0, {}, 32, 1, 1, {{1, 1, 4}}},
+
+	/* planar YUV formats */
+	{VideoFormat::I420, FOURCC_FORMAT('I', '4', '2', '0'), 12, 1, 3,
+	 {{1, 1, 1}, {2, 2, 1}, {2, 2, 1}}},
+	{VideoFormat::NV12, FOURCC_FORMAT('N', 'V', '1', '2'), 12, 1, 2,
+	 {{1, 1, 1}, {2, 2, 2}}},
+	{VideoFormat::YV12, FOURCC_FORMAT('Y', 'V', '1', '2'), 12, 1, 3,
+	 {{1, 1, 1}, {2, 2, 1}, {2, 2, 1}}},
+	{VideoFormat::Y800, FOURCC_FORMAT('Y', '8', '0', '0'), 8, 1, 1,
+	 {{1, 1, 1}}},
+	{VideoFormat::P010, FOURCC_FORMAT('P', '0', '1', '0'), 24, 1, 2,
+	 {{1, 1, 2}, {2, 2, 4}}},
+
+	/* packed YUV formats */
+	{VideoFormat::YVYU, FOURCC_FORMAT('Y', 'V', 'Y', 'U'), 16, 1, 1,
+	 {{2, 1, 4}}},
+	{VideoFormat::YUY2, FOURCC_FORMAT('Y', 'U', 'Y', '2'), 16, 1, 1,
+	 {{2, 1, 4}}},
+	{VideoFormat::UYVY, FOURCC_FORMAT('U', 'Y', 'V', 'Y'), 16, 1, 1,
+	 {{2, 1, 4}}},
+	{VideoFormat::HDYC, FOURCC_FORMAT('H', 'D', 'Y', 'C'), 16, 1, 1,
+	 {{2, 1, 4}}},
+
+	/* encoded formats */
+	{VideoFormat::MJPEG, FOURCC_FORMAT('M', 'J', 'P', 'G'), 0, 1, 0, {}},
+	{VideoFormat::H264, FOURCC_FORMAT('H', '2', '6', '4'), 0, 1, 0, {}},
+#ifdef ENABLE_HEVC
+	{VideoFormat::HEVC, FOURCC_FORMAT('H', 'E', 'V', 'C'), 0, 1, 0, {}},
+#endif
+};
+
+struct FourCCAlias {
+	uint32_t fourCC;
+	VideoFormat format;
+};
+
+/* other names devices use for the same layouts */
+static constexpr FourCCAlias fourCCAliases[] = {
+	{FOURCC('R', 'G', 'B', '2'), VideoFormat::XRGB},
+	{FOURCC('I', 'Y', 'U', 'V'), VideoFormat::I420},
+};
+
+/* ------------------------------------------------------------------------ */
+
+/* open addressing, at most a quarter full */
+#define HASH_BITS 6
+#define HASH_SIZE (1 << HASH_BITS)
+
+static inline uint32_t HashSlot(uint32_t key)
+{
+	return (key * 0x9E3779B1u) >> (32 - HASH_BITS);
+}
+
+static inline uint32_t HashGUID(const FormatGUID &guid)
+{
+	uint32_t key = guid.data1 ^ ((uint32_t)guid.data2 << 16) ^ guid.data3;
+	for (int i = 0; i < 8; i++)
+		key = key * 31 + guid.data4[i];
+	return key;
+}
+
+static inline bool SameGUID(const FormatGUID &a, const FormatGUID &b)
+{
+	if (a.data1 != b.data1 || a.data2 != b.data2 || a.data3 != b.data3)
+		return false;
+
+	for (int i = 0; i < 8; i++) {
+		if (a.data4[i] != b.data4[i])
+			return false;
+	}
+
+	return true;
+}
+
+static inline bool EmptyGUID(const FormatGUID &guid)
+{
+	return SameGUID(guid, FormatGUID());
+}
+
+class FormatTables {
+	struct FourCCSlot {
+		uint32_t fourCC;
+		VideoFormat format;
+	};
+
+	struct SubTypeSlot {
+		FormatGUID subType;
+		VideoFormat format;
+	};
+
+	const VideoFormatDesc *descs[HASH_SIZE] = {};
+	FourCCSlot fourCCs[HASH_SIZE] = {};
+	SubTypeSlot subTypes[HASH_SIZE] = {};
+
+	void AddFourCC(uint32_t fourCC, VideoFormat format)
+	{
+		uint32_t i = HashSlot(fourCC);
+		while (fourCCs[i].format != VideoFormat::Any)
+			i = (i + 1) & (HASH_SIZE - 1);
+		fourCCs[i] = {fourCC, format};
+	}
+
+	void AddSubType(const FormatGUID &subType, VideoFormat format)
+	{
+		uint32_t i = HashSlot(HashGUID(subType));
+		while (subTypes[i].format != VideoFormat::Any)
+			i = (i + 1) & (HASH_SIZE - 1);
+		subTypes[i] = {subType, format};
+	}
+
+public:
+	FormatTables()
+	{
+		for (const VideoFormatDesc &desc : formatDescs) {
+			uint32_t i = HashSlot((uint32_t)desc.format);
+			while (descs[i])
+				i = (i + 1) & (HASH_SIZE - 1);
+			descs[i] = &desc;
+
+			if (desc.fourCC)
+				AddFourCC(desc.fourCC, desc.format);
+			if (!EmptyGUID(desc.subType))
+				AddSubType(desc.subType, desc.format);
+		}
+
+		for (const FourCCAlias &alias : fourCCAliases) {
+			AddFourCC(alias.fourCC, alias.format);
+			AddSubType(FourCCSubType(alias.fourCC), alias.format);
+		}
+	}
+
+	const VideoFormatDesc *Desc(VideoFormat format) const
+	{
+		uint32_t i = HashSlot((uint32_t)format);
+		for (; descs[i]; i = (i + 1) & (HASH_SIZE - 1)) {
+			if (descs[i]->format == format)
+				return descs[i];
+		}
+
+		return nullptr;
+	}
+
+	VideoFormat FromFourCC(uint32_t fourCC) const
+	{
+		uint32_t i = HashSlot(fourCC);
+		for (; fourCCs[i].format != VideoFormat::Any;
+		     i = (i + 1) & (HASH_SIZE - 1)) {
+			if (fourCCs[i].fourCC == fourCC)
+				return fourCCs[i].format;
+		}
+
+		return VideoFormat::Unknown;
+	}
+
+	VideoFormat FromSubType(const FormatGUID &subType) const
+	{
+		uint32_t i = HashSlot(HashGUID(subType));
+		for (; subTypes[i].format != VideoFormat::Any;
+		     i = (i + 1) & (HASH_SIZE - 1)) {
+			if (SameGUID(subTypes[i].subType, subType))
+				return subTypes[i].format;
+		}
+
+		return VideoFormat::Unknown;
+	}
+};
+
+static const FormatTables &GetTables()
+{
+	static const FormatTables tables;
+	return tables;
+}
+
+const VideoFormatDesc *GetVideoFormatDesc(VideoFormat format)
+{
+	return GetTables().Desc(format);
+}
+
+VideoFormat FourCCToVideoFormat(uint32_t fourCC)
+{
+	return fourCC ? GetTables().FromFourCC(fourCC) : VideoFormat::Unknown;
+}
+
+VideoFormat SubTypeToVideoFormat(const FormatGUID &subType)
+{
+	return GetTables().FromSubType(subType);
+}
+
+}; /* namespace DShow */
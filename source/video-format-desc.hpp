@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DShow {
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) |
+	       ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+/** Laid out like a Windows GUID, so subtypes can be described anywhere */
+struct FormatGUID {
+	uint32_t data1;
+	uint16_t data2;
+	uint16_t data3;
+	uint8_t data4[8];
+};
+
+/** Media subtype of a FOURCC format, XXXXXXXX-0000-0010-8000-00AA00389B71 */
+constexpr FormatGUID FourCCSubType(uint32_t fourCC)
+{
+	return FormatGUID{fourCC,
+			  0x0000,
+			  0x0010,
+			  {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+}
+
+/**
+ * Samples of a plane, in blocks of blockWidth x blockHeight pixels that
+ * take up blockBytes each.  Chroma subsampled 2x2 is a block of 2x2, and a
+ * packed 4:2:2 pixel pair a block of 2x1 taking 4 bytes.
+ */
+struct VideoPlaneDesc {
+	uint8_t blockWidth;
+	uint8_t blockHeight;
+	uint8_t blockBytes;
+};
+
+/** Everything the library knows about the layout of a VideoFormat */
+struct VideoFormatDesc {
+	VideoFormat format;
+
+	/** biCompression of the bitmap header, 0 (BI_RGB) if none */
+	uint32_t fourCC;
+
+	/** DirectShow media subtype, all zero if none */
+	FormatGUID subType;
+
+	/** biBitCount, average bits per pixel */
+	uint16_t bits;
+
+	/** Rows of every plane are padded to a multiple of this many bytes */
+	uint8_t rowAlign;
+
+	/** Planes of tightly packed frames, 0 for encoded formats */
+	uint8_t planes;
+	VideoPlaneDesc plane[3];
+
+	inline size_t RowBytes(int index, int cx) const
+	{
+		const VideoPlaneDesc &p = plane[index];
+		size_t blocks = ((size_t)cx + p.blockWidth - 1) / p.blockWidth;
+		size_t bytes = blocks * p.blockBytes;
+		return (bytes + rowAlign - 1) / rowAlign * rowAlign;
+	}
+
+	inline int PlaneRows(int index, int cy) const
+	{
+		const VideoPlaneDesc &p = plane[index];
+		return (cy + p.blockHeight - 1) / p.blockHeight;
+	}
+};
+
+/** Returns the description of a format, or nullptr if it has none */
+const VideoFormatDesc *GetVideoFormatDesc(VideoFormat format);
+
+/** Format of a bitmap header's biCompression, or VideoFormat::Unknown */
+VideoFormat FourCCToVideoFormat(uint32_t fourCC);
+
+/** Format of a media subtype, or VideoFormat::Unknown */
+VideoFormat SubTypeToVideoFormat(const FormatGUID &subType);
+
+}; /* namespace DShow */
@@ -0,0 +1,2245 @@
+/*
+ *  Copyright (C) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+/*
+ * dshowcapture-bench measures the conversion, tone mapping and rotation
+ * kernels of each instruction set tier the CPU has, and checks their output
+ * against the C kernels bit for bit.  It also times ways of doing the same
+ * job against each other:
+ *
+ *   render  converting straight into an output sample (LockFrame) versus
+ *           into a buffer that is then copied into it (SendFrame)
+ *   packet  reassembling encoded packets in pooled chunks (PacketAssembler)
+ *           versus appending to a vector, as EncodedData used to
+ *   fused   cropping, converting, scaling and rotating a frame in one pass
+ *           (VideoConverter with a pipeline) versus a pass for each
+ *   queue   handing frames to another thread through the lock-free ring of
+ *           FrameDispatcher versus a queue guarded by a mutex (and calling
+ *           the consumer directly): the time a burst takes to go through,
+ *           and the mean time one frame takes to reach an idle consumer
+ *
+ * Results are written as JSON.
+ *
+ *   dshowcapture-bench [--check]
+ *                      [--op convert|tonemap|rotate|render|packet|fused|
+ *                            queue]
+ *                      [--from FORMAT] [--to FORMAT]
+ *                      [--sizes 1280x720,1920x1080] [--threads 1,4]
+ *                      [--time MS] [--output FILE]
+ *
+ * --check only verifies things, and exits with 1 if any of them fails:
+ *
+ *   - the kernels' output, against the C kernels' bit for bit
+ *   - bottom-up RGB frames (described with negative strides, as captured
+ *     and output samples are) going through VideoConverter and CopyPlane
+ *   - crops, which are only applied along with the stages after them
+ *   - ConvertVideoFrame picking the matrix for ColorMatrix::Auto
+ *   - SliceExecutor running jobs for many threads at once
+ *   - SPSCRing keeping its items in order as its positions wrap around
+ *   - the parts of capture that don't need a device: what keeps frames
+ *     alive, the queue policies of FrameDispatcher, PropertyMonitor,
+ *     AccessUnitDetector, TimestampSynthesizer, TimestampNormalizer,
+ *     TimestampSmoother and ClockDomainEstimator
+ */
+
+#include "../source/access-unit-detector.hpp"
+#include "../source/clock-domain.hpp"
+#include "../source/cpu-features.hpp"
+#include "../source/frame-dispatcher.hpp"
+#include "../source/frame-ref.hpp"
+#include "../source/packet-assembler.hpp"
+#include "../source/plane-copy.hpp"
+#include "../source/property-monitor.hpp"
+#include "../source/slice-executor.hpp"
+#include "../source/spsc-ring.hpp"
+#include "../source/timestamp-normalizer.hpp"
+#include "../source/timestamp-smoother.hpp"
+#include "../source/timestamp-synth.hpp"
+#include "../source/video-convert.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DShow;
+
+/* bytes after each frame that no kernel may write */
+#define GUARD_SIZE 64
+
+/* rows per slice when running on several threads */
+#define SLICE_ROWS 16
+
+struct NamedFormat {
+	VideoFormat format;
+	const char *name;
+};
+
+static const NamedFormat formatNames[] = {
+	{VideoFormat::ARGB, "ARGB"}, {VideoFormat::XRGB, "XRGB"},
+	{VideoFormat::RGB24, "RGB24"}, {VideoFormat::RGBA, "RGBA"},
+	{VideoFormat::I420, "I420"}, {VideoFormat::NV12, "NV12"},
+	{VideoFormat::YV12, "YV12"}, {VideoFormat::Y800, "Y800"},
+	{VideoFormat::P010, "P010"}, {VideoFormat::YVYU, "YVYU"},
+	{VideoFormat::YUY2, "YUY2"}, {VideoFormat::UYVY, "UYVY"},
+	{VideoFormat::HDYC, "HDYC"},
+};
+
+/* in the order they are tried, as named for GetCPUTierFeatures */
+static const char *const tierNames[] = {"c",    "sse2",   "ssse3",
+					"avx2", "avx512", "neon"};
+
+enum class Op { Convert, Tonemap, Rotate, Render, Packet, Fused, Queue };
+
+static const char *const opNames[] = {"convert", "tonemap", "rotate",
+				      "render",  "packet",  "fused",
+				      "queue"};
+
+#define OP_COUNT (int)(sizeof(opNames) / sizeof(opNames[0]))
+
+struct Case {
+	Op op;
+	VideoFormat from;
+	VideoFormat to;
+	int degrees;
+};
+
+struct Size {
+	int cx;
+	int cy;
+};
+
+struct Options {
+	bool checkOnly = false;
+	int op = -1;
+	VideoFormat from = VideoFormat::Any;
+	VideoFormat to = VideoFormat::Any;
+	std::vector<Size> sizes = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	std::vector<int> threads;
+	long long timeNs = 100000000;
+	const char *output = nullptr;
+};
+
+struct Frame {
+	std::vector<unsigned char> data;
+	FrameRef ref;
+	size_t size = 0;
+};
+
+static const char *FormatName(VideoFormat format)
+{
+	for (const NamedFormat &entry : formatNames) {
+		if (entry.format == format)
+			return entry.name;
+	}
+
+	return "unknown";
+}
+
+static VideoFormat ParseFormat(const char *name)
+{
+	for (const NamedFormat &entry : formatNames) {
+		if (strcmp(entry.name, name) == 0)
+			return entry.format;
+	}
+
+	return VideoFormat::Unknown;
+}
+
+static bool Packed422(VideoFormat format)
+{
+	return format == VideoFormat::YVYU || format == VideoFormat::YUY2 ||
+	       format == VideoFormat::UYVY || format == VideoFormat::HDYC;
+}
+
+static void AllocFrame(Frame &frame, VideoFormat format, int cx, int cy)
+{
+	frame.size = VideoFrameSize(format, cx, cy);
+	frame.data.assign(frame.size + GUARD_SIZE, 0xCD);
+	frame.ref = FrameRef();
+	frame.ref.videoFormat = format;
+	frame.ref.cx = cx;
+	frame.ref.cy = cy;
+	SetVideoFramePlanes(frame.ref, frame.data.data(), frame.size);
+}
+
+static void FillFrame(Frame &frame, std::mt19937 &rng)
+{
+	for (size_t i = 0; i < frame.size; i++)
+		frame.data[i] = (unsigned char)rng();
+
+	/* P010 samples are in the high 10 bits */
+	if (frame.ref.videoFormat == VideoFormat::P010) {
+		for (size_t i = 0; i < frame.size; i += 2)
+			frame.data[i] &= 0xC0;
+	}
+}
+
+static ConvertKernel GetKernel(const Case &c, uint32_t features,
+			       const char **isa)
+{
+	switch (c.op) {
+	case Op::Convert:
+		return GetConvertKernel(c.from, c.to, features, isa);
+	case Op::Tonemap:
+		return GetTonemapKernel(c.from, c.to, features, isa);
+	case Op::Rotate:
+		return GetRotateKernel(c.from, c.degrees, features, isa);
+	default:
+		break;
+	}
+
+	return nullptr;
+}
+
+static void OutputSize(const Case &c, int cx, int cy, int &outCX,
+		       int &outCY)
+{
+	const bool swap = c.op == Op::Rotate && c.degrees != 180;
+	outCX = swap ? cy : cx;
+	outCY = swap ? cx : cy;
+}
+
+/* the settings VideoConverter gives each kind of kernel, HDR being PQ
+ * BT.2020 */
+static ConvertFrame MakeConvertFrame(const Case &c, const Frame &src,
+				     Frame &dst, bool dither)
+{
+	ConvertFrame frame = {};
+
+	for (int i = 0; i < 4; i++) {
+		frame.src[i] = src.ref.data[i];
+		frame.srcStride[i] = src.ref.linesize[i];
+		frame.dst[i] = dst.ref.data[i];
+		frame.dstStride[i] = dst.ref.linesize[i];
+	}
+
+	frame.width = src.ref.cx;
+	frame.height = src.ref.cy;
+	frame.dither = dither;
+
+	if (c.op == Op::Tonemap) {
+		frame.toRGB = GetYUVCoefficients(ColorMatrix::BT2020,
+						 ColorRange::Partial);
+		frame.toYUV = GetRGBCoefficients(ColorMatrix::BT709,
+						 ColorRange::Partial);
+		frame.tonemap = GetTonemapTables(ColorTransfer::PQ,
+						 ColorMatrix::BT2020);
+	} else {
+		frame.toRGB = GetYUVCoefficients(ColorMatrix::BT709,
+						 ColorRange::Partial);
+		frame.toYUV = GetRGBCoefficients(ColorMatrix::BT709,
+						 ColorRange::Partial);
+	}
+
+	return frame;
+}
+
+static void RunKernel(ConvertKernel kernel, const ConvertFrame &frame,
+		      SliceExecutor *executor)
+{
+	if (!executor) {
+		kernel(frame, 0, frame.height);
+		return;
+	}
+
+	const int slices = (frame.height + SLICE_ROWS - 1) / SLICE_ROWS;
+	executor->Run(slices, [&](int slice, int) {
+		const int begin = slice * SLICE_ROWS;
+		const int end = std::min(begin + SLICE_ROWS, frame.height);
+		kernel(frame, begin, end);
+	});
+}
+
+/* output of the kernel, guard bytes included */
+static std::vector<unsigned char> Output(const Case &c, ConvertKernel kernel,
+					 const Frame &src, bool dither,
+					 SliceExecutor *executor)
+{
+	int outCX, outCY;
+	OutputSize(c, src.ref.cx, src.ref.cy, outCX, outCY);
+
+	Frame dst;
+	AllocFrame(dst, c.to, outCX, outCY);
+	RunKernel(kernel, MakeConvertFrame(c, src, dst, dither), executor);
+	return std::move(dst.data);
+}
+
+/* ------------------------------------------------------------------------ */
+
+static bool Wanted(const Case &c, const Options &options)
+{
+	if (options.op >= 0 && (int)c.op != options.op)
+		return false;
+	if (options.from != VideoFormat::Any && c.from != options.from)
+		return false;
+	return options.to == VideoFormat::Any || c.to == options.to;
+}
+
+static void AddCases(std::vector<Case> &cases, const Options &options)
+{
+	for (const NamedFormat &from : formatNames) {
+		for (const NamedFormat &to : formatNames) {
+			Case c = {Op::Convert, from.format, to.format, 0};
+			if (from.format != to.format &&
+			    GetConvertKernel(c.from, c.to, 0) &&
+			    Wanted(c, options))
+				cases.push_back(c);
+
+			c.op = Op::Tonemap;
+			if (GetTonemapKernel(c.from, c.to, 0) &&
+			    Wanted(c, options))
+				cases.push_back(c);
+		}
+
+		for (int degrees = 90; degrees < 360; degrees += 90) {
+			Case c = {Op::Rotate, from.format, from.format,
+				  degrees};
+			if (GetRotateKernel(c.from, degrees, 0) &&
+			    Wanted(c, options))
+				cases.push_back(c);
+		}
+	}
+}
+
+/* tiers the CPU has, as the feature flags that select them */
+static std::vector<uint32_t> GetTiers()
+{
+	const uint32_t available = GetCPUFeatures();
+	std::vector<uint32_t> tiers;
+
+	for (const char *name : tierNames) {
+		uint32_t features = GetCPUTierFeatures(name);
+		if ((features & available) == features)
+			tiers.push_back(features);
+	}
+
+	return tiers;
+}
+
+/* even sizes, as packed 4:2:2 rotation needs, that leave a remainder for
+ * every vector width */
+static const Size checkSizes[] = {
+	{2, 2}, {34, 6}, {66, 4}, {130, 10}, {322, 18}, {1922, 34},
+};
+
+static bool Check(const Case &c, ConvertKernel kernel, ConvertKernel scalar,
+		  std::mt19937 &rng)
+{
+	for (const Size &size : checkSizes) {
+		Frame src;
+		AllocFrame(src, c.from, size.cx, size.cy);
+		FillFrame(src, rng);
+
+		for (int dither = 0; dither < 2; dither++) {
+			if (Output(c, kernel, src, !!dither, nullptr) !=
+			    Output(c, scalar, src, !!dither, nullptr))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/* planes of a frame, one row after the other, top row first */
+static std::vector<unsigned char> FrameBytes(const FrameRef &frame)
+{
+	std::vector<unsigned char> bytes;
+
+	for (int i = 0; i < DSHOW_MAX_PLANES && frame.data[i]; i++) {
+		const int stride = frame.linesize[i];
+		const size_t rowSize = (size_t)std::abs(stride);
+		const int rows =
+			VideoPlaneHeight(frame.videoFormat, i, frame.cy);
+
+		for (int y = 0; y < rows; y++) {
+			const unsigned char *row =
+				frame.data[i] + (ptrdiff_t)y * stride;
+			bytes.insert(bytes.end(), row, row + rowSize);
+		}
+	}
+
+	return bytes;
+}
+
+/* a copy of a single plane frame with its rows the other way up */
+static void FlipFrame(const Frame &src, Frame &dst)
+{
+	AllocFrame(dst, src.ref.videoFormat, src.ref.cx, src.ref.cy);
+
+	const size_t rowSize = (size_t)src.ref.linesize[0];
+	for (int y = 0; y < src.ref.cy; y++)
+		memcpy(dst.ref.data[0] + (src.ref.cy - 1 - y) * rowSize,
+		       src.ref.data[0] + y * rowSize, rowSize);
+}
+
+/* bottom-up RGB frames, described top-down with ReverseVideoFrameRows as
+ * Device::Receive and LockFrame do, must convert and flip to what the C
+ * kernels make of the same rows stored top-down */
+static bool CheckBottomUp(std::mt19937 &rng)
+{
+	bool exact = true;
+
+	for (const NamedFormat &from : formatNames) {
+		if (!VideoFrameBottomUp(from.format, false))
+			continue;
+
+		for (const Size &size : checkSizes) {
+			Frame stored, upright;
+			AllocFrame(stored, from.format, size.cx, size.cy);
+			FillFrame(stored, rng);
+			FlipFrame(stored, upright);
+
+			FrameRef reversed = stored.ref;
+			ReverseVideoFrameRows(reversed);
+			exact = exact &&
+				VideoFrameBuffer(reversed) ==
+					stored.data.data() &&
+				FrameBytes(reversed) ==
+					FrameBytes(upright.ref);
+
+			VideoConverter flipper;
+			FrameRef flipped = reversed;
+			exact = exact && flipper.Flip(flipped) &&
+				flipped.linesize[0] > 0 &&
+				FrameBytes(flipped) == FrameBytes(upright.ref);
+
+			for (const NamedFormat &to : formatNames) {
+				const Case c = {Op::Convert, from.format,
+						to.format, 0};
+				ConvertKernel scalar = GetKernel(c, 0, nullptr);
+				if (from.format == to.format || !scalar)
+					continue;
+
+				Frame expected;
+				AllocFrame(expected, to.format, size.cx,
+					   size.cy);
+				RunKernel(scalar,
+					  MakeConvertFrame(c, upright, expected,
+							   false),
+					  nullptr);
+
+				VideoConverter converter;
+				FrameRef converted = reversed;
+				exact = exact &&
+					converter.Convert(converted,
+							  to.format) &&
+					FrameBytes(converted) ==
+						FrameBytes(expected.ref);
+			}
+		}
+
+		if (!exact) {
+			fprintf(stderr, "MISMATCH bottom-up %s\n", from.name);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* CopyPlane with either stride negative must copy the rows the other way
+ * up, and write nothing between the rows of a padded destination.  The
+ * last size is large enough to be copied with non-temporal stores. */
+static bool CheckCopyPlane(std::mt19937 &rng)
+{
+	static const Size sizes[] = {{1, 1}, {67, 5}, {1922, 300}};
+	const int padding = 48;
+
+	for (const Size &size : sizes) {
+		const int rowBytes = size.cx * 4;
+		std::vector<unsigned char> src((size_t)rowBytes * size.cy);
+		for (unsigned char &byte : src)
+			byte = (unsigned char)rng();
+
+		for (int dstPadding = 0; dstPadding <= padding;
+		     dstPadding += padding) {
+			const int stride = rowBytes + dstPadding;
+			std::vector<unsigned char> expected(
+				(size_t)stride * size.cy + GUARD_SIZE, 0xCD);
+			for (int y = 0; y < size.cy; y++)
+				memcpy(&expected[(size_t)(size.cy - 1 - y) *
+						 stride],
+				       &src[(size_t)y * rowBytes], rowBytes);
+
+			const unsigned char *lastSrc =
+				&src[(size_t)(size.cy - 1) * rowBytes];
+
+			/* from a reversed source */
+			std::vector<unsigned char> dst(expected.size(), 0xCD);
+			CopyPlane(dst.data(), stride, lastSrc, -rowBytes,
+				  (size_t)rowBytes, size.cy);
+			if (dst != expected)
+				return false;
+
+			/* into a reversed destination */
+			dst.assign(expected.size(), 0xCD);
+			CopyPlane(&dst[(size_t)(size.cy - 1) * stride],
+				  -stride, src.data(), rowBytes,
+				  (size_t)rowBytes, size.cy);
+			if (dst != expected)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool SameFrame(const FrameRef &a, const FrameRef &b)
+{
+	return a.data[0] == b.data[0] && a.linesize[0] == b.linesize[0] &&
+	       a.cx == b.cx && a.cy == b.cy && a.size == b.size &&
+	       a.videoFormat == b.videoFormat;
+}
+
+/* ConvertVideoFrame takes ColorMatrix::Auto as BT.2020 for HDR P010 and
+ * as BT.709 otherwise */
+static bool CheckAutoMatrix(std::mt19937 &rng)
+{
+	const ColorMatrix matrices[] = {ColorMatrix::Auto, ColorMatrix::BT2020,
+					ColorMatrix::BT709};
+	Frame src;
+	AllocFrame(src, VideoFormat::P010, 64, 32);
+	FillFrame(src, rng);
+
+	auto convert = [&](VideoFormat to, ColorMatrix matrix,
+			   ColorTransfer transfer) {
+		Frame dst;
+		AllocFrame(dst, to, 64, 32);
+		if (!ConvertVideoFrame(src.ref.data, src.ref.linesize,
+				       VideoFormat::P010, dst.ref.data,
+				       dst.ref.linesize, to, 64, 32, matrix,
+				       ColorRange::Partial, transfer))
+			dst.data.clear();
+		return dst.data;
+	};
+
+	std::vector<unsigned char> pq[3], sdr[3];
+	for (int i = 0; i < 3; i++) {
+		pq[i] = convert(VideoFormat::NV12, matrices[i],
+				ColorTransfer::PQ);
+		sdr[i] = convert(VideoFormat::ARGB, matrices[i],
+				 ColorTransfer::SDR);
+	}
+
+	return !pq[0].empty() && pq[0] == pq[1] && pq[0] != pq[2] &&
+	       !sdr[0].empty() && sdr[0] == sdr[2] && sdr[0] != sdr[1];
+}
+
+/* a crop is only applied along with the stages after it, so that a frame
+ * that can't be scaled or rotated comes back as captured, not cropped to
+ * a size its strides don't match */
+static bool CheckPipeline(std::mt19937 &rng)
+{
+	Frame src;
+	AllocFrame(src, VideoFormat::YUY2, 64, 32);
+	FillFrame(src, rng);
+
+	VideoPipeline crop;
+	crop.cropX = 8;
+	crop.cropY = 8;
+	crop.cropCX = 32;
+	crop.cropCY = 16;
+
+	VideoPipeline scale = crop;
+	scale.scaleCX = 16;
+	scale.scaleCY = 8;
+
+	/* packed 4:2:2 isn't scaled */
+	bool ok = true;
+	for (int inPlace = 0; inPlace < 2; inPlace++) {
+		VideoConverter converter;
+		FrameRef frame = src.ref;
+		ok = ok &&
+		     !converter.Convert(frame, VideoFormat::Any,
+					ColorMatrix::BT709, ColorRange::Partial,
+					ColorTransfer::SDR, false, false, scale,
+					!!inPlace) &&
+		     SameFrame(frame, src.ref);
+	}
+
+	/* nor rotated with odd dimensions */
+	VideoPipeline odd = crop;
+	odd.cropCY = 15;
+	{
+		VideoConverter converter;
+		FrameRef frame = src.ref;
+		frame.rotation = 90;
+		ok = ok &&
+		     !converter.Convert(frame, VideoFormat::Any,
+					ColorMatrix::BT709, ColorRange::Partial,
+					ColorTransfer::SDR, false, true, odd,
+					false) &&
+		     SameFrame(frame, src.ref) && frame.rotation == 90;
+	}
+
+	/* only cropped, in place or not at all */
+	for (int inPlace = 0; inPlace < 2; inPlace++) {
+		VideoConverter converter;
+		FrameRef frame = src.ref;
+		ok = ok &&
+		     converter.Convert(frame, VideoFormat::Any,
+				       ColorMatrix::BT709, ColorRange::Partial,
+				       ColorTransfer::SDR, false, false, crop,
+				       !!inPlace) &&
+		     (inPlace ? frame.cx == 32 && frame.cy == 16 &&
+					frame.data[0] == src.ref.data[0] +
+								 8 * 128 + 16
+			      : SameFrame(frame, src.ref));
+	}
+
+	VideoConverter converter;
+	FrameRef frame = src.ref;
+	return ok &&
+	       converter.Convert(frame, VideoFormat::I420, ColorMatrix::BT709,
+				 ColorRange::Partial, ColorTransfer::SDR, false,
+				 false, scale, false) &&
+	       frame.videoFormat == VideoFormat::I420 && frame.cx == 16 &&
+	       frame.cy == 8 && frame.linesize[0] == 16;
+}
+
+/* several threads running jobs of different priorities and sizes on one
+ * executor at once, as devices do, must each get every slice of their job
+ * run exactly once, and only while their Run call is waiting for it */
+static bool CheckExecutor()
+{
+	const int callers = 6;
+	const int jobsPerCaller = 200;
+	SliceExecutor executor(4);
+	std::atomic<bool> exact{true};
+	std::vector<std::thread> threads;
+
+	for (int caller = 0; caller < callers; caller++) {
+		threads.emplace_back([&, caller]() {
+			std::mt19937 rng(caller + 1);
+
+			for (int job = 0; job < jobsPerCaller; job++) {
+				const int count = 1 + rng() % 97;
+				const int priority = (int)(rng() % 3) - 1;
+				const long long budgetNs =
+					rng() % 2 ? (long long)(rng() % 200000)
+						  : 0;
+				std::unique_ptr<std::atomic<int>[]> runs(
+					new std::atomic<int>[count]);
+				for (int i = 0; i < count; i++)
+					runs[i] = 0;
+
+				std::atomic<bool> running{true};
+				auto proc = [&](int slice, int worker) {
+					if (slice < 0 || slice >= count ||
+					    worker < 0 ||
+					    worker >= executor.Workers() ||
+					    !running)
+						exact = false;
+					else
+						runs[slice]++;
+				};
+
+				executor.Run(count, proc, priority, budgetNs);
+				running = false;
+
+				for (int i = 0; i < count; i++) {
+					if (runs[i] != 1)
+						exact = false;
+				}
+			}
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	return exact;
+}
+
+/* ------------------------------------------------------------------------ */
+
+/* stands in for an IMediaSample */
+struct FakeSample {
+	std::atomic<long> refs{1};
+
+	void AddRef() { refs++; }
+	void Release() { refs--; }
+};
+
+/* frames hold their sample until the last copy of them is gone, converted
+ * frames let go of it and keep their own buffer, and the dispatcher hands
+ * on owned frames as they are but copies the ones without an owner */
+static bool CheckFrameRefs(std::mt19937 &rng)
+{
+	FakeSample sample;
+	bool ok = true;
+
+	{
+		FrameRef frame;
+		frame.owner = MakeSampleOwner(&sample);
+		FrameRef copy = frame;
+		frame.Release();
+		ok = ok && sample.refs == 2 && copy.Valid();
+	}
+	ok = ok && sample.refs == 1;
+
+	const Case c = {Op::Convert, VideoFormat::YUY2, VideoFormat::I420, 0};
+	Frame src, expected;
+	AllocFrame(src, c.from, 66, 10);
+	FillFrame(src, rng);
+	AllocFrame(expected, c.to, 66, 10);
+	RunKernel(GetKernel(c, 0, nullptr),
+		  MakeConvertFrame(c, src, expected, false), nullptr);
+
+	FrameRef converted = src.ref;
+	converted.owner = MakeSampleOwner(&sample);
+	{
+		VideoConverter converter;
+		ok = ok && converter.Convert(converted, c.to);
+	}
+	std::fill(src.data.begin(), src.data.end(), 0);
+	ok = ok && sample.refs == 1 && converted.Valid() &&
+	     FrameBytes(converted) == FrameBytes(expected.ref);
+	converted.Release();
+
+	FillFrame(src, rng);
+	const std::vector<unsigned char> original = FrameBytes(src.ref);
+	std::vector<FrameRef> delivered;
+
+	/* only the planes' addresses are kept, not the frames */
+	auto deliver = [&](const FrameRef &frame) {
+		delivered.push_back(frame);
+		delivered.back().owner.reset();
+		if (frame.owner.get() != &sample)
+			ok = ok && FrameBytes(frame) == original;
+	};
+
+	FrameDispatcher dispatcher;
+	dispatcher.Start(4, QueuePolicy::DropNewest, 0, deliver);
+
+	FrameRef owned = src.ref;
+	owned.owner = MakeSampleOwner(&sample);
+	ok = ok && dispatcher.Push(std::move(owned));
+
+	FrameRef borrowed = src.ref;
+	ok = ok && dispatcher.Push(std::move(borrowed));
+	std::fill(src.data.begin(), src.data.end(), 0);
+
+	dispatcher.Stop();
+
+	return ok && sample.refs == 1 && delivered.size() == 2 &&
+	       delivered[0].data[0] == src.ref.data[0] &&
+	       delivered[1].data[0] != src.ref.data[0];
+}
+
+/* polls on its own thread until stopped, and keeps the last values */
+static bool CheckPropertyMonitor()
+{
+	PropertyMonitor monitor;
+	std::atomic<int> polls{0};
+
+	monitor.Start(1, [&](DeviceProperties &props) {
+		const int poll = ++polls;
+		props.roll = -90 * poll;
+		props.hdr = poll % 2 == 0;
+	});
+
+	bool ok = polls >= 1 && monitor.Running();
+
+	for (int i = 0; i < 2000 && polls < 5; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	monitor.Stop();
+	const int last = polls;
+	const DeviceProperties props = monitor.Get();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	monitor.Update();
+
+	return ok && last >= 5 && polls == last && !monitor.Running() &&
+	       props.roll == -90 * last && props.hdr == (last % 2 == 0);
+}
+
+/* untimed samples follow on from the last one until they fall more than
+ * four samples (and at least 100ms) behind their arrival, then snap to it */
+static bool CheckTimestampSynth()
+{
+	const long long frame = 333333;
+	const long long base = 1000000, arrival = 5000000;
+	TimestampSynthesizer synth;
+	long long start, stop;
+	bool ok = true;
+
+	synth.Observe(base, base + frame, frame, arrival);
+
+	synth.Synthesize(arrival + frame, frame, start, stop);
+	ok = ok && start == base + frame && stop == base + frame * 2;
+
+	/* three frames late */
+	synth.Synthesize(arrival + frame * 5, frame, start, stop);
+	ok = ok && start == base + frame * 2;
+
+	/* frames were dropped */
+	synth.Synthesize(arrival + frame * 20, frame, start, stop);
+	ok = ok && start == base + frame * 20;
+
+	/* exactly four frames late is not too late */
+	synth.Synthesize(arrival + frame * 25, frame, start, stop);
+	ok = ok && start == base + frame * 21;
+
+	/* short samples may fall 100ms behind */
+	const long long sample = 10000;
+	synth.Observe(base, base + sample, sample, arrival);
+	synth.Synthesize(arrival + sample + 1000000, sample, start, stop);
+	ok = ok && start == base + sample;
+	synth.Synthesize(arrival + sample * 2 + 1000001, sample, start, stop);
+	ok = ok && start == base + sample * 2 + 1000001;
+
+	/* without a duration, never before the last sample */
+	synth.Synthesize(arrival, 0, start, stop);
+	ok = ok && start == stop && start == base + sample * 3 + 1000001;
+
+	synth.Reset();
+	synth.Synthesize(arrival, frame, start, stop);
+	return ok && start == 0 && stop == frame;
+}
+
+typedef std::vector<std::vector<unsigned char>> Segments;
+
+static void AddNal(std::vector<unsigned char> &segment,
+		   std::initializer_list<unsigned char> header, size_t payload)
+{
+	const unsigned char startCode[] = {0, 0, 0, 1};
+	segment.insert(segment.end(), startCode, startCode + 4);
+	segment.insert(segment.end(), header);
+	segment.insert(segment.end(), payload, 0xAA);
+}
+
+static void AddADTS(std::vector<unsigned char> &segment, size_t length)
+{
+	const unsigned char header[] = {
+		0xFF,
+		0xF1,
+		0x50,
+		(unsigned char)(0x80 | (length >> 11)),
+		(unsigned char)(length >> 3),
+		(unsigned char)((length << 5) | 0x1F),
+		0xFC};
+	segment.insert(segment.end(), header, header + 7);
+	segment.insert(segment.end(), length - 7, 0xAA);
+}
+
+/* feeds a unit's segments, the first of them timed, the way capture does
+ * and returns the segment the unit was complete after, or -1 */
+static int FeedUnit(AccessUnitDetector &detector, const Segments &segments,
+		    int &splits)
+{
+	int complete = -1;
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		const unsigned char *data = segments[i].data();
+		size_t size = segments[i].size();
+
+		if (!i) {
+			detector.BeginUnit(data, size);
+		} else if (!detector.ContinueUnit(data, size)) {
+			detector.BeginUnit(data, size);
+			splits++;
+		}
+
+		detector.Parse(data, size);
+		if (detector.Complete()) {
+			detector.SentEarly();
+			if (complete < 0)
+				complete = (int)i;
+		}
+	}
+
+	return complete;
+}
+
+/* video units are complete after the segment with their last slice once a
+ * run of them has shown how many slices they have, AAC units after their
+ * last ADTS frame; units that continue past that are never predicted, and
+ * one that turns out to continue after it was sent stops the predicting */
+static bool CheckAccessUnits()
+{
+	AccessUnitDetector detector;
+	bool ok = true;
+	int splits = 0;
+
+	/* H.264: a delimiter and the first slice, then a second slice */
+	Segments h264(2);
+	AddNal(h264[0], {0x09, 0xF0}, 0);
+	AddNal(h264[0], {0x41, 0x80}, 300);
+	AddNal(h264[1], {0x41, 0x40}, 300);
+
+	detector.Reset(UnitSyntax::H264);
+	for (int unit = 0; unit < 12; unit++)
+		ok = ok && FeedUnit(detector, h264, splits) ==
+				  (unit < 8 ? -1 : 1);
+
+	/* continuing past the last slice after the unit was sent */
+	Segments longer = h264;
+	longer.push_back(std::vector<unsigned char>(100, 0xAA));
+	ok = ok && FeedUnit(detector, longer, splits) == 1 && splits == 1 &&
+	     detector.Mispredictions() == 1 &&
+	     FeedUnit(detector, h264, splits) == -1;
+
+	/* the last slice always goes on into another segment */
+	Segments trailing(2);
+	AddNal(trailing[0], {0x41, 0x80}, 300);
+	trailing[1].assign(100, 0xAA);
+
+	detector.Reset(UnitSyntax::H264);
+	for (int unit = 0; unit < 12; unit++)
+		ok = ok && FeedUnit(detector, trailing, splits) == -1;
+
+	/* HEVC: a delimiter and a whole picture in each sample */
+	Segments hevc(1);
+	AddNal(hevc[0], {0x46, 0x01, 0x50}, 0);
+	AddNal(hevc[0], {0x02, 0x01, 0x80}, 300);
+
+	detector.Reset(UnitSyntax::HEVC);
+	for (int unit = 0; unit < 10; unit++)
+		ok = ok && FeedUnit(detector, hevc, splits) ==
+				  (unit < 8 ? -1 : 0);
+
+	/* AAC: two ADTS frames, the second split between segments */
+	std::vector<unsigned char> frames;
+	AddADTS(frames, 200);
+	AddADTS(frames, 200);
+	Segments adts(2);
+	adts[0].assign(frames.begin(), frames.begin() + 250);
+	adts[1].assign(frames.begin() + 250, frames.end());
+
+	detector.Reset(UnitSyntax::ADTS);
+	for (int unit = 0; unit < 10; unit++)
+		ok = ok && FeedUnit(detector, adts, splits) ==
+				  (unit < 8 ? -1 : 1);
+
+	return ok && splits == 1 && detector.Mispredictions() == 0;
+}
+
+static void PushTimed(TimestampNormalizer &normalizer, long long start,
+		      long long duration)
+{
+	FrameRef frame;
+	frame.startTime = start;
+	frame.stopTime = start + duration;
+	normalizer.Push(std::move(frame));
+}
+
+/* items come out of SPSCRing in order, and it is full and empty when it
+ * should be, while its positions wrap around the cells many times; then
+ * the same with a second thread popping */
+static bool CheckRing()
+{
+	bool ok = true;
+
+	for (size_t capacity : {1, 3, 4}) {
+		SPSCRing<int> ring(capacity);
+		std::mt19937 rng((unsigned)capacity);
+		size_t pushed = 0, popped = 0;
+		int item;
+
+		for (int round = 0; round < 1000; round++) {
+			size_t count = rng() % (capacity + 2);
+			for (size_t i = 0; i < count; i++) {
+				bool room = pushed - popped < capacity;
+				int value = (int)pushed;
+				ok = ok && ring.Push(std::move(value)) == room;
+				if (room)
+					pushed++;
+			}
+
+			ok = ok && ring.Size() == pushed - popped &&
+			     ring.Full() == (pushed - popped == capacity);
+
+			count = rng() % (capacity + 2);
+			for (size_t i = 0; i < count; i++) {
+				bool any = popped < pushed;
+				ok = ok && ring.Pop(item) == any;
+				if (any)
+					ok = ok && item == (int)popped++;
+			}
+
+			ok = ok && ring.Empty() == (pushed == popped);
+		}
+	}
+
+	const int count = 200000;
+	SPSCRing<int> ring(4);
+	bool ordered = true;
+
+	std::thread consumer([&]() {
+		int item;
+		for (int next = 0; next < count;) {
+			if (!ring.Pop(item)) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			ordered = ordered && item == next;
+			next++;
+		}
+	});
+
+	for (int i = 0; i < count;) {
+		int value = i;
+		if (ring.Push(std::move(value)))
+			i++;
+		else
+			std::this_thread::yield();
+	}
+
+	consumer.join();
+	return ok && ordered && ring.Empty();
+}
+
+/* pushes frames 0 to count - 1 (keyframes where their bit is set) into a
+ * queue of two while the consumer is stuck delivering frame 0, which it
+ * finishes once the rest are pushed, or after releaseMs if that isn't -1 */
+static std::vector<long long> RunPolicy(QueuePolicy policy, int timeoutMs,
+					int count, unsigned keyframes,
+					int releaseMs, StreamStats &stats)
+{
+	std::atomic<bool> entered{false}, release{false};
+	std::vector<long long> delivered;
+	FrameDispatcher dispatcher;
+
+	dispatcher.Start(2, policy, timeoutMs, [&](const FrameRef &frame) {
+		delivered.push_back(frame.startTime);
+		if (frame.startTime)
+			return;
+
+		entered = true;
+		while (!release)
+			std::this_thread::yield();
+	});
+
+	auto push = [&](int i) {
+		FrameRef frame;
+		frame.startTime = i;
+		frame.keyframe = (keyframes >> i) & 1;
+		frame.owner = std::make_shared<int>(i);
+		dispatcher.Push(std::move(frame));
+	};
+
+	push(0);
+	while (!entered)
+		std::this_thread::yield();
+
+	std::thread releaser;
+	if (releaseMs >= 0)
+		releaser = std::thread([&]() {
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(releaseMs));
+			release = true;
+		});
+
+	for (int i = 1; i < count; i++)
+		push(i);
+
+	release = true;
+	if (releaser.joinable())
+		releaser.join();
+
+	dispatcher.Stop();
+	dispatcher.GetStats(stats);
+	return delivered;
+}
+
+/* which frames each queue policy delivers to a consumer that falls behind,
+ * and that every frame pushed is either delivered or counted as dropped,
+ * against its own policy */
+static bool CheckQueuePolicies()
+{
+	typedef std::vector<long long> Frames;
+	StreamStats stats;
+	bool ok = true;
+
+	auto accounted = [&](int count) {
+		unsigned long long dropped =
+			stats.droppedNewest + stats.droppedOldest +
+			stats.droppedLatest + stats.droppedBlockTimeout +
+			stats.droppedUntilKeyframe;
+		return stats.delivered + dropped == (unsigned long long)count;
+	};
+
+	ok = ok && RunPolicy(QueuePolicy::DropNewest, 0, 5, 0, -1, stats) ==
+			   Frames{0, 1, 2} &&
+	     stats.droppedNewest == 2 && stats.queueOverflows == 2 &&
+	     accounted(5);
+
+	ok = ok && RunPolicy(QueuePolicy::DropOldest, 0, 5, 0, -1, stats) ==
+			   Frames{0, 3, 4} &&
+	     stats.droppedOldest == 2 && accounted(5);
+
+	/* a queue of one */
+	ok = ok && RunPolicy(QueuePolicy::Latest, 0, 5, 0, -1, stats) ==
+			   Frames{0, 4} &&
+	     stats.droppedLatest == 3 && !stats.droppedOldest && accounted(5);
+
+	ok = ok && RunPolicy(QueuePolicy::Block, 20, 5, 0, -1, stats) ==
+			   Frames{0, 1, 2} &&
+	     stats.droppedBlockTimeout == 2 && accounted(5);
+
+	ok = ok && RunPolicy(QueuePolicy::Block, 5000, 5, 0, 20, stats) ==
+			   Frames{0, 1, 2, 3, 4} &&
+	     !stats.droppedBlockTimeout && accounted(5);
+
+	/* 3 and 4 are dropped until keyframe 5, which replaces 1 and 2 */
+	ok = ok && RunPolicy(QueuePolicy::DropUntilKeyframe, 0, 7, 0x21, -1,
+			     stats) == Frames{0, 5, 6} &&
+	     stats.droppedUntilKeyframe == 4 && accounted(7);
+
+	return ok;
+}
+
+/* held back frames come out in order and with increasing times, copied
+ * out of buffers they don't own, and when stream time starts over (with or
+ * without a new segment) the streams of a device carry on together from
+ * where the later of them ended */
+static bool CheckTimestampNormalizer()
+{
+	const long long frame = 333333, block = 100000;
+	std::vector<long long> video, audio;
+	StreamTimeline timeline;
+	TimestampNormalizer videoNormalizer, audioNormalizer;
+	StreamStats stats;
+	bool ok = true;
+
+	auto restart = [&]() {
+		videoNormalizer.Restart(timeline, 2, true, [&](FrameRef &f) {
+			video.push_back(f.startTime);
+		});
+		audioNormalizer.Restart(timeline, 0, true, [&](FrameRef &f) {
+			audio.push_back(f.startTime);
+		});
+	};
+
+	restart();
+	for (long long start : {0LL, frame * 2, frame, frame * 3, frame * 3})
+		PushTimed(videoNormalizer, start, frame);
+	videoNormalizer.Flush();
+
+	ok = ok && video == std::vector<long long>{0, frame, frame * 2,
+						   frame * 3, frame * 3 + 1};
+	videoNormalizer.GetStats(stats);
+	ok = ok && stats.timestampsReordered == 1 &&
+	     stats.timestampsCorrected == 1 && !stats.timestampsRebased;
+
+	/* audio ends after the video */
+	for (int i = 0; i < 20; i++)
+		PushTimed(audioNormalizer, block * i, block);
+
+	/* a restart: whichever stream comes first, both go on from 2s */
+	const long long end = block * 20;
+	video.clear();
+	audio.clear();
+	restart();
+	PushTimed(videoNormalizer, 0, frame);
+	PushTimed(audioNormalizer, 0, block);
+	PushTimed(videoNormalizer, frame, frame);
+	videoNormalizer.Flush();
+	ok = ok && audio.size() == 1 && audio[0] == end &&
+	     video.size() == 2 && video[0] == end && video[1] == end + frame;
+
+	/* a new segment on each pin, audio first this time */
+	const long long videoEnd = end + frame * 2;
+	video.clear();
+	audio.clear();
+	videoNormalizer.NewSegment();
+	audioNormalizer.NewSegment();
+	PushTimed(audioNormalizer, 5000, block);
+	PushTimed(videoNormalizer, 5000, frame);
+	videoNormalizer.Flush();
+	ok = ok && audio.size() == 1 && audio[0] == videoEnd &&
+	     video.size() == 1 && video[0] == videoEnd;
+
+	/* stream time going back by more than a second is a new segment too,
+	 * for this stream only */
+	const long long late = videoEnd + frame + 20000000;
+	video.clear();
+	audio.clear();
+	PushTimed(videoNormalizer, 5000 + frame + 20000000, frame);
+	PushTimed(videoNormalizer, 0, frame);
+	PushTimed(audioNormalizer, 5000 + block, block);
+	videoNormalizer.Flush();
+	ok = ok && video.size() == 2 && video[0] == late &&
+	     video[1] == late + frame && audio.size() == 1 &&
+	     audio[0] == videoEnd + block;
+
+	videoNormalizer.GetStats(stats);
+	ok = ok && stats.timestampsRebased == 3;
+
+	/* each sample is reused as soon as its frame is pushed */
+	unsigned char sample[64];
+	std::shared_ptr<void> owner = std::make_shared<int>(0);
+	std::vector<unsigned char> values;
+	std::vector<bool> owned;
+
+	videoNormalizer.Restart(timeline, 2, true, [&](FrameRef &f) {
+		values.push_back(f.data[0][63]);
+		owned.push_back(f.owner == owner);
+	});
+
+	for (int i = 0; i < 4; i++) {
+		FrameRef f;
+		memset(sample, i, sizeof(sample));
+		f.data[0] = sample;
+		f.linesize[0] = sizeof(sample);
+		f.size = sizeof(sample);
+		f.startTime = late + frame * (i + 2);
+		f.stopTime = f.startTime + frame;
+		if (i == 3)
+			f.owner = owner;
+		videoNormalizer.Push(std::move(f));
+	}
+	memset(sample, 0xFF, sizeof(sample));
+	videoNormalizer.Flush();
+
+	return ok && values == std::vector<unsigned char>{0, 1, 2, 0xFF} &&
+	       owned == std::vector<bool>{false, false, false, true};
+}
+
+/* feeds frames at one interval and then another, and returns the last
+ * smoothed interval */
+static long long SmoothRates(TimestampSmoother &smoother, long long before,
+			     long long after, StreamStats &stats)
+{
+	long long raw = 1000000, out = 0, last = 0;
+
+	for (int i = 0; i < 60; i++) {
+		last = out;
+		out = smoother.Smooth(raw);
+		raw += i < 30 ? before : after;
+	}
+
+	smoother.GetStats(stats);
+	return out - last;
+}
+
+/* the smoother relocks when 30fps goes to 60 or 15, counts a dropped
+ * frame without relocking and takes jitter out of a steady rate */
+static bool CheckTimestampSmoother()
+{
+	const long long frame = 333333;
+	TimestampSmoother smoother;
+	StreamStats stats;
+	long long interval;
+	bool ok = true;
+
+	smoother.Reset(frame);
+	interval = SmoothRates(smoother, frame, 166667, stats);
+	ok = ok && stats.detectedRateChanges == 1 &&
+	     !stats.detectedFrameDrops && std::llabs(interval - 166667) < 2;
+
+	smoother.Reset(frame);
+	interval = SmoothRates(smoother, frame, 666667, stats);
+	ok = ok && stats.detectedRateChanges == 1 &&
+	     !stats.detectedFrameDrops && std::llabs(interval - 666667) < 2;
+
+	smoother.Reset(frame);
+	long long raw = 0;
+	for (int i = 0; i < 60; i++) {
+		smoother.Smooth(raw);
+		raw += i == 30 ? frame * 2 : frame;
+	}
+	smoother.GetStats(stats);
+	ok = ok && !stats.detectedRateChanges && stats.detectedFrameDrops == 1;
+
+	/* up to 15% of a frame either way */
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<long long> jitter(-frame * 15 / 100,
+							frame * 15 / 100);
+	long long rawError = 0, outError = 0;
+
+	smoother.Reset(frame);
+	for (int i = 0; i < 600; i++) {
+		long long ideal = (long long)i * frame;
+		long long in = ideal + jitter(rng);
+		long long out = smoother.Smooth(in);
+		if (i >= 300) {
+			rawError += std::llabs(in - ideal);
+			outError += std::llabs(out - ideal);
+		}
+	}
+	smoother.GetStats(stats);
+
+	return ok && !stats.detectedRateChanges && !stats.detectedFrameDrops &&
+	       outError * 2 < rawError;
+}
+
+/* a trace of a device clock 100ppm fast, delivered 2-2.2ms late, which
+ * restarts part way through */
+static bool CheckClockDomain()
+{
+	const long long frame = 333333;
+	const long long hostBase = 123456789;
+	ClockDomainEstimator estimator;
+	std::mt19937 rng(7);
+	bool ok = true;
+
+	auto device = [&](long long t, long long deviceBase) {
+		return deviceBase + t + t / 10000;
+	};
+
+	for (int restart = 0; restart < 2; restart++) {
+		const long long deviceBase = restart ? 1000 : 50000000000LL;
+		const long long hostStart = hostBase + restart * 400000000LL;
+
+		for (long long t = 0; t < 300000000LL; t += frame) {
+			estimator.Observe(device(t, deviceBase),
+					  hostStart + t + 20000 + rng() % 2000);
+			if (!t)
+				ok = ok && estimator.Restarts() ==
+						   (unsigned long long)restart;
+		}
+
+		const long long t = 300000000LL;
+		ok = ok && std::abs(estimator.DriftPPM() - 100.0) < 5.0 &&
+		     std::llabs(estimator.ToHost(device(t, deviceBase)) -
+				(hostStart + t + 21000)) < 500;
+	}
+
+	/* nothing from before a reset, not even a partly averaged pair, may
+	 * pull on what comes after it */
+	const long long end = 300000000LL;
+	const long long hostEnd = hostBase + 400000000LL + end + 21000;
+	estimator.Observe(device(end, 1000), hostEnd);
+	estimator.Observe(device(end + frame, 1000), hostEnd + frame);
+	estimator.Observe(device(end + frame * 2, 1000),
+			  hostEnd + frame * 2 + 4000000);
+	estimator.Reset();
+	ok = ok && !estimator.Valid() && estimator.ToHost(1000) == 0;
+
+	for (long long t = 0; t <= ClockDomainEstimator::bucketSpan * 2;
+	     t += frame)
+		estimator.Observe(t, hostBase + t);
+
+	return ok && estimator.ToHost(0) == hostBase &&
+	       estimator.ToHost(frame * 100) == hostBase + frame * 100;
+}
+
+struct Timing {
+	long long bestNs = 0;
+	long long avgNs = 0;
+};
+
+struct Measurement {
+	Case c;
+	const char *isa;
+	Size size;
+	int threads;
+	Timing timing;
+	size_t bytes;
+};
+
+struct Verdict {
+	Case c;
+	const char *isa;
+	bool exact;
+};
+
+/* one of the ways of doing a job that are timed against each other */
+struct Comparison {
+	Op op;
+	const char *variant;
+	std::string detail;
+	Size size;
+	int threads;
+	Timing timing;
+};
+
+template<typename Proc> static Timing Time(const Proc &proc, long long timeNs)
+{
+	typedef std::chrono::steady_clock clock;
+	long long total = 0;
+	long long best = 0;
+	int runs = 0;
+
+	/* once to warm the caches and fault the pages in */
+	proc();
+
+	while (runs < 3 || total < timeNs) {
+		clock::time_point start = clock::now();
+		proc();
+		long long ns = std::chrono::duration_cast<
+				       std::chrono::nanoseconds>(clock::now() -
+								 start)
+				       .count();
+
+		if (!runs || ns < best)
+			best = ns;
+		total += ns;
+		runs++;
+	}
+
+	Timing timing;
+	timing.bestNs = best;
+	timing.avgNs = total / runs;
+	return timing;
+}
+
+static Timing Time(ConvertKernel kernel, const ConvertFrame &frame,
+		   SliceExecutor *executor, long long timeNs)
+{
+	return Time([&]() { RunKernel(kernel, frame, executor); }, timeNs);
+}
+
+/* times a kernel at each size and thread count, returning whether its
+ * output always matched the C kernel's.  Packed 4:2:2 frames are only
+ * rotated with even dimensions, as in VideoConverter. */
+static bool Measure(const Case &c, const char *isa, ConvertKernel kernel,
+		    ConvertKernel scalar, const Options &options,
+		    const std::vector<SliceExecutor *> &executors,
+		    std::mt19937 &rng, std::vector<Measurement> &results)
+{
+	bool exact = true;
+
+	for (const Size &size : options.sizes) {
+		if (c.op == Op::Rotate && Packed422(c.from) &&
+		    ((size.cx | size.cy) & 1))
+			continue;
+
+		Frame src;
+		AllocFrame(src, c.from, size.cx, size.cy);
+		FillFrame(src, rng);
+
+		const std::vector<unsigned char> expected =
+			Output(c, scalar, src, false, nullptr);
+
+		int outCX, outCY;
+		OutputSize(c, size.cx, size.cy, outCX, outCY);
+
+		for (size_t i = 0; i < executors.size(); i++) {
+			Frame dst;
+			AllocFrame(dst, c.to, outCX, outCY);
+
+			Measurement result;
+			result.c = c;
+			result.isa = isa;
+			result.size = size;
+			result.threads = options.threads[i];
+			result.bytes = src.size + dst.size;
+			result.timing = Time(kernel,
+					     MakeConvertFrame(c, src, dst,
+							      false),
+					     executors[i], options.timeNs);
+			results.push_back(result);
+
+			exact = exact && dst.data == expected;
+
+			fprintf(stderr, "%s %s->%s %d %s %dx%d x%d: %.3f ms\n",
+				opNames[(int)c.op], FormatName(c.from),
+				FormatName(c.to), c.degrees, isa, size.cx,
+				size.cy, result.threads,
+				(double)result.timing.bestNs / 1e6);
+		}
+	}
+
+	return exact;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void AddComparison(std::vector<Comparison> &comparisons, Op op,
+			  const char *variant, const std::string &detail,
+			  const Size &size, int threads, const Timing &timing)
+{
+	Comparison result;
+	result.op = op;
+	result.variant = variant;
+	result.detail = detail;
+	result.size = size;
+	result.threads = threads;
+	result.timing = timing;
+	comparisons.push_back(result);
+
+	fprintf(stderr, "%s %s %s %dx%d x%d: %.3f ms\n", opNames[(int)op],
+		detail.c_str(), variant, size.cx, size.cy, threads,
+		(double)timing.bestNs / 1e6);
+}
+
+/* a frame converted straight into a tightly packed output sample, as with
+ * LockFrame, against one converted into a buffer of its own and then copied
+ * into the sample, as SendFrame does.  RGB samples are bottom-up, so they
+ * are written with a negative stride.  Returns whether both samples came
+ * out the same. */
+static bool CompareRender(const Options &options, std::mt19937 &rng,
+			  std::vector<Comparison> &comparisons)
+{
+	const Case c = {
+		Op::Convert,
+		options.from != VideoFormat::Any ? options.from
+						 : VideoFormat::XRGB,
+		options.to != VideoFormat::Any ? options.to : VideoFormat::NV12,
+		0,
+	};
+	ConvertKernel kernel = GetKernel(c, GetCPUFeatures(), nullptr);
+	if (!kernel)
+		return true;
+
+	const std::string detail = std::string(FormatName(c.from)) + "->" +
+				   FormatName(c.to);
+	bool exact = true;
+
+	for (const Size &size : options.sizes) {
+		Frame src, buffer, direct, copied;
+		AllocFrame(src, c.from, size.cx, size.cy);
+		AllocFrame(buffer, c.to, size.cx, size.cy);
+		AllocFrame(direct, c.to, size.cx, size.cy);
+		AllocFrame(copied, c.to, size.cx, size.cy);
+		FillFrame(src, rng);
+
+		if (VideoFrameBottomUp(c.to, false)) {
+			ReverseVideoFrameRows(direct.ref);
+			ReverseVideoFrameRows(copied.ref);
+		}
+
+		const ConvertFrame toSample =
+			MakeConvertFrame(c, src, direct, false);
+		AddComparison(comparisons, Op::Render, "direct", detail, size,
+			      1,
+			      Time([&]() { kernel(toSample, 0, size.cy); },
+				   options.timeNs));
+
+		const ConvertFrame toBuffer =
+			MakeConvertFrame(c, src, buffer, false);
+		auto convertAndCopy = [&]() {
+			kernel(toBuffer, 0, size.cy);
+
+			for (int i = 0; i < DSHOW_MAX_PLANES; i++) {
+				if (!copied.ref.data[i])
+					break;
+
+				CopyPlane(copied.ref.data[i],
+					  copied.ref.linesize[i],
+					  buffer.ref.data[i],
+					  buffer.ref.linesize[i],
+					  (size_t)buffer.ref.linesize[i],
+					  VideoPlaneHeight(c.to, i, size.cy));
+			}
+		};
+		AddComparison(comparisons, Op::Render, "copy", detail, size, 1,
+			      Time(convertAndCopy, options.timeNs));
+
+		exact = exact && direct.data == copied.data;
+	}
+
+	return exact;
+}
+
+/* encoded packets as they arrive: a keyframe split over many samples and
+ * the frames that follow it, in bytes per sample */
+struct PacketShape {
+	size_t sampleSize;
+	int samples;
+};
+
+static const PacketShape packetShapes[] = {
+	{188 * 7, 4}, {188 * 7, 300}, {64 * 1024, 8}, {16 * 1024, 1},
+};
+
+/* the old EncodedData reused one vector, which consumers could only borrow;
+ * a packet that is kept (a FrameRef) has to be copied out of it.  Pooled
+ * packets are kept as they are.  Returns whether all of them came out with
+ * the same bytes. */
+static bool ComparePacket(const Options &options, std::mt19937 &rng,
+			  std::vector<Comparison> &comparisons)
+{
+	const Size none = {0, 0};
+	bool exact = true;
+
+	for (const PacketShape &shape : packetShapes) {
+		std::vector<unsigned char> input(shape.sampleSize *
+						 shape.samples);
+		for (unsigned char &byte : input)
+			byte = (unsigned char)rng();
+
+		char detail[64];
+		snprintf(detail, sizeof(detail), "%zux%d", shape.sampleSize,
+			 shape.samples);
+
+		std::vector<unsigned char> bytes;
+		std::shared_ptr<std::vector<unsigned char>> kept;
+		auto appendVector = [&](bool keep) {
+			bytes.resize(0);
+			for (int i = 0; i < shape.samples; i++) {
+				const unsigned char *sample =
+					input.data() + i * shape.sampleSize;
+				bytes.insert(bytes.end(), sample,
+					     sample + shape.sampleSize);
+			}
+
+			if (keep)
+				kept = std::make_shared<
+					std::vector<unsigned char>>(bytes);
+		};
+
+		PacketAssembler assembler;
+		std::shared_ptr<EncodedPacket> packet;
+		auto appendPooled = [&]() {
+			packet.reset();
+			for (int i = 0; i < shape.samples; i++)
+				assembler.Append(input.data() +
+							 i * shape.sampleSize,
+						 shape.sampleSize);
+			packet = assembler.Take();
+		};
+
+		AddComparison(comparisons, Op::Packet, "vector", detail, none,
+			      1, Time([&]() { appendVector(false); },
+				      options.timeNs));
+		AddComparison(comparisons, Op::Packet, "vector-kept", detail,
+			      none, 1,
+			      Time([&]() { appendVector(true); },
+				   options.timeNs));
+		AddComparison(comparisons, Op::Packet, "pooled", detail, none,
+			      1, Time(appendPooled, options.timeNs));
+
+		std::vector<unsigned char> pooled(packet->Size());
+		packet->CopyTo(pooled.data());
+		exact = exact && bytes == input && *kept == input &&
+			pooled == input;
+	}
+
+	return exact;
+}
+
+/* a frame cropped by an eighth on each side, converted, scaled to half its
+ * size and rotated by VideoConverter in one pass, against one converter
+ * for each of those stages.  Returns whether both came out the same. */
+static bool CompareFused(const Options &options, std::mt19937 &rng,
+			 std::vector<Comparison> &comparisons)
+{
+	const VideoFormat from = options.from != VideoFormat::Any
+					 ? options.from
+					 : VideoFormat::YUY2;
+	const VideoFormat to = options.to != VideoFormat::Any
+				       ? options.to
+				       : VideoFormat::I420;
+	if (!GetConvertKernel(from, to, 0) || !GetScaleKernel(to) ||
+	    !GetRotateKernel(to, 90, 0))
+		return true;
+
+	const std::string detail = std::string(FormatName(from)) + "->" +
+				   FormatName(to) + " 90";
+	bool exact = true;
+
+	for (const Size &size : options.sizes) {
+		Frame src;
+		AllocFrame(src, from, size.cx, size.cy);
+		FillFrame(src, rng);
+		src.ref.rotation = 90;
+
+		VideoPipeline pipeline;
+		pipeline.cropX = size.cx / 8 & ~1;
+		pipeline.cropY = size.cy / 8 & ~1;
+		pipeline.cropCX = size.cx - pipeline.cropX * 2;
+		pipeline.cropCY = size.cy - pipeline.cropY * 2;
+		pipeline.scaleCX = size.cx / 2 & ~1;
+		pipeline.scaleCY = size.cy / 2 & ~1;
+
+		VideoPipeline crop = pipeline;
+		crop.scaleCX = crop.scaleCY = 0;
+		VideoPipeline scale;
+		scale.scaleCX = pipeline.scaleCX;
+		scale.scaleCY = pipeline.scaleCY;
+
+		VideoConverter fused, converter, scaler, rotator;
+		FrameRef oneFrame, stagedFrame;
+
+		auto runFused = [&]() {
+			oneFrame = src.ref;
+			fused.Convert(oneFrame, to, ColorMatrix::BT709,
+				      ColorRange::Partial, ColorTransfer::SDR,
+				      false, true, pipeline);
+		};
+		auto runSeparate = [&]() {
+			stagedFrame = src.ref;
+			converter.Convert(stagedFrame, to, ColorMatrix::BT709,
+					  ColorRange::Partial,
+					  ColorTransfer::SDR, false, false,
+					  crop);
+			scaler.Convert(stagedFrame, to, ColorMatrix::BT709,
+				       ColorRange::Partial, ColorTransfer::SDR,
+				       false, false, scale);
+			rotator.Convert(stagedFrame, to, ColorMatrix::BT709,
+					ColorRange::Partial,
+					ColorTransfer::SDR, false, true);
+		};
+
+		AddComparison(comparisons, Op::Fused, "fused", detail, size, 1,
+			      Time(runFused, options.timeNs));
+		AddComparison(comparisons, Op::Fused, "separate", detail, size,
+			      1, Time(runSeparate, options.timeNs));
+
+		exact = exact && oneFrame.cx == pipeline.scaleCY &&
+			oneFrame.cy == pipeline.scaleCX &&
+			stagedFrame.cx == oneFrame.cx &&
+			stagedFrame.cy == oneFrame.cy &&
+			FrameBytes(oneFrame) == FrameBytes(stagedFrame);
+	}
+
+	return exact;
+}
+
+/* what FrameDispatcher would be with a lock: a bounded deque guarded by a
+ * mutex, whose consumer is woken through a condition variable */
+class LockedQueue {
+	std::deque<FrameRef> frames;
+	size_t depth = 0;
+	FrameDispatcher::DeliverProc deliver;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable spaceCV;
+	bool stopping = false;
+	std::thread thread;
+
+	void Thread()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		for (;;) {
+			cv.wait(lock, [this]() {
+				return !frames.empty() || stopping;
+			});
+			if (frames.empty())
+				break;
+
+			FrameRef frame = std::move(frames.front());
+			frames.pop_front();
+			spaceCV.notify_one();
+
+			lock.unlock();
+			deliver(frame);
+			frame.Release();
+			lock.lock();
+		}
+	}
+
+public:
+	void Start(size_t depth_, FrameDispatcher::DeliverProc deliver_)
+	{
+		depth = depth_;
+		deliver = std::move(deliver_);
+		stopping = false;
+		thread = std::thread(&LockedQueue::Thread, this);
+	}
+
+	/* waits for room, like QueuePolicy::Block */
+	void Push(FrameRef &&frame)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		spaceCV.wait(lock, [this]() { return frames.size() < depth; });
+		frames.push_back(std::move(frame));
+		cv.notify_one();
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			cv.notify_one();
+		}
+
+		thread.join();
+	}
+};
+
+static inline long long NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+#define BURST_FRAMES 20000
+#define LATENCY_FRAMES 200
+#define LATENCY_RUNS 5
+
+/* a burst of frames through a queue of four, and frames one at a time with
+ * the consumer left to go idle in between.  Returns whether every frame
+ * arrived, in order. */
+static bool CompareQueue(const Options &options,
+			 std::vector<Comparison> &comparisons)
+{
+	typedef std::function<void(FrameRef &&)> PushProc;
+	const Size none = {0, 0};
+	const size_t depth = 4;
+
+	std::shared_ptr<void> owner = std::make_shared<int>(0);
+	std::atomic<long long> received{0};
+	std::atomic<long long> latencyNs{0};
+	long long sent = 0, expected = 0;
+	bool ordered = true;
+
+	/* only the consumer touches expected and ordered until it stops */
+	auto deliver = [&](const FrameRef &frame) {
+		ordered = ordered && frame.startTime == expected;
+		expected++;
+		if (frame.stopTime)
+			latencyNs += NowNs() - frame.stopTime;
+		received++;
+	};
+
+	auto send = [&](const PushProc &push, bool stamp) {
+		FrameRef frame;
+		frame.startTime = sent++;
+		frame.stopTime = stamp ? NowNs() : 0;
+		frame.owner = owner;
+		push(std::move(frame));
+	};
+
+	auto burst = [&](const PushProc &push) {
+		received = 0;
+		for (int i = 0; i < BURST_FRAMES; i++)
+			send(push, false);
+		while (received < BURST_FRAMES)
+			std::this_thread::yield();
+	};
+
+	auto latency = [&](const PushProc &push) {
+		Timing timing;
+		long long total = 0;
+
+		for (int run = 0; run < LATENCY_RUNS; run++) {
+			received = 0;
+			latencyNs = 0;
+
+			for (int i = 0; i < LATENCY_FRAMES; i++) {
+				send(push, true);
+				while (received <= i)
+					std::this_thread::yield();
+				std::this_thread::sleep_for(
+					std::chrono::microseconds(100));
+			}
+
+			long long mean = latencyNs / LATENCY_FRAMES;
+			if (!run || mean < timing.bestNs)
+				timing.bestNs = mean;
+			total += mean;
+		}
+
+		timing.avgNs = total / LATENCY_RUNS;
+		return timing;
+	};
+
+	FrameDispatcher dispatcher;
+	dispatcher.Start(depth, QueuePolicy::Block, 1000, deliver);
+	PushProc pushRing = [&](FrameRef &&frame) {
+		dispatcher.Push(std::move(frame));
+	};
+	AddComparison(comparisons, Op::Queue, "ring", "burst", none, 2,
+		      Time([&]() { burst(pushRing); }, options.timeNs));
+	AddComparison(comparisons, Op::Queue, "ring", "latency", none, 2,
+		      latency(pushRing));
+	dispatcher.Stop();
+
+	LockedQueue locked;
+	locked.Start(depth, deliver);
+	PushProc pushLocked = [&](FrameRef &&frame) {
+		locked.Push(std::move(frame));
+	};
+	AddComparison(comparisons, Op::Queue, "mutex", "burst", none, 2,
+		      Time([&]() { burst(pushLocked); }, options.timeNs));
+	AddComparison(comparisons, Op::Queue, "mutex", "latency", none, 2,
+		      latency(pushLocked));
+	locked.Stop();
+
+	PushProc pushDirect = [&](FrameRef &&frame) { deliver(frame); };
+	AddComparison(comparisons, Op::Queue, "direct", "burst", none, 1,
+		      Time([&]() { burst(pushDirect); }, options.timeNs));
+
+	return ordered && expected == sent;
+}
+
+/* runs the comparisons --op asks for, returning how many of them gave
+ * different output one way than the other */
+static int Compare(const Options &options, std::mt19937 &rng,
+		   std::vector<Comparison> &comparisons)
+{
+	int mismatches = 0;
+
+	if ((options.op < 0 || options.op == (int)Op::Render) &&
+	    !CompareRender(options, rng, comparisons)) {
+		fprintf(stderr, "MISMATCH render\n");
+		mismatches++;
+	}
+
+	if ((options.op < 0 || options.op == (int)Op::Packet) &&
+	    !ComparePacket(options, rng, comparisons)) {
+		fprintf(stderr, "MISMATCH packet\n");
+		mismatches++;
+	}
+
+	if ((options.op < 0 || options.op == (int)Op::Fused) &&
+	    !CompareFused(options, rng, comparisons)) {
+		fprintf(stderr, "MISMATCH fused\n");
+		mismatches++;
+	}
+
+	if ((options.op < 0 || options.op == (int)Op::Queue) &&
+	    !CompareQueue(options, comparisons)) {
+		fprintf(stderr, "MISMATCH queue\n");
+		mismatches++;
+	}
+
+	return mismatches;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void PrintCase(FILE *file, const Case &c, const char *isa)
+{
+	fprintf(file,
+		"\"op\": \"%s\", \"from\": \"%s\", \"to\": \"%s\", "
+		"\"degrees\": %d, \"isa\": \"%s\"",
+		opNames[(int)c.op], FormatName(c.from), FormatName(c.to),
+		c.degrees, isa);
+}
+
+static void PrintJSON(FILE *file, const std::vector<Verdict> &verdicts,
+		      const std::vector<Measurement> &results,
+		      const std::vector<Comparison> &comparisons,
+		      int mismatches)
+{
+	fprintf(file, "{\n  \"version\": \"%d.%d.%d\",\n",
+		DSHOWCAPTURE_VERSION_MAJOR, DSHOWCAPTURE_VERSION_MINOR,
+		DSHOWCAPTURE_VERSION_PATCH);
+
+	const uint32_t available = GetCPUFeatures();
+	bool first = true;
+
+	fprintf(file, "  \"cpu\": {\"tiers\": [");
+	for (const char *name : tierNames) {
+		uint32_t features = GetCPUTierFeatures(name);
+		if ((features & available) != features)
+			continue;
+		fprintf(file, "%s\"%s\"", first ? "" : ", ", name);
+		first = false;
+	}
+	fprintf(file, "], \"l2Bytes\": %zu, \"threads\": %u},\n",
+		GetL2CacheSize(), std::thread::hardware_concurrency());
+
+	fprintf(file, "  \"checks\": [");
+	for (size_t i = 0; i < verdicts.size(); i++) {
+		const Verdict &verdict = verdicts[i];
+		fprintf(file, "%s\n    {", i ? "," : "");
+		PrintCase(file, verdict.c, verdict.isa);
+		fprintf(file, ", \"exact\": %s}",
+			verdict.exact ? "true" : "false");
+	}
+
+	fprintf(file, "\n  ],\n  \"results\": [");
+	for (size_t i = 0; i < results.size(); i++) {
+		const Measurement &result = results[i];
+		const double seconds = (double)result.timing.bestNs / 1e9;
+		const double pixels =
+			(double)result.size.cx * (double)result.size.cy;
+
+		fprintf(file, "%s\n    {", i ? "," : "");
+		PrintCase(file, result.c, result.isa);
+		fprintf(file,
+			", \"width\": %d, \"height\": %d, \"threads\": %d, "
+			"\"bestNs\": %lld, \"avgNs\": %lld, "
+			"\"pixelsPerSec\": %.0f, \"gbPerSec\": %.3f}",
+			result.size.cx, result.size.cy, result.threads,
+			result.timing.bestNs, result.timing.avgNs,
+			pixels / seconds,
+			(double)result.bytes / seconds / 1e9);
+	}
+
+	fprintf(file, "\n  ],\n  \"comparisons\": [");
+	for (size_t i = 0; i < comparisons.size(); i++) {
+		const Comparison &result = comparisons[i];
+
+		fprintf(file,
+			"%s\n    {\"op\": \"%s\", \"variant\": \"%s\", "
+			"\"detail\": \"%s\", \"width\": %d, "
+			"\"height\": %d, \"threads\": %d, \"bestNs\": %lld, "
+			"\"avgNs\": %lld}",
+			i ? "," : "", opNames[(int)result.op], result.variant,
+			result.detail.c_str(), result.size.cx, result.size.cy,
+			result.threads, result.timing.bestNs,
+			result.timing.avgNs);
+	}
+
+	fprintf(file, "\n  ],\n  \"mismatches\": %d\n}\n", mismatches);
+}
+
+static bool ParseList(const char *arg, std::vector<int> &values)
+{
+	values.clear();
+
+	while (*arg) {
+		char *end;
+		long value = strtol(arg, &end, 10);
+		if (end == arg || value <= 0)
+			return false;
+
+		values.push_back((int)value);
+		arg = *end == ',' ? end + 1 : end;
+		if (*end && *end != ',')
+			return false;
+	}
+
+	return !values.empty();
+}
+
+static bool ParseSizes(const char *arg, std::vector<Size> &sizes)
+{
+	sizes.clear();
+
+	while (*arg) {
+		Size size;
+		int length = 0;
+		if (sscanf(arg, "%dx%d%n", &size.cx, &size.cy, &length) != 2 ||
+		    size.cx <= 0 || size.cy <= 0)
+			return false;
+
+		sizes.push_back(size);
+		arg += length;
+		if (*arg == ',')
+			arg++;
+		else if (*arg)
+			return false;
+	}
+
+	return !sizes.empty();
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "--check") == 0) {
+			options.checkOnly = true;
+			continue;
+		}
+		if (!value)
+			return false;
+
+		i++;
+		if (strcmp(arg, "--op") == 0) {
+			options.op = -1;
+			for (int op = 0; op < OP_COUNT; op++) {
+				if (strcmp(value, opNames[op]) == 0)
+					options.op = op;
+			}
+			if (options.op < 0)
+				return false;
+
+		} else if (strcmp(arg, "--from") == 0 ||
+			   strcmp(arg, "--to") == 0) {
+			VideoFormat format = ParseFormat(value);
+			if (format == VideoFormat::Unknown)
+				return false;
+			(arg[2] == 'f' ? options.from : options.to) = format;
+
+		} else if (strcmp(arg, "--sizes") == 0) {
+			if (!ParseSizes(value, options.sizes))
+				return false;
+
+		} else if (strcmp(arg, "--threads") == 0) {
+			if (!ParseList(value, options.threads))
+				return false;
+
+		} else if (strcmp(arg, "--time") == 0) {
+			options.timeNs = atoll(value) * 1000000;
+
+		} else if (strcmp(arg, "--output") == 0) {
+			options.output = value;
+
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options)) {
+		fprintf(stderr,
+			"usage: %s [--check] "
+			"[--op convert|tonemap|rotate|render|packet|fused|"
+			"queue] "
+			"[--from FORMAT] [--to FORMAT] [--sizes WxH,...] "
+			"[--threads N,...] [--time MS] [--output FILE]\n",
+			argv[0]);
+		return 2;
+	}
+
+	if (options.threads.empty()) {
+		const int cores = (int)std::thread::hardware_concurrency();
+		options.threads.push_back(1);
+		if (cores > 1)
+			options.threads.push_back(cores);
+	}
+
+	FILE *file = options.output ? fopen(options.output, "w") : stdout;
+	if (!file) {
+		fprintf(stderr, "cannot open %s\n", options.output);
+		return 2;
+	}
+
+	std::vector<Case> cases;
+	AddCases(cases, options);
+
+	std::vector<std::unique_ptr<SliceExecutor>> pools;
+	std::vector<SliceExecutor *> executors;
+	for (int threads : options.threads) {
+		pools.emplace_back(threads > 1 ? new SliceExecutor(threads)
+					       : nullptr);
+		executors.push_back(pools.back().get());
+	}
+
+	std::mt19937 rng(1);
+	std::vector<Verdict> verdicts;
+	std::vector<Measurement> results;
+	int mismatches = 0;
+
+	for (const Case &c : cases) {
+		ConvertKernel scalar = GetKernel(c, 0, nullptr);
+		std::vector<std::string> done;
+
+		for (uint32_t features : GetTiers()) {
+			const char *isa;
+			ConvertKernel kernel = GetKernel(c, features, &isa);
+
+			/* tiers without a kernel of their own fall back to
+			 * one that is already done */
+			if (std::find(done.begin(), done.end(), isa) !=
+			    done.end())
+				continue;
+			done.push_back(isa);
+
+			Verdict verdict = {c, isa,
+					   Check(c, kernel, scalar, rng)};
+			if (!options.checkOnly &&
+			    !Measure(c, isa, kernel, scalar, options, executors,
+				     rng, results))
+				verdict.exact = false;
+			verdicts.push_back(verdict);
+
+			if (!verdict.exact) {
+				fprintf(stderr, "MISMATCH %s %s->%s %d %s\n",
+					opNames[(int)c.op], FormatName(c.from),
+					FormatName(c.to), c.degrees, isa);
+				mismatches++;
+			}
+		}
+	}
+
+	if (!CheckBottomUp(rng))
+		mismatches++;
+
+	if (!CheckCopyPlane(rng)) {
+		fprintf(stderr, "MISMATCH copy-plane\n");
+		mismatches++;
+	}
+
+	if (!CheckAutoMatrix(rng)) {
+		fprintf(stderr, "MISMATCH auto-matrix\n");
+		mismatches++;
+	}
+
+	if (!CheckPipeline(rng)) {
+		fprintf(stderr, "MISMATCH pipeline\n");
+		mismatches++;
+	}
+
+	if (!CheckExecutor()) {
+		fprintf(stderr, "MISMATCH executor\n");
+		mismatches++;
+	}
+
+	if (!CheckFrameRefs(rng)) {
+		fprintf(stderr, "MISMATCH frame-ref\n");
+		mismatches++;
+	}
+
+	if (!CheckPropertyMonitor()) {
+		fprintf(stderr, "MISMATCH property-monitor\n");
+		mismatches++;
+	}
+
+	if (!CheckTimestampSynth()) {
+		fprintf(stderr, "MISMATCH timestamp-synth\n");
+		mismatches++;
+	}
+
+	if (!CheckAccessUnits()) {
+		fprintf(stderr, "MISMATCH access-units\n");
+		mismatches++;
+	}
+
+	if (!CheckRing()) {
+		fprintf(stderr, "MISMATCH ring\n");
+		mismatches++;
+	}
+
+	if (!CheckQueuePolicies()) {
+		fprintf(stderr, "MISMATCH queue-policies\n");
+		mismatches++;
+	}
+
+	if (!CheckTimestampNormalizer()) {
+		fprintf(stderr, "MISMATCH timestamp-normalizer\n");
+		mismatches++;
+	}
+
+	if (!CheckTimestampSmoother()) {
+		fprintf(stderr, "MISMATCH timestamp-smoother\n");
+		mismatches++;
+	}
+
+	if (!CheckClockDomain()) {
+		fprintf(stderr, "MISMATCH clock-domain\n");
+		mismatches++;
+	}
+
+	std::vector<Comparison> comparisons;
+	if (!options.checkOnly)
+		mismatches += Compare(options, rng, comparisons);
+
+	PrintJSON(file, verdicts, results, comparisons, mismatches);
+
+	if (file != stdout)
+		fclose(file);
+	return mismatches ? 1 : 0;
+}